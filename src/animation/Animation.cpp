@@ -0,0 +1,203 @@
+#include <esp_partition.h>
+#include <esp_rom_crc.h>
+#include "Animation.h"
+#include "../switcher/Switcher.h"
+
+namespace Animation {
+    static const char *TAG = "ANIMATION";
+
+    static constexpr const char *PARTITION_LABEL = "anim";
+    static constexpr esp_partition_subtype_t PARTITION_SUBTYPE = static_cast<esp_partition_subtype_t>(0x40);
+    static constexpr size_t SECTOR_SIZE = 4096;
+    static constexpr uint8_t SPEED_UNITY = 64;
+    // A longer gap between calls means the mode was left in between: start over from frame 0
+    static constexpr uint32_t RESTART_GAP_MS = 500;
+    // Frames decoded per call at most when playback falls behind; the rest are skipped
+    static constexpr int MAX_CATCHUP_FRAMES = 8;
+
+    // The whole partition stays mapped, so the render task never races an unmap
+    static const esp_partition_t *partition = nullptr;
+    static const uint8_t *mapped = nullptr;
+    static esp_partition_mmap_handle_t mapHandle;
+
+    // Written by the uploading task, read by the render task
+    static volatile bool ready = false;
+    static volatile uint32_t generation = 0;
+
+    // Upload progress
+    static bool uploading = false;
+    static size_t uploadSize = 0;
+    static size_t written = 0;
+    static size_t erasedEnd = 0;
+
+    // Playback state, owned by the render task
+    static uint32_t playGeneration = UINT32_MAX;
+    static int playLeds = 0;
+    static uint32_t lastCallMs = 0;
+    static uint64_t playPos = 0;   // Playhead in thousandths of a frame
+    static uint32_t nextFrame = 0; // Index of the frame at the cursor
+    static size_t cursor = 0;      // Offset of that frame in the frame data
+    static uint32_t decodeUs = 0;
+
+    static const Header &storedHeader() {
+        return *reinterpret_cast<const Header *>(mapped);
+    }
+
+    static bool validate(size_t size) {
+        uint32_t badFrame = 0;
+        if (validateContainer(mapped, size, badFrame)) return true;
+        if (size >= sizeof(Header) && badFrame < storedHeader().frameCount) {
+            ESP_LOGW(TAG, "Frame %u is malformed", (unsigned) badFrame);
+        }
+        return false;
+    }
+
+    void init() {
+        partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, PARTITION_SUBTYPE, PARTITION_LABEL);
+        if (partition == nullptr) {
+            ESP_LOGW(TAG, "No \"%s\" partition, animations disabled", PARTITION_LABEL);
+            return;
+        }
+        const void *memory = nullptr;
+        const esp_err_t err = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &memory, &mapHandle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to map the animation partition: %d", err);
+            partition = nullptr;
+            return;
+        }
+        mapped = static_cast<const uint8_t *>(memory);
+
+        // Erased flash reads as 0xFF: check the length before adding to it
+        const uint32_t dataLength = storedHeader().dataLength;
+        if (dataLength <= partition->size - sizeof(Header) && validate(sizeof(Header) + dataLength)) {
+            ready = true;
+            ESP_LOGI(TAG, "Animation: %u frames of %u LEDs at %u fps", (unsigned) storedHeader().frameCount,
+                     storedHeader().numLeds, storedHeader().fps);
+        }
+    }
+
+    bool beginUpload(size_t size) {
+        if (mapped == nullptr || size < sizeof(Header) || size > partition->size) return false;
+        // Playback stops before the first byte is overwritten; the frame in flight may still
+        // be decoding from the mapping, so the first erase waits for it
+        ready = false;
+        Switcher::waitForFrame(Switcher::frameSequence());
+        uploading = true;
+        uploadSize = size;
+        written = 0;
+        erasedEnd = 0;
+        ESP_LOGI(TAG, "Upload started: %u bytes", (unsigned) size);
+        return true;
+    }
+
+    bool writeChunk(size_t offset, const uint8_t *data, size_t length) {
+        if (!uploading || offset != written || offset + length > uploadSize) return false;
+
+        // Sectors are erased just ahead of the data, so no single command blocks for long
+        const size_t end = offset + length;
+        if (end > erasedEnd) {
+            const size_t eraseTo = (end + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+            const esp_err_t err = esp_partition_erase_range(partition, erasedEnd, eraseTo - erasedEnd);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Erase at %u failed: %d", (unsigned) erasedEnd, err);
+                uploading = false;
+                return false;
+            }
+            erasedEnd = eraseTo;
+        }
+        const esp_err_t err = esp_partition_write(partition, offset, data, length);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Write at %u failed: %d", (unsigned) offset, err);
+            uploading = false;
+            return false;
+        }
+        written = end;
+        return true;
+    }
+
+    bool finishUpload(uint32_t crc) {
+        if (!uploading || written != uploadSize) return false;
+        uploading = false;
+
+        if (esp_rom_crc32_le(0, mapped, uploadSize) != crc) {
+            ESP_LOGW(TAG, "Upload CRC mismatch");
+            return false;
+        }
+        if (!validate(uploadSize)) {
+            ESP_LOGW(TAG, "Uploaded animation is malformed");
+            return false;
+        }
+        generation++;
+        ready = true;
+        ESP_LOGI(TAG, "Animation stored: %u frames, %u bytes", (unsigned) storedHeader().frameCount,
+                 (unsigned) uploadSize);
+        return true;
+    }
+
+    bool isReady() {
+        return ready;
+    }
+
+    Info getInfo() {
+        Info info = {};
+        info.capacity = partition ? partition->size : 0;
+        info.decodeUs = decodeUs;
+        if (ready) {
+            const Header &header = storedHeader();
+            info.ready = true;
+            info.fps = header.fps;
+            info.numLeds = header.numLeds;
+            info.frameCount = header.frameCount;
+            info.size = sizeof(Header) + header.dataLength;
+        }
+        return info;
+    }
+
+    void render(CRGB *leds, int numLeds, const Effects::Params &p) {
+        const uint32_t now = millis();
+        if (!ready) {
+            fill_solid(leds, numLeds, CRGB::Black);
+            playGeneration = UINT32_MAX;
+            lastCallMs = now;
+            return;
+        }
+
+        const Header &header = storedHeader();
+        const uint8_t *data = mapped + sizeof(Header);
+        if (playGeneration != generation || playLeds != numLeds || now - lastCallMs > RESTART_GAP_MS) {
+            // Delta frames need the previous frame in the buffer: restart from the key frame
+            playGeneration = generation;
+            playLeds = numLeds;
+            playPos = 0;
+            nextFrame = 0;
+            cursor = 0;
+            fill_solid(leds, numLeds, CRGB::Black);
+        } else {
+            playPos += static_cast<uint64_t>(now - lastCallMs) * p.value[Effects::SPEED] * header.fps / SPEED_UNITY;
+        }
+        lastCallMs = now;
+
+        // Frame n is due once the playhead reaches n; every frame is decoded in order
+        int decoded = 0;
+        while (static_cast<uint64_t>(nextFrame) * 1000 <= playPos && decoded < MAX_CATCHUP_FRAMES) {
+            if (nextFrame == header.frameCount) {
+                // The loop is over: frame 0 is a key frame, so it starts over without a reset
+                nextFrame = 0;
+                cursor = 0;
+                playPos -= static_cast<uint64_t>(header.frameCount) * 1000;
+                continue;
+            }
+            const uint32_t start = micros();
+            const size_t frameSize = decodeFrame(data + cursor, header.dataLength - cursor, leds[0].raw, numLeds);
+            if (frameSize == 0) break;
+            cursor += frameSize;
+            decodeUs += (static_cast<int32_t>(micros() - start) - static_cast<int32_t>(decodeUs)) / 16;
+            decoded++;
+            nextFrame++;
+        }
+        if (decoded == MAX_CATCHUP_FRAMES && static_cast<uint64_t>(nextFrame) * 1000 <= playPos) {
+            // Too far behind (e.g. played much faster than the frame rate): drop the backlog
+            playPos = static_cast<uint64_t>(nextFrame) * 1000;
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <FastLED.h>
+#include "../effects/Effects.h"
+#include "AnimationCodec.h"
+
+/**
+ * @brief Pre-rendered animations played back from the "anim" flash partition
+ *
+ * An animation is uploaded in chunks into the partition, which stays memory-mapped for the
+ * lifetime of the firmware. Playback reads frames straight through the mapping and decodes
+ * them into the render buffer; nothing is copied to RAM.
+ *
+ * Container (little-endian):
+ *   Header      magic "LXAN", version, fps, LED count (uint16), frame count (uint32),
+ *               data length (uint32)
+ *   Frames      type (uint8), payload length (uint16), payload
+ *     RAW       LED count RGB triples
+ *     RLE       runs of (count 1-255, r, g, b) covering all LEDs
+ *     DELTA     segments of (skip, count, count RGB triples) applied to the previous frame;
+ *               not allowed for the first frame
+ */
+namespace Animation {
+    /**
+     * @brief Description of the stored animation
+     */
+    struct Info {
+        bool ready;          ///< A valid animation is stored
+        uint8_t fps;
+        uint16_t numLeds;
+        uint32_t frameCount;
+        uint32_t size;       ///< Container size in bytes
+        uint32_t capacity;   ///< Partition size in bytes, 0 if the partition is missing
+        uint32_t decodeUs;   ///< Average time to decode one frame
+    };
+
+    /**
+     * @brief Maps the partition and validates the stored animation
+     */
+    void init();
+
+    /**
+     * @brief Starts an upload; playback stops until it is finished
+     * @param size Container size in bytes
+     * @return false if there is no partition or the container does not fit
+     */
+    bool beginUpload(size_t size);
+
+    /**
+     * @brief Writes the next chunk of the upload
+     * @param offset Byte offset; chunks must arrive in order
+     * @param data Chunk bytes
+     * @param length Chunk size
+     * @return false if no upload is active, the chunk is out of order or the flash write failed
+     */
+    bool writeChunk(size_t offset, const uint8_t *data, size_t length);
+
+    /**
+     * @brief Verifies the upload and makes it playable
+     * @param crc CRC-32 of the whole container
+     * @return false if data is missing, the CRC does not match or the container is malformed
+     */
+    bool finishUpload(uint32_t crc);
+
+    /**
+     * @brief Whether an animation can be played
+     */
+    bool isReady();
+
+    /**
+     * @brief Returns the description of the stored animation
+     */
+    Info getInfo();
+
+    /**
+     * @brief Decodes the frames due since the last call into the render buffer
+     * @param leds LED buffer; must hold the previous frame for delta frames
+     * @param numLeds Number of LEDs
+     * @param p Parameters of the ANIMATION mode (speed 64 plays at the recorded rate)
+     */
+    void render(CRGB *leds, int numLeds, const Effects::Params &p);
+}
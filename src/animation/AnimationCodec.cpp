@@ -0,0 +1,115 @@
+#include <string.h>
+#include "AnimationCodec.h"
+
+namespace Animation {
+    size_t validateFrame(const uint8_t *frame, size_t available, uint16_t numLeds, bool first) {
+        if (available < FRAME_HEADER_SIZE) return 0;
+        const size_t length = frame[1] | (frame[2] << 8);
+        if (FRAME_HEADER_SIZE + length > available) return 0;
+        const uint8_t *in = frame + FRAME_HEADER_SIZE;
+
+        switch (frame[0]) {
+            case FRAME_RAW:
+                if (length != numLeds * 3u) return 0;
+                break;
+            case FRAME_RLE: {
+                if (length % 4 != 0) return 0;
+                size_t pixels = 0;
+                for (size_t i = 0; i < length; i += 4) {
+                    if (in[i] == 0) return 0;
+                    pixels += in[i];
+                }
+                if (pixels != numLeds) return 0;
+                break;
+            }
+            case FRAME_DELTA: {
+                if (first) return 0;
+                size_t i = 0;
+                size_t pixel = 0;
+                while (i < length) {
+                    if (i + 2 > length) return 0;
+                    pixel += in[i];
+                    const size_t count = in[i + 1];
+                    i += 2;
+                    if (i + count * 3 > length || pixel + count > numLeds) return 0;
+                    pixel += count;
+                    i += count * 3;
+                }
+                break;
+            }
+            default:
+                return 0;
+        }
+        return FRAME_HEADER_SIZE + length;
+    }
+
+    bool validateContainer(const uint8_t *container, size_t size, uint32_t &badFrame) {
+        badFrame = 0;
+        if (size < sizeof(Header)) return false;
+        const Header &header = *reinterpret_cast<const Header *>(container);
+        badFrame = header.frameCount;
+        if (header.magic != MAGIC || header.version != VERSION || header.fps == 0 || header.numLeds == 0
+            || header.frameCount == 0 || header.dataLength != size - sizeof(Header)) {
+            return false;
+        }
+
+        const uint8_t *data = container + sizeof(Header);
+        size_t offset = 0;
+        for (uint32_t frame = 0; frame < header.frameCount; frame++) {
+            const size_t frameSize = validateFrame(data + offset, header.dataLength - offset, header.numLeds, frame == 0);
+            if (frameSize == 0) {
+                badFrame = frame;
+                return false;
+            }
+            offset += frameSize;
+        }
+        return offset == header.dataLength;
+    }
+
+    size_t decodeFrame(const uint8_t *frame, size_t available, uint8_t *rgb, int numLeds) {
+        if (available < FRAME_HEADER_SIZE) return 0;
+        const size_t length = frame[1] | (frame[2] << 8);
+        if (FRAME_HEADER_SIZE + length > available) return 0;
+        const uint8_t *in = frame + FRAME_HEADER_SIZE;
+        const uint8_t *end = in + length;
+
+        switch (frame[0]) {
+            case FRAME_RAW: {
+                const size_t pixels = length / 3 < static_cast<size_t>(numLeds) ? length / 3 : numLeds;
+                memcpy(rgb, in, pixels * 3);
+                break;
+            }
+            case FRAME_RLE: {
+                int pixel = 0;
+                for (; end - in >= 4 && pixel < numLeds; in += 4) {
+                    const int count = in[0] < numLeds - pixel ? in[0] : numLeds - pixel;
+                    for (uint8_t *out = rgb + pixel * 3; out < rgb + (pixel + count) * 3; out += 3) {
+                        out[0] = in[1];
+                        out[1] = in[2];
+                        out[2] = in[3];
+                    }
+                    pixel += in[0];
+                }
+                break;
+            }
+            case FRAME_DELTA: {
+                int pixel = 0;
+                while (end - in >= 2 && pixel < numLeds) {
+                    pixel += in[0];
+                    int count = in[1];
+                    in += 2;
+                    // A truncated segment copies only the triples that are there
+                    if (count * 3 > end - in) count = (end - in) / 3;
+                    if (pixel < numLeds) {
+                        const int copied = count < numLeds - pixel ? count : numLeds - pixel;
+                        memcpy(rgb + pixel * 3, in, copied * 3);
+                    }
+                    in += count * 3;
+                    pixel += count;
+                }
+                break;
+            }
+        }
+        return FRAME_HEADER_SIZE + length;
+    }
+}
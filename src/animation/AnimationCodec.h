@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Container format of pre-rendered animations and its frame decoder
+ *
+ * Works on plain RGB byte triples, so it runs on the host as well as against the mapped
+ * partition. See Animation.h for the container layout.
+ */
+namespace Animation {
+    constexpr uint8_t VERSION = 1;
+    constexpr uint32_t MAGIC = 0x4E41584C; // "LXAN"
+    constexpr size_t FRAME_HEADER_SIZE = 3;
+
+    enum FrameType : uint8_t {
+        FRAME_RAW = 0,
+        FRAME_RLE = 1,
+        FRAME_DELTA = 2
+    };
+
+    struct __attribute__((packed)) Header {
+        uint32_t magic;       ///< "LXAN"
+        uint8_t version;      ///< VERSION
+        uint8_t fps;          ///< Frames per second at speed 64
+        uint16_t numLeds;     ///< Pixels per frame
+        uint32_t frameCount;  ///< Frames in the loop
+        uint32_t dataLength;  ///< Bytes of frame data after the header
+    };
+
+    /**
+     * @brief Checks one frame against the container's LED count
+     * @param frame Frame header and payload
+     * @param available Bytes left in the frame data
+     * @param numLeds LED count of the container
+     * @param first true for frame 0, which must not be a delta frame
+     * @return Size of the frame including its header, or 0 if it is malformed
+     */
+    size_t validateFrame(const uint8_t *frame, size_t available, uint16_t numLeds, bool first);
+
+    /**
+     * @brief Checks the header and every frame of a container
+     * @param container Header followed by the frame data
+     * @param size Container size in bytes
+     * @param badFrame Set to the index of the first malformed frame, or to the frame count if
+     *                 only the header is wrong
+     * @return true if the container can be played
+     */
+    bool validateContainer(const uint8_t *container, size_t size, uint32_t &badFrame);
+
+    /**
+     * @brief Decodes a frame into an RGB buffer; pixels beyond the strip are dropped
+     *
+     * Never reads past `available` or writes past `numLeds` pixels, even for a frame that was
+     * not validated.
+     * @param frame Frame header and payload
+     * @param available Bytes left in the frame data
+     * @param rgb numLeds RGB triples; must hold the previous frame for delta frames
+     * @param numLeds Number of LEDs
+     * @return Size of the frame including its header, or 0 if it does not fit into `available`
+     */
+    size_t decodeFrame(const uint8_t *frame, size_t available, uint8_t *rgb, int numLeds);
+}
@@ -0,0 +1,99 @@
+#include <atomic>
+#include "AudioFeatures.h"
+
+namespace AudioFeatures {
+    static const char *TAG = "AUDIO";
+
+    static constexpr uint8_t MAGIC_0 = 'A';
+    static constexpr uint8_t MAGIC_1 = 'F';
+
+    // Sequence lock: odd while the network task is writing the slot. There is a single writer,
+    // so the writer side needs no lock; readers retry the copy if a write overlapped it.
+    static std::atomic<uint32_t> slotSequence{0};
+    static Frame slot = {};
+
+    // Owned by the writer (network task)
+    static uint16_t lastPacketSeq = 0;
+    static uint16_t lastBeatSeq = 0;
+    static uint32_t beatCount = 0;
+    static Stats stats = {};
+
+    /**
+     * Publishes the beat counter and, unless `data` is null, the features of a packet.
+     */
+    static void writeSlot(const uint8_t *data, uint32_t now) {
+        const uint32_t sequence = slotSequence.load(std::memory_order_relaxed);
+        slotSequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        if (data != nullptr) {
+            memcpy(slot.bands, data + 8, NUM_BANDS);
+            slot.peak = data[6];
+            slot.receivedAt = now;
+        }
+        slot.beats = beatCount;
+        slotSequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    bool isPacket(const uint8_t *data, size_t length) {
+        return length >= 2 && data[0] == MAGIC_0 && data[1] == MAGIC_1;
+    }
+
+    bool publish(const uint8_t *data, size_t length) {
+        if (length != PACKET_SIZE || data[2] != PACKET_VERSION) {
+            stats.malformed++;
+            ESP_LOGV(TAG, "Malformed feature packet: %u bytes", (unsigned) length);
+            return false;
+        }
+
+        const uint32_t now = millis();
+        const uint16_t packetSeq = data[3] | (data[4] << 8);
+        // Datagrams can be reordered; after a gap any sequence number starts a new stream
+        const bool streaming = stats.packets > 0 && now - slot.receivedAt < STALE_MS;
+        const bool beat = data[5] & FLAG_BEAT;
+        if (streaming && static_cast<int16_t>(packetSeq - lastPacketSeq) <= 0) {
+            stats.dropped++;
+            // The features of an overtaken packet are stale, but its beat still has to flash
+            // once; duplicates of a beat already counted are not
+            if (beat && static_cast<int16_t>(packetSeq - lastBeatSeq) > 0) {
+                lastBeatSeq = packetSeq;
+                beatCount++;
+                writeSlot(nullptr, now);
+            }
+            return false;
+        }
+        // A (re)started stream takes beats from packets its first packet overtook, too
+        if (!streaming) lastBeatSeq = packetSeq - 0x8000;
+        lastPacketSeq = packetSeq;
+        if (beat) {
+            lastBeatSeq = packetSeq;
+            beatCount++;
+        }
+        writeSlot(data, now);
+
+        stats.packets++;
+        return true;
+    }
+
+    bool read(Frame &frame) {
+        uint32_t before;
+        uint32_t after;
+        do {
+            before = slotSequence.load(std::memory_order_acquire);
+            frame = slot;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = slotSequence.load(std::memory_order_relaxed);
+        } while ((before & 1) != 0 || before != after);
+
+        if (before == 0 || millis() - frame.receivedAt >= STALE_MS) {
+            // Keep the beat counter so a resumed stream does not fake a beat
+            memset(frame.bands, 0, sizeof(frame.bands));
+            frame.peak = 0;
+            return false;
+        }
+        return true;
+    }
+
+    Stats getStats() {
+        return stats;
+    }
+}
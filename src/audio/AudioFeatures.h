@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief Audio features streamed by a PC or phone for the sound-reactive effects
+ *
+ * The device has no microphone: a client analyses the music and sends one small binary UDP
+ * datagram per analysis frame to the command port. Each packet replaces the previous one in a
+ * single latest-value slot guarded by a sequence lock, so the network task never blocks the
+ * render task and the renderer always sees the newest complete packet.
+ *
+ * Packet layout (little-endian, 16 bytes):
+ *   0  'A' 'F'    magic
+ *   2  version    PACKET_VERSION
+ *   3  seq        uint16 sequence number, wraps; older packets are dropped
+ *   5  flags      bit 0: beat detected in this frame
+ *   6  peak       0-255 overall level
+ *   7  reserved   0
+ *   8  bands[8]   0-255 energy per band, lowest frequency first
+ */
+namespace AudioFeatures {
+    constexpr size_t NUM_BANDS = 8;
+    constexpr size_t PACKET_SIZE = 8 + NUM_BANDS;
+    constexpr uint8_t PACKET_VERSION = 1;
+    constexpr uint8_t FLAG_BEAT = 0x01;
+
+    /**
+     * @brief Features after the stream stops for this long are treated as silence
+     */
+    constexpr uint32_t STALE_MS = 500;
+
+    /**
+     * @brief Latest features as seen by the effects
+     */
+    struct Frame {
+        uint8_t bands[NUM_BANDS]; ///< Energy per band
+        uint8_t peak;             ///< Overall level
+        uint32_t beats;           ///< Beats received so far; a change means a new beat
+        uint32_t receivedAt;      ///< millis() when the packet arrived
+    };
+
+    /**
+     * @brief Receive counters
+     */
+    struct Stats {
+        uint32_t packets;   ///< Packets accepted
+        uint32_t dropped;   ///< Packets rejected as late or duplicated
+        uint32_t malformed; ///< Packets with the magic but a wrong size or version
+    };
+
+    /**
+     * @brief Whether a datagram looks like a feature packet (magic only)
+     */
+    bool isPacket(const uint8_t *data, size_t length);
+
+    /**
+     * @brief Decodes a feature packet into the latest-value slot
+     * @param data Datagram
+     * @param length Datagram size
+     * @return true if the packet was accepted
+     */
+    bool publish(const uint8_t *data, size_t length);
+
+    /**
+     * @brief Reads the latest features without blocking; safe from any task
+     * @param frame Filled with the latest features, or silence if the stream is stale
+     * @return false if no fresh packet is available
+     */
+    bool read(Frame &frame);
+
+    /**
+     * @brief Returns the receive counters
+     */
+    Stats getStats();
+}
@@ -2,6 +2,12 @@
 #include "Bluetooth.h"
 #include <BLEDevice.h>
 #include <BLEServer.h>
+#include <esp_attr.h>
+#include <esp_bt.h>
+#include <esp_system.h>
+#include "../settings/Settings.h"
+#include "../events/AppEvents.h"
+#include "../board/BoardTraits.h"
 
 static const char *TAG = "BLUETOOTH";
 
@@ -14,10 +20,46 @@ static const char *TAG = "BLUETOOTH";
 #define CHARACTERISTIC_REGISTRATION_CREDENTIALS_UUID    "b9e70f80-d55e-4cd7-bec6-14be34590efc"
 #define CHARACTERISTIC_REGISTRATION_RESPONSE_UUID       "7048479a-23f2-4f5b-8113-e60e59294b5a"
 #define CHARACTERISTIC_WORK_TIME_UUID                   "2c1529cd-f45d-4739-9738-2886fe46f7f1"
+#define CHARACTERISTIC_CONTROL_UUID                     "4e1f6b1a-8a36-4c0e-9d3b-6f0c2b7d5a10"
+#define CHARACTERISTIC_STATE_UUID                       "4e1f6b1a-8a36-4c0e-9d3b-6f0c2b7d5a11"
+
+// Largest ATT MTU offered to the client; commands and replies are split to fit the negotiated value
+#define BLE_MTU 517
+#define BLE_COMMAND_MAX_LENGTH 512
+#define BLE_COMMAND_QUEUE_LENGTH 4
+// "ssid:password": 32-byte SSID, 63-character passphrase and the separator
+#define BLE_CREDENTIALS_MAX_LENGTH 96
+
+// Delay between a release request and the actual deinit, so the final notification goes out
+#define BLE_RELEASE_DELAY_MS 2000
+#define BOOT_INTO_BLE_MAGIC 0xB1E0B007
+// How long BLE stays up for new credentials after a reboot into BLE mode
+#define PROVISIONING_WINDOW_MS 300000
+
+/**
+ * One control characteristic write, copied out of the BLE stack context.
+ */
+struct BleCommand {
+    uint16_t length;
+    char data[BLE_COMMAND_MAX_LENGTH];
+};
+
+/**
+ * One credentials characteristic write, copied out of the BLE stack context.
+ */
+struct BleCredentials {
+    uint16_t length;
+    char data[BLE_CREDENTIALS_MAX_LENGTH];
+};
 
 // Local (module-level) states
 static BLECharacteristic *characteristicRegistrationCredentials = nullptr;
 static BLECharacteristic *characteristicRegistrationResponse = nullptr;
+static BLECharacteristic *characteristicControl = nullptr;
+static BLECharacteristic *characteristicState = nullptr;
+static QueueHandle_t commandQueue = nullptr;
+static QueueHandle_t credentialsQueue = nullptr;
+static char replyBuffer[Board::TRAITS.replyBufferSize];
 
 static bool bleConnected = false;
 static bool bleStarted = false;
@@ -27,6 +69,18 @@ static BLEService *serviceRegistration = nullptr;
 
 static BluetoothCredentialsReceivedCallback g_credentialsCallback = nullptr;
 static BluetoothConnectionStateCallback g_stateCallback = nullptr;
+static BluetoothCommandCallback g_commandCallback = nullptr;
+
+// Survives ESP.restart() without touching flash; set to reboot straight into BLE mode
+static RTC_NOINIT_ATTR uint32_t bootIntoBle;
+static bool memoryReleased = false;
+static bool releasePending = false;
+static unsigned long releaseRequestedAt = 0;
+static uint32_t heapBeforeRelease = 0;
+static uint32_t heapAfterRelease = 0;
+// Booted into BLE mode for re-provisioning: a reconnect with the old credentials keeps BLE up
+static bool provisioning = false;
+static unsigned long provisioningStartedAt = 0;
 
 // ---- Helper handlers ----
 class BluetoothServerEventCallback : public BLEServerCallbacks {
@@ -50,26 +104,92 @@ class BluetoothServerEventCallback : public BLEServerCallbacks {
     }
 };
 
+/**
+ * Runs in the BLE stack task: like control commands, credentials are only copied here and
+ * applied by Bluetooth::handle() from loop(), where Wi-Fi and Settings are owned. A newer
+ * write replaces one that has not been applied yet.
+ */
 class BLECharacteristicRegistrationResponseCallbacks : public BLECharacteristicCallbacks {
     void onWrite(BLECharacteristic *pCharacteristic) override {
-        String value = pCharacteristic->getValue();
-        if (!value.isEmpty() && g_credentialsCallback) {
-            g_credentialsCallback(value);
-            ESP_LOGI(TAG, "Received registration response: %s", value.c_str());
+        if (credentialsQueue == nullptr) return;
+        const size_t length = pCharacteristic->getLength();
+        if (length == 0) return;
+        if (length > BLE_CREDENTIALS_MAX_LENGTH) {
+            ESP_LOGW(TAG, "Credentials of %u bytes dropped", (unsigned) length);
+            return;
+        }
+
+        BleCredentials credentials;
+        credentials.length = length;
+        memcpy(credentials.data, pCharacteristic->getData(), length);
+        xQueueOverwrite(credentialsQueue, &credentials);
+        AppEvents::notify(AppEvents::BLE);
+    }
+};
+
+/**
+ * Runs in the BLE stack task: only copies the write into the command queue, which is drained by
+ * Bluetooth::handle() from loop(), so command handling never blocks the stack.
+ */
+class BLECharacteristicControlCallbacks : public BLECharacteristicCallbacks {
+    void onWrite(BLECharacteristic *pCharacteristic) override {
+        if (commandQueue == nullptr) return;
+        const size_t length = pCharacteristic->getLength();
+        if (length == 0) return;
+
+        BleCommand command;
+        command.length = length < BLE_COMMAND_MAX_LENGTH ? length : BLE_COMMAND_MAX_LENGTH;
+        memcpy(command.data, pCharacteristic->getData(), command.length);
+        if (xQueueSend(commandQueue, &command, 0) != pdTRUE) {
+            ESP_LOGW(TAG, "Command queue full, write dropped");
         }
+        AppEvents::notify(AppEvents::BLE);
     }
 };
 
 static BluetoothServerEventCallback serverCallbacks;
 static BLECharacteristicRegistrationResponseCallbacks characteristicCallbacks;
+static BLECharacteristicControlCallbacks controlCallbacks;
+
+/**
+ * Sends a notification, split into chunks that fit the negotiated MTU.
+ */
+static void notifyChunked(BLECharacteristic *characteristic, const char *value, size_t size) {
+    if (!bleConnected || characteristic == nullptr) return;
+
+    size_t chunkSize = bleServer->getPeerMTU(bleServer->getConnId());
+    chunkSize = chunkSize > 3 ? chunkSize - 3 : 20;
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(value);
+    for (size_t offset = 0; offset < size; offset += chunkSize) {
+        const size_t length = size - offset < chunkSize ? size - offset : chunkSize;
+        characteristic->setValue(const_cast<uint8_t *>(data + offset), length);
+        characteristic->notify();
+    }
+}
 
 namespace Bluetooth {
     void init(
         BluetoothCredentialsReceivedCallback credentialsCallback,
-        BluetoothConnectionStateCallback stateCallback
+        BluetoothConnectionStateCallback stateCallback,
+        BluetoothCommandCallback commandCallback
     ) {
         g_credentialsCallback = credentialsCallback;
         g_stateCallback = stateCallback;
+        g_commandCallback = commandCallback;
+        if (commandQueue == nullptr) {
+            commandQueue = xQueueCreate(BLE_COMMAND_QUEUE_LENGTH, sizeof(BleCommand));
+        }
+        if (credentialsQueue == nullptr) {
+            credentialsQueue = xQueueCreate(1, sizeof(BleCredentials));
+        }
+
+        if (esp_reset_reason() == ESP_RST_SW && bootIntoBle == BOOT_INTO_BLE_MAGIC) {
+            ESP_LOGI(TAG, "Rebooted for re-provisioning, enabling BLE");
+            bootIntoBle = 0;
+            enable();
+            provisioning = true;
+            provisioningStartedAt = millis();
+        }
     }
 
     void enable() {
@@ -78,9 +198,20 @@ namespace Bluetooth {
             return;
         }
 
+        if (memoryReleased) {
+            // The controller memory is gone; the only way back is a clean boot straight into BLE mode
+            ESP_LOGI(TAG, "BLE memory was released, rebooting into BLE mode");
+            bootIntoBle = BOOT_INTO_BLE_MAGIC;
+            Settings::flush();
+            ESP.restart();
+            return;
+        }
+
         ESP_LOGI(TAG, "Starting BLE work!");
+        releasePending = false;
         if (!isInitialized) {
             BLEDevice::init(BLE_NAME);
+            BLEDevice::setMTU(BLE_MTU);
             isInitialized = true;
         }
 
@@ -100,6 +231,16 @@ namespace Bluetooth {
             characteristicRegistrationResponse = serviceRegistration->createCharacteristic(
                 CHARACTERISTIC_REGISTRATION_RESPONSE_UUID,
                 BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY);
+
+            // Command channel: write-without-response keeps slider traffic off the ATT round trip
+            characteristicControl = serviceRegistration->createCharacteristic(
+                CHARACTERISTIC_CONTROL_UUID,
+                BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_WRITE_NR);
+            characteristicControl->setCallbacks(&controlCallbacks);
+
+            characteristicState = serviceRegistration->createCharacteristic(
+                CHARACTERISTIC_STATE_UUID,
+                BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY);
         }
 
         serviceRegistration->start();
@@ -128,6 +269,7 @@ namespace Bluetooth {
         // 1. Reset state flags BEFORE deinitialization
         bleStarted = false;
         bleConnected = false;
+        provisioning = false;
 
         // 2. Stop advertising and disconnect connections
         BLEDevice::getAdvertising()->stop();
@@ -155,10 +297,8 @@ namespace Bluetooth {
         // but this still won't fix the hanging problem and in most cases
         // it's enough to just stop broadcasting.
 
-        // 4. Reset characteristic pointers; the services themselves are preserved
-        //    in serviceRegistration for reuse on subsequent enable() calls.
-        characteristicRegistrationCredentials = nullptr;
-        characteristicRegistrationResponse = nullptr;
+        // 4. The service and its characteristics are preserved in serviceRegistration
+        //    for reuse on subsequent enable() calls.
 
         if (g_stateCallback) {
             g_stateCallback(BT_DISABLED);
@@ -166,15 +306,103 @@ namespace Bluetooth {
         ESP_LOGI(TAG, "BLE has been stopped");
     }
 
-    void sendWiFiConnectInfo(bool success, const String &value) {
+    void sendWiFiConnectInfo(bool success, const char *value) {
         if (bleConnected && characteristicRegistrationResponse) {
-            characteristicRegistrationResponse->setValue(value.c_str());
+            characteristicRegistrationResponse->setValue(value);
             characteristicRegistrationResponse->notify();
         }
-        if (success == true) disable();
+        if (success == true && !provisioning) disable();
     }
 
     bool isConnected() {
         return bleConnected;
     }
+
+    void releaseMemory() {
+        // Deferred while BLE is up (e.g. the re-provisioning window): handle() releases after disable()
+        if (memoryReleased || releasePending) return;
+        releasePending = true;
+        releaseRequestedAt = millis();
+    }
+
+    uint32_t msUntilDeadline() {
+        if (provisioning) {
+            const unsigned long elapsed = millis() - provisioningStartedAt;
+            return elapsed >= PROVISIONING_WINDOW_MS ? 0 : PROVISIONING_WINDOW_MS - elapsed;
+        }
+        if (!releasePending || bleStarted) return AppEvents::NO_DEADLINE;
+        const unsigned long elapsed = millis() - releaseRequestedAt;
+        return elapsed >= BLE_RELEASE_DELAY_MS ? 0 : BLE_RELEASE_DELAY_MS - elapsed;
+    }
+
+    MemoryStats getMemoryStats() {
+        return {memoryReleased, heapBeforeRelease, heapAfterRelease};
+    }
+
+    static void releaseNow() {
+        releasePending = false;
+        heapBeforeRelease = ESP.getFreeHeap();
+        if (isInitialized) {
+            // Safe here: BLE is never initialized again in this boot, enable() reboots instead
+            BLEDevice::deinit(true);
+            isInitialized = false;
+            bleServer = nullptr;
+            serviceRegistration = nullptr;
+            characteristicRegistrationCredentials = nullptr;
+            characteristicRegistrationResponse = nullptr;
+            characteristicControl = nullptr;
+            characteristicState = nullptr;
+        } else {
+#if CONFIG_IDF_TARGET_ESP32
+            esp_bt_mem_release(ESP_BT_MODE_BTDM);
+#else
+            esp_bt_mem_release(ESP_BT_MODE_BLE);
+#endif
+        }
+        memoryReleased = true;
+        heapAfterRelease = ESP.getFreeHeap();
+        ESP_LOGI(TAG, "BLE memory released: free heap %u -> %u bytes",
+                 (unsigned) heapBeforeRelease, (unsigned) heapAfterRelease);
+    }
+
+    void notifyState(const char *value) {
+        notifyChunked(characteristicState, value, strlen(value));
+    }
+
+    void handle() {
+        if (provisioning && millis() - provisioningStartedAt >= PROVISIONING_WINDOW_MS) {
+            ESP_LOGI(TAG, "Re-provisioning window expired without new credentials");
+            disable();
+        }
+        if (releasePending && !bleStarted && millis() - releaseRequestedAt >= BLE_RELEASE_DELAY_MS) {
+            releaseNow();
+        }
+
+        BleCredentials credentials;
+        if (credentialsQueue != nullptr && xQueueReceive(credentialsQueue, &credentials, 0) == pdTRUE) {
+            // New credentials end the re-provisioning window: their connect result closes BLE
+            provisioning = false;
+            ESP_LOGI(TAG, "Received credentials of %u bytes", (unsigned) credentials.length);
+            if (g_credentialsCallback) g_credentialsCallback(String(credentials.data, credentials.length));
+        }
+        if (commandQueue == nullptr) return;
+
+        BleCommand command;
+        while (xQueueReceive(commandQueue, &command, 0) == pdTRUE) {
+            if (g_commandCallback == nullptr) continue;
+            // A single write may batch several newline-separated commands
+            size_t start = 0;
+            for (size_t i = 0; i <= command.length; i++) {
+                if (i < command.length && command.data[i] != '\n') continue;
+                if (i > start) {
+                    ResponseWriter reply(replyBuffer, Board::TRAITS.replyBufferSize);
+                    g_commandCallback(command.data + start, i - start, reply);
+                    // The newline takes the place of the terminating NUL
+                    replyBuffer[reply.length()] = '\n';
+                    notifyChunked(characteristicState, replyBuffer, reply.length() + 1);
+                }
+                start = i + 1;
+            }
+        }
+    }
 }
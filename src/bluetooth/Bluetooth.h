@@ -1,5 +1,7 @@
 #pragma once
 
+#include "../parser/ResponseWriter.h"
+
 /**
  * @brief Bluetooth connection state enumeration
  */
@@ -11,7 +13,7 @@ enum BT_ConnectionState {
 };
 
 /**
- * @brief Callback type for receiving credentials via BLE
+ * @brief Callback type for receiving credentials via BLE; called from Bluetooth::handle()
  * @param value String containing the received data
  */
 typedef void (*BluetoothCredentialsReceivedCallback)(String value);
@@ -22,19 +24,41 @@ typedef void (*BluetoothCredentialsReceivedCallback)(String value);
  */
 typedef void (*BluetoothConnectionStateCallback)(BT_ConnectionState value);
 
+/**
+ * @brief Callback type for commands written to the control characteristic
+ * @param message Command line (same JSON format as TCP/UDP), not NUL-terminated
+ * @param length Length of the command line
+ * @param reply Output reply, sent back as a state notification
+ * @return true if the command was processed successfully
+ */
+typedef bool (*BluetoothCommandCallback)(const char *message, size_t length, ResponseWriter &reply);
+
 namespace Bluetooth {
+    /**
+     * @brief Heap reclaimed by releasing the BLE stack
+     */
+    struct MemoryStats {
+        bool released;       ///< BLE host and controller memory has been released
+        uint32_t heapBefore; ///< Free heap right before the release
+        uint32_t heapAfter;  ///< Free heap right after the release
+    };
+
     /**
      * @brief Initializes the BLE module and system handlers (Wi-Fi events, etc.)
-     * @param credentialsCallback Function called when the credentials characteristic is written
+     * @param credentialsCallback Function called from handle() when the credentials characteristic is written
      * @param stateCallback Function called when the connection state changes
+     * @param commandCallback Function called from handle() for each control command
      */
     void init(
         BluetoothCredentialsReceivedCallback credentialsCallback,
-        BluetoothConnectionStateCallback stateCallback
+        BluetoothConnectionStateCallback stateCallback,
+        BluetoothCommandCallback commandCallback
     );
 
     /**
      * @brief Enables BLE mode (creates server/services/characteristics and starts advertising)
+     *
+     * If BLE memory has been released, reboots straight into BLE mode instead.
      */
     void enable();
 
@@ -51,8 +75,43 @@ namespace Bluetooth {
 
     /**
      * @brief Sends Wi-Fi connection status to the connected BLE client
+     *
+     * A successful connection disables BLE, except during the re-provisioning window after
+     * a reboot into BLE mode: that lasts until new credentials arrive or it times out.
      * @param success Connection success flag
      * @param value Optional message or status info
      */
-    void sendWiFiConnectInfo(bool success, const String &value);
+    void sendWiFiConnectInfo(bool success, const char *value);
+
+    /**
+     * @brief Requests a full release of the BLE host and controller memory
+     *
+     * Performed from handle() once BLE is disabled, so it waits out the re-provisioning
+     * window. BLE cannot be started again in this boot; a later enable() reboots into BLE mode.
+     */
+    void releaseMemory();
+
+    /**
+     * @brief Returns how long until handle() has a pending memory release or the end of the
+     *        re-provisioning window to act on
+     * @return Milliseconds until the release, or AppEvents::NO_DEADLINE
+     */
+    uint32_t msUntilDeadline();
+
+    /**
+     * @brief Returns free heap measured around the BLE memory release
+     */
+    MemoryStats getMemoryStats();
+
+    /**
+     * @brief Sends a state notification to the connected BLE client
+     * @param value State message
+     */
+    void notifyState(const char *value);
+
+    /**
+     * @brief Periodic handler (call in loop()) that applies queued credentials and executes
+     *        queued control commands
+     */
+    void handle();
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "BoardTraits.h"
+
 #if defined(BOARD_ESP32_DEVKIT)
     #include "esp32devkit/Pins.h"
     #include "bt_indicator/LedBtIndicator.h"
@@ -7,11 +9,11 @@
 #elif defined(BOARD_M5_NANOC6)
     #include "m5nanoc6/Pins.h"
     #include "bt_indicator/RgbLedBtIndicator.h"
-    using BtIndicator = RgbLedBtIndicator<Pins::LED>;
+    using BtIndicator = RgbLedBtIndicator;
 #elif defined(BOARD_M5_ATOMS3)
     #include "m5atoms3/Pins.h"
     #include "bt_indicator/RgbLedBtIndicator.h"
-    using BtIndicator = RgbLedBtIndicator<Pins::LED>;
+    using BtIndicator = RgbLedBtIndicator;
 #else
     #error "Board not defined!"
 #endif
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Peripheral that clocks the strip out
+ */
+enum class OutputDriver : uint8_t {
+    RMT, ///< One RMT TX channel per LED output (FastLED default)
+    I2S  ///< Parallel I2S output, classic ESP32 only; needs -D FASTLED_ESP32_I2S
+};
+
+/**
+ * @brief Compile-time description of a board. Buffer sizes, task placement and LED outputs
+ * are derived from it, so each board gets its own layout without runtime checks.
+ */
+struct BoardTraits {
+    uint8_t cores;              ///< CPU cores available to FreeRTOS
+    bool psram;                 ///< External PSRAM fitted
+    uint8_t rmtTxChannels;      ///< RMT channels able to transmit
+    uint16_t maxLeds;           ///< Longest strip the frame buffer is sized for
+    uint8_t defaultFps;         ///< Frame rate of the effects task
+    OutputDriver output;        ///< Strip output peripheral
+    bool statusPixel;           ///< Addressable RGB status LED on Pins::LED
+    uint16_t commandBufferSize; ///< Longest command line accepted over UDP and TCP
+    uint16_t replyBufferSize;   ///< Longest reply to one command over UDP, TCP and BLE
+};
+
+/**
+ * @brief Placement of one application task
+ */
+struct TaskPlacement {
+    int8_t core;      ///< Core the task is pinned to, or Board::ANY_CORE
+    uint8_t priority; ///< FreeRTOS priority; loop() runs at 1
+    uint16_t stack;   ///< Stack size in bytes
+};
+
+/**
+ * @brief Where the application tasks run. The renderer gets its own core where there is one,
+ * so bursts in the Wi-Fi/LwIP tasks do not delay frames.
+ */
+struct TaskLayout {
+    TaskPlacement render;      ///< Effects rendering and LED output
+    TaskPlacement network;     ///< UDP and TCP servers, command application
+    TaskPlacement persistence; ///< Deferred NVS commits
+};
+
+namespace Board {
+    constexpr int8_t ANY_CORE = -1;
+}
+
+#if defined(BOARD_ESP32_DEVKIT)
+    #include "esp32devkit/Traits.h"
+#elif defined(BOARD_M5_NANOC6)
+    #include "m5nanoc6/Traits.h"
+#elif defined(BOARD_M5_ATOMS3)
+    #include "m5atoms3/Traits.h"
+#else
+    #error "Board not defined!"
+#endif
+
+namespace Board {
+    /// WS2812 wire time per LED in microseconds (24 bits at 800 kHz plus margin)
+    constexpr uint32_t LED_WIRE_TIME_US = 30;
+
+    /// LED outputs driven by the board: the strip plus the optional status pixel
+    constexpr uint8_t LED_OUTPUTS = 1 + (TRAITS.statusPixel ? 1 : 0);
+
+    static_assert(TRAITS.cores == 1 || TRAITS.cores == 2, "ESP32 parts have one or two cores");
+    static_assert(TRAITS.maxLeds > 0, "Board must drive at least one LED");
+    static_assert(TRAITS.defaultFps > 0, "Board frame rate must be positive");
+    static_assert(static_cast<uint32_t>(TRAITS.maxLeds) * LED_WIRE_TIME_US * TRAITS.defaultFps <= 1000000,
+                  "A full strip cannot be clocked out at the default frame rate");
+    // RGBW strips send 4/3 as many pixel slots; Switcher stretches the frame period to their
+    // wire time, which must still allow a usable rate
+    static_assert((static_cast<uint32_t>(TRAITS.maxLeds) * 4 + 2) / 3 * LED_WIRE_TIME_US * 30 <= 1000000,
+                  "A full RGBW strip cannot be clocked out at 30 fps");
+    static_assert(TRAITS.output != OutputDriver::RMT || TRAITS.rmtTxChannels >= LED_OUTPUTS,
+                  "Not enough RMT TX channels for the strip and the status pixel");
+    static_assert(TRAITS.output != OutputDriver::I2S || TRAITS.cores == 2,
+                  "Parallel I2S output is only available on the classic dual-core ESP32");
+#ifdef FASTLED_ESP32_I2S
+    static_assert(TRAITS.output == OutputDriver::I2S, "FASTLED_ESP32_I2S is set but the board uses RMT");
+#else
+    static_assert(TRAITS.output == OutputDriver::RMT, "I2S output needs -D FASTLED_ESP32_I2S");
+#endif
+    static_assert(TRAITS.commandBufferSize >= 128, "Command buffer too small for the protocol");
+    // DataParser checks that get_status fits
+    static_assert(TRAITS.replyBufferSize >= 1024, "Reply buffer too small for the protocol");
+
+    /// Priority of the LwIP tcpip task; application tasks must stay below the network stack
+    constexpr uint8_t TCPIP_PRIORITY = 18;
+
+    constexpr bool isValidPlacement(const TaskPlacement &task) {
+        return (task.core == ANY_CORE || (task.core >= 0 && task.core < TRAITS.cores))
+               && task.priority >= 1 && task.priority < TCPIP_PRIORITY && task.stack >= 2048;
+    }
+
+    static_assert(isValidPlacement(TASKS.render) && isValidPlacement(TASKS.network)
+                  && isValidPlacement(TASKS.persistence), "Task placed on a missing core or at an invalid priority");
+    static_assert(TASKS.render.priority > TASKS.network.priority,
+                  "The renderer must preempt network I/O");
+    static_assert(TASKS.persistence.priority <= 1, "Persistence runs as a background job at loop() priority or lower");
+}
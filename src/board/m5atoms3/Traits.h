@@ -0,0 +1,23 @@
+#pragma once
+
+namespace Board {
+    // ESP32-S3FN8: dual core, 4 RMT TX channels, no PSRAM
+    constexpr BoardTraits TRAITS = {
+        2,                 // cores
+        false,             // psram
+        4,                 // rmtTxChannels
+        512,               // maxLeds
+        60,                // defaultFps
+        OutputDriver::RMT, // output
+        true,              // statusPixel
+        1024,              // commandBufferSize
+        4096,              // replyBufferSize
+    };
+
+    // Renderer alone on the APP core; sockets next to LwIP on the PRO core
+    constexpr TaskLayout TASKS = {
+        {1, 3, 4096},        // render
+        {0, 2, 6144},        // network
+        {ANY_CORE, 1, 4096}, // persistence
+    };
+}
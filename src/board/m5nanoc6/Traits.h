@@ -0,0 +1,23 @@
+#pragma once
+
+namespace Board {
+    // ESP32-C6: single core shared with the radio, 2 RMT TX channels, no PSRAM
+    constexpr BoardTraits TRAITS = {
+        1,                 // cores
+        false,             // psram
+        2,                 // rmtTxChannels
+        256,               // maxLeds
+        50,                // defaultFps
+        OutputDriver::RMT, // output
+        true,              // statusPixel
+        512,               // commandBufferSize
+        2048,              // replyBufferSize
+    };
+
+    // Single core: priorities alone keep frames ahead of network I/O
+    constexpr TaskLayout TASKS = {
+        {ANY_CORE, 3, 4096}, // render
+        {ANY_CORE, 2, 6144}, // network
+        {ANY_CORE, 1, 4096}, // persistence
+    };
+}
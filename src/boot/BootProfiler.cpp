@@ -0,0 +1,33 @@
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "BootProfiler.h"
+
+namespace BootProfiler {
+    static const char *TAG = "BOOT";
+
+    static const char *const PHASE_NAMES[NUM_PHASES] = {
+        "serial",
+        "settings",
+        "first_light",
+        "setup",
+        "wifi_start",
+        "wifi_connected",
+        "servers",
+    };
+
+    static uint32_t timestamps[NUM_PHASES] = {};
+
+    void mark(Phase phase) {
+        if (phase >= NUM_PHASES || timestamps[phase] != 0) return;
+        timestamps[phase] = static_cast<uint32_t>(esp_timer_get_time());
+        ESP_LOGI(TAG, "%s reached at %lu us", PHASE_NAMES[phase], (unsigned long) timestamps[phase]);
+    }
+
+    uint32_t elapsedUs(Phase phase) {
+        return phase < NUM_PHASES ? timestamps[phase] : 0;
+    }
+
+    const char *name(Phase phase) {
+        return phase < NUM_PHASES ? PHASE_NAMES[phase] : "";
+    }
+}
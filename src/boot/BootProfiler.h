@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Boot timeline instrumentation
+ *
+ * Records the time since boot at which each startup phase is first reached,
+ * so that time-to-first-light and time-to-reachable can be reported.
+ */
+namespace BootProfiler {
+    /**
+     * @brief Startup phases in the order they are normally reached
+     */
+    enum Phase {
+        SERIAL_READY,    ///< Serial port initialized
+        SETTINGS_LOADED, ///< Light settings restored from NVS
+        FIRST_LIGHT,     ///< First frame of the restored effect shown on the strip
+        SETUP_DONE,      ///< setup() returned
+        WIFI_STARTED,    ///< Radio brought up and association started
+        WIFI_CONNECTED,  ///< IP address obtained
+        SERVERS_READY,   ///< TCP and UDP servers listening, device reachable
+        NUM_PHASES
+    };
+
+    /**
+     * @brief Records the current time for a phase; only the first call per phase is kept
+     * @param phase Reached phase
+     */
+    void mark(Phase phase);
+
+    /**
+     * @brief Returns the time since boot at which a phase was reached
+     * @param phase Phase to query
+     * @return Microseconds since boot, or 0 if the phase was not reached yet
+     */
+    uint32_t elapsedUs(Phase phase);
+
+    /**
+     * @brief Returns a short name for a phase (used as JSON key)
+     * @param phase Phase to query
+     */
+    const char *name(Phase phase);
+}
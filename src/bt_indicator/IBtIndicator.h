@@ -19,4 +19,10 @@ public:
      * @brief Periodic handler (call in loop())
      */
     virtual void handle() = 0;
+
+    /**
+     * @brief Returns how long until handle() has to run again
+     * @return Milliseconds until the next blink toggle, or UINT32_MAX when not blinking
+     */
+    virtual uint32_t msUntilDeadline() const = 0;
 };
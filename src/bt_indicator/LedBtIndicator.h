@@ -48,6 +48,15 @@ public:
         }
     }
 
+    uint32_t msUntilDeadline() const override {
+        if (_blinkIntervalMs <= 0) {
+            return UINT32_MAX;
+        }
+        const unsigned long elapsed = millis() - _lastBlinkTime;
+        const unsigned long interval = static_cast<unsigned long>(_blinkIntervalMs);
+        return elapsed >= interval ? 0 : interval - elapsed;
+    }
+
 private:
     unsigned long _lastBlinkTime;
     int _blinkIntervalMs;
@@ -1,54 +1,47 @@
 #include <Arduino.h>
 #include "Button.h"
+#include "../events/AppEvents.h"
 
 Button::Button(const uint8_t pin)
     : _pin(pin),
       _activeLow(true),
-      _lastState(HIGH),
-      _isPressed(false),
-      _longPressSent(false),
-      _lastDebounceTime(0),
-      _pressStartTime(0) {
+      _edges(nullptr) {
     pinMode(pin, INPUT_PULLUP);
 }
 
-ButtonAction Button::handle() {
-    ButtonAction action = NO_ACTION;
-    bool currentState = digitalRead(_pin);
-    if (_activeLow) {
-        currentState = !currentState;
-    }
-    const unsigned long now = millis();
-
-    if (currentState != _lastState) {
-        _lastDebounceTime = now;
+void Button::begin() {
+    _edges = xQueueCreate(EDGE_QUEUE_LENGTH, sizeof(Edge));
+    // Seed the classifier with the current level in case the button is held at boot
+    const bool level = digitalRead(_pin);
+    if (_activeLow ? !level : level) {
+        _classifier.onEdge(true, millis());
     }
+    attachInterruptArg(digitalPinToInterrupt(_pin), onEdgeInterrupt, this, CHANGE);
+}
 
-    if ((now - _lastDebounceTime) > DEBOUNCE_MS) {
-        if (currentState != _isPressed) {
-            _isPressed = currentState;
+void IRAM_ATTR Button::onEdgeInterrupt(void *arg) {
+    auto *button = static_cast<Button *>(arg);
+    bool level = digitalRead(button->_pin);
+    const Edge edge = {static_cast<uint32_t>(millis()), button->_activeLow ? !level : level};
 
-            if (_isPressed) {
-                _pressStartTime = now;
-                _longPressSent = false;
-            } else {
-                const unsigned long duration = now - _pressStartTime;
-                if (duration < MEDIUM_PRESS_MS) {
-                    action = SHORT_PRESS;
-                } else if (duration < LONG_PRESS_MS) {
-                    action = MEDIUM_PRESS;
-                }
-            }
-        }
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    // On overflow the edge is dropped; the classifier resynchronizes on the next one
+    xQueueSendFromISR(button->_edges, &edge, &higherPriorityTaskWoken);
+    if (higherPriorityTaskWoken) portYIELD_FROM_ISR();
+    AppEvents::notifyFromISR(AppEvents::BUTTON);
+}
 
-        if (_isPressed && !_longPressSent) {
-            if ((now - _pressStartTime) >= LONG_PRESS_MS) {
-                _longPressSent = true;
-                action = LONG_PRESS;
-            }
+ButtonAction Button::handle() {
+    if (_edges != nullptr) {
+        Edge edge;
+        while (xQueueReceive(_edges, &edge, 0) == pdTRUE) {
+            _classifier.onEdge(edge.pressed, edge.timeMs);
         }
     }
+    return _classifier.poll(millis());
+}
 
-    _lastState = currentState;
-    return action;
+uint32_t Button::msUntilDeadline() const {
+    if (_edges != nullptr && uxQueueMessagesWaiting(_edges) > 0) return 0;
+    return _classifier.msUntilDeadline(millis());
 }
@@ -1,17 +1,15 @@
 #pragma once
 
-/**
- * @brief Button action types
- */
-enum ButtonAction {
-    NO_ACTION,    ///< No action detected
-    SHORT_PRESS,  ///< Short press detected
-    MEDIUM_PRESS, ///< Medium press detected
-    LONG_PRESS    ///< Long press detected
-};
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "ButtonClassifier.h"
 
 /**
- * @brief Class for handling button presses with debouncing and multi-stage press detection
+ * @brief Interrupt-driven button with debouncing and gesture detection
+ *
+ * A GPIO interrupt timestamps every edge into a queue; handle() drains the queue into a
+ * ButtonClassifier, so press durations are measured from the edges themselves and not from
+ * how often loop() runs.
  */
 class Button {
 public:
@@ -21,21 +19,37 @@ public:
     explicit Button(uint8_t pin);
 
     /**
-     * @brief Periodic handler to process button state and detect actions
+     * @brief Creates the edge queue and attaches the GPIO interrupt (call in setup())
+     */
+    void begin();
+
+    /**
+     * @brief Periodic handler to process queued edges and detect actions
      * @return The detected ButtonAction
      */
     ButtonAction handle();
 
+    /**
+     * @brief Returns how long the caller may wait before handle() has timed work to do
+     * @return Milliseconds until the next gesture timer expires, or ButtonClassifier::NO_DEADLINE
+     */
+    uint32_t msUntilDeadline() const;
+
 private:
+    /**
+     * @brief Edge captured by the interrupt handler
+     */
+    struct Edge {
+        uint32_t timeMs;
+        bool pressed;
+    };
+
+    static void onEdgeInterrupt(void *arg);
+
     uint8_t _pin;
     bool _activeLow;
-    bool _lastState;
-    bool _isPressed;
-    bool _longPressSent;
-    unsigned long _lastDebounceTime;
-    unsigned long _pressStartTime;
-
-    static constexpr unsigned long DEBOUNCE_MS = 50;
-    static constexpr unsigned long MEDIUM_PRESS_MS = 1000;
-    static constexpr unsigned long LONG_PRESS_MS = 5000;
-};
\ No newline at end of file
+    QueueHandle_t _edges;
+    ButtonClassifier _classifier;
+
+    static constexpr UBaseType_t EDGE_QUEUE_LENGTH = 32;
+};
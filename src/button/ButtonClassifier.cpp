@@ -0,0 +1,153 @@
+#include "ButtonClassifier.h"
+
+ButtonClassifier::ButtonClassifier()
+    : _state(IDLE),
+      _rawPressed(false),
+      _stablePressed(false),
+      _lastEdgeTime(0),
+      _pressStartTime(0),
+      _releaseTime(0),
+      _nextRepeatTime(0),
+      _longPressSent(false),
+      _actions{},
+      _head(0),
+      _count(0) {
+}
+
+void ButtonClassifier::onEdge(const bool pressed, const uint32_t timeMs) {
+    // The previous level held long enough to count: commit it at the time it started
+    if (_rawPressed != _stablePressed && timeMs - _lastEdgeTime >= DEBOUNCE_MS) {
+        applyDebounced(_lastEdgeTime);
+    }
+    _rawPressed = pressed;
+    _lastEdgeTime = timeMs;
+}
+
+ButtonAction ButtonClassifier::poll(const uint32_t nowMs) {
+    if (_rawPressed != _stablePressed && nowMs - _lastEdgeTime >= DEBOUNCE_MS) {
+        applyDebounced(_lastEdgeTime);
+    }
+
+    // A release that is still being debounced ends the hold at its edge time, not at nowMs
+    const uint32_t heldUntil = (_stablePressed && !_rawPressed) ? _lastEdgeTime : nowMs;
+
+    switch (_state) {
+        case PRESSED:
+            if (!_longPressSent && heldUntil - _pressStartTime >= LONG_PRESS_MS) {
+                _longPressSent = true;
+                push(LONG_PRESS);
+            }
+            break;
+        case WAIT_SECOND:
+            if (nowMs - _releaseTime >= DOUBLE_CLICK_MS) {
+                _state = IDLE;
+                push(SHORT_PRESS);
+            }
+            break;
+        case SECOND_PRESS:
+            if (heldUntil - _pressStartTime >= HOLD_REPEAT_DELAY_MS) {
+                _state = REPEATING;
+                _nextRepeatTime = _pressStartTime + HOLD_REPEAT_DELAY_MS + HOLD_REPEAT_INTERVAL_MS;
+                push(HOLD_REPEAT);
+            }
+            break;
+        case REPEATING:
+            if (static_cast<int32_t>(heldUntil - _nextRepeatTime) >= 0) {
+                _nextRepeatTime += HOLD_REPEAT_INTERVAL_MS;
+                push(HOLD_REPEAT);
+            }
+            break;
+        case IDLE:
+            break;
+    }
+
+    if (_count == 0) return NO_ACTION;
+    const ButtonAction action = _actions[_head];
+    _head = (_head + 1) % QUEUE_SIZE;
+    _count--;
+    return action;
+}
+
+uint32_t ButtonClassifier::msUntilDeadline(const uint32_t nowMs) const {
+    if (_count > 0) return 0;
+
+    uint32_t deadline = NO_DEADLINE;
+    const auto until = [nowMs, &deadline](uint32_t at) {
+        const int32_t remaining = static_cast<int32_t>(at - nowMs);
+        const uint32_t ms = remaining > 0 ? static_cast<uint32_t>(remaining) : 0;
+        if (ms < deadline) deadline = ms;
+    };
+
+    if (_rawPressed != _stablePressed) until(_lastEdgeTime + DEBOUNCE_MS);
+    switch (_state) {
+        case PRESSED:
+            if (!_longPressSent) until(_pressStartTime + LONG_PRESS_MS);
+            break;
+        case WAIT_SECOND:
+            until(_releaseTime + DOUBLE_CLICK_MS);
+            break;
+        case SECOND_PRESS:
+            until(_pressStartTime + HOLD_REPEAT_DELAY_MS);
+            break;
+        case REPEATING:
+            until(_nextRepeatTime);
+            break;
+        case IDLE:
+            break;
+    }
+    return deadline;
+}
+
+void ButtonClassifier::applyDebounced(const uint32_t timeMs) {
+    _stablePressed = _rawPressed;
+    if (_stablePressed) {
+        onPress(timeMs);
+    } else {
+        onRelease(timeMs);
+    }
+}
+
+void ButtonClassifier::onPress(const uint32_t timeMs) {
+    _pressStartTime = timeMs;
+    if (_state == WAIT_SECOND && timeMs - _releaseTime < DOUBLE_CLICK_MS) {
+        _state = SECOND_PRESS;
+    } else {
+        if (_state == WAIT_SECOND) push(SHORT_PRESS);
+        _state = PRESSED;
+        _longPressSent = false;
+    }
+}
+
+void ButtonClassifier::onRelease(const uint32_t timeMs) {
+    const uint32_t duration = timeMs - _pressStartTime;
+    switch (_state) {
+        case PRESSED:
+            if (duration < MEDIUM_PRESS_MS) {
+                // Could be the first half of a double click
+                _state = WAIT_SECOND;
+                _releaseTime = timeMs;
+                return;
+            }
+            if (duration < LONG_PRESS_MS) {
+                push(MEDIUM_PRESS);
+            } else if (!_longPressSent) {
+                // Release seen before poll() noticed the long press
+                push(LONG_PRESS);
+            }
+            break;
+        case SECOND_PRESS:
+            push(DOUBLE_CLICK);
+            break;
+        case REPEATING:
+        case WAIT_SECOND:
+        case IDLE:
+            break;
+    }
+    _state = IDLE;
+}
+
+void ButtonClassifier::push(const ButtonAction action) {
+    if (_count == QUEUE_SIZE) return;
+    _actions[(_head + _count) % QUEUE_SIZE] = action;
+    _count++;
+}
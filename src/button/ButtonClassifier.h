@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Button action types
+ */
+enum ButtonAction {
+    NO_ACTION,    ///< No action detected
+    SHORT_PRESS,  ///< Short press detected
+    MEDIUM_PRESS, ///< Medium press detected
+    LONG_PRESS,   ///< Long press detected
+    DOUBLE_CLICK, ///< Two short presses in quick succession
+    HOLD_REPEAT   ///< Click followed by press-and-hold; repeated while held
+};
+
+/**
+ * @brief Debounces timestamped button edges and classifies them into gestures
+ *
+ * Works purely on edge timestamps, so press durations do not depend on how often
+ * poll() is called. Has no hardware dependencies and can be fed synthetic edge streams.
+ */
+class ButtonClassifier {
+public:
+    static constexpr uint32_t DEBOUNCE_MS = 50;
+    static constexpr uint32_t DOUBLE_CLICK_MS = 300;
+    static constexpr uint32_t HOLD_REPEAT_DELAY_MS = 400;
+    static constexpr uint32_t HOLD_REPEAT_INTERVAL_MS = 150;
+    static constexpr uint32_t MEDIUM_PRESS_MS = 1000;
+    static constexpr uint32_t LONG_PRESS_MS = 5000;
+    static constexpr uint32_t NO_DEADLINE = UINT32_MAX;
+
+    ButtonClassifier();
+
+    /**
+     * @brief Feeds a raw (bouncing) edge
+     * @param pressed Button level after the edge
+     * @param timeMs Timestamp of the edge
+     */
+    void onEdge(bool pressed, uint32_t timeMs);
+
+    /**
+     * @brief Advances timers and returns the next detected action
+     * @param nowMs Current time
+     * @return Next pending action, or NO_ACTION
+     */
+    ButtonAction poll(uint32_t nowMs);
+
+    /**
+     * @brief Returns how long the caller may sleep before poll() has something to do
+     * @param nowMs Current time
+     * @return Milliseconds until the next timer expires, or NO_DEADLINE
+     */
+    uint32_t msUntilDeadline(uint32_t nowMs) const;
+
+private:
+    enum State {
+        IDLE,        ///< Released, no gesture in progress
+        PRESSED,     ///< First press held
+        WAIT_SECOND, ///< Short click released, waiting for a second press
+        SECOND_PRESS,///< Second press held (double click or hold-repeat)
+        REPEATING    ///< Hold-repeat active
+    };
+
+    void applyDebounced(uint32_t timeMs);
+    void onPress(uint32_t timeMs);
+    void onRelease(uint32_t timeMs);
+    void push(ButtonAction action);
+
+    State _state;
+    bool _rawPressed;
+    bool _stablePressed;
+    uint32_t _lastEdgeTime;
+    uint32_t _pressStartTime;
+    uint32_t _releaseTime;
+    uint32_t _nextRepeatTime;
+    bool _longPressSent;
+
+    static constexpr uint8_t QUEUE_SIZE = 4;
+    ButtonAction _actions[QUEUE_SIZE];
+    uint8_t _head;
+    uint8_t _count;
+};
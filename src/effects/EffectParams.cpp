@@ -0,0 +1,100 @@
+#include <string.h>
+#include "Effects.h"
+
+/*
+ * Parameter declarations and values of all effects. Kept apart from the render functions so
+ * it builds on the host.
+ */
+namespace Effects {
+    static constexpr ParamSpec OFF = {false, 0, 0, 0};
+
+    /**
+     * Parameters declared by each effect. Defaults reproduce the original hard-coded behavior.
+     */
+    static constexpr ParamSpec PARAM_SPECS[NUM_MODES][NUM_PARAMS] = {
+        //                   SPEED                 INTENSITY              HUE
+        /* RAINBOW */        {{true, 1, 32, 1},    {true, 1, 64, 7},      OFF},
+        /* CYLON */          {OFF,                 {true, 1, 255, 20},    {true, 0, 255, 0}},
+        /* SPARKLE */        {{true, 1, 255, 10},  {true, 0, 255, 30},    OFF},
+        /* FIRE */           {{true, 1, 64, 4},    OFF,                   {true, 0, 255, 10}},
+        /* CONFETTI */       {OFF,                 {true, 1, 255, 10},    OFF},
+        /* SINELON */        {{true, 1, 120, 13},  {true, 1, 255, 20},    {true, 0, 255, 0}},
+        /* JUGGLE */         {{true, 1, 60, 7},    {true, 1, 255, 20},    {true, 0, 255, 0}},
+        /* BPM */            {{true, 1, 255, 62},  OFF,                   {true, 0, 255, 0}},
+        /* SNOW */           {{true, 1, 255, 20},  {true, 0, 255, 20},    OFF},
+        /* COMET */          {OFF,                 {true, 1, 255, 40},    {true, 0, 255, 0}},
+        /* RAINBOW_GLITTER */{{true, 1, 32, 1},    {true, 0, 255, 80},    OFF},
+        /* COLOR_WAVES */    {{true, 1, 60, 10},   OFF,                   {true, 0, 255, 0}},
+        /* THEATER_CHASE */  {OFF,                 {true, 1, 255, 100},   {true, 0, 255, 0}},
+        /* SOLID_GLOW */     {{true, 1, 60, 15},   OFF,                   {true, 0, 255, 0}},
+        /* USER */           {{true, 0, 255, 128}, {true, 0, 255, 128},   {true, 0, 255, 0}},
+        /* AUDIO_SPECTRUM */ {OFF,                 {true, 1, 255, 16},    {true, 0, 255, 0}},
+        /* AUDIO_PULSE */    {{true, 1, 255, 24},  OFF,                   {true, 0, 255, 0}},
+        /* AUDIO_VU */       {OFF,                 {true, 1, 255, 8},     {true, 0, 255, 96}},
+        /* PLASMA */         {{true, 1, 255, 32},  {true, 1, 64, 16},     {true, 0, 255, 0}},
+        /* ROWS */           {{true, 1, 255, 16},  {true, 0, 64, 24},     {true, 0, 255, 0}},
+        /* ANIMATION */      {{true, 1, 255, 64},  OFF,                   OFF},
+    };
+
+    static const char *const PARAM_NAMES[NUM_PARAMS] = {"speed", "intensity", "hue"};
+
+    static Params params[NUM_MODES];
+
+    static_assert(sizeof(params) <= PARAMS_STORAGE_SIZE, "Effect parameters do not fit into their storage block");
+
+    void initParams(const uint8_t *stored, size_t size) {
+        const bool useStored = stored != nullptr && size >= sizeof(params);
+        for (int mode = 0; mode < NUM_MODES; mode++) {
+            for (int param = 0; param < NUM_PARAMS; param++) {
+                const ParamSpec &spec = PARAM_SPECS[mode][param];
+                uint8_t value = spec.def;
+                if (useStored) {
+                    const uint8_t saved = stored[mode * NUM_PARAMS + param];
+                    if (saved >= spec.min && saved <= spec.max) value = saved;
+                }
+                params[mode].value[param] = value;
+            }
+        }
+    }
+
+    const ParamSpec &getParamSpec(Mode mode, Param param) {
+        return PARAM_SPECS[mode][param];
+    }
+
+    const Params &getParams(Mode mode) {
+        return params[mode];
+    }
+
+    bool setParam(Mode mode, Param param, int value) {
+        if (mode < 0 || mode >= NUM_MODES || param >= NUM_PARAMS) return false;
+        const ParamSpec &spec = PARAM_SPECS[mode][param];
+        if (!spec.used || value < spec.min || value > spec.max) return false;
+        params[mode].value[param] = value;
+        return true;
+    }
+
+    void setParams(Mode mode, const Params &values) {
+        for (int param = 0; param < NUM_PARAMS; param++) {
+            setParam(mode, static_cast<Param>(param), values.value[param]);
+        }
+    }
+
+    const uint8_t *rawParams() {
+        return &params[0].value[0];
+    }
+
+    const char *paramName(Param param) {
+        return param < NUM_PARAMS ? PARAM_NAMES[param] : "";
+    }
+
+    bool parseParam(const char *name, Param &param) {
+        if (name == nullptr) return false;
+        for (int i = 0; i < NUM_PARAMS; i++) {
+            if (strcmp(name, PARAM_NAMES[i]) == 0) {
+                param = static_cast<Param>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+}
@@ -1,111 +1,335 @@
 #include <FastLED.h>
+#include "Effects.h"
+#include "../palettes/Palettes.h"
+#include "../user_effect/UserEffect.h"
+#include "../audio/AudioFeatures.h"
+#include "../layout/Layout.h"
+#include "../animation/Animation.h"
 
 namespace Effects {
-    void rainbow(CRGB *leds, int numLeds) {
+    /**
+     * Color at a hue position: from the selected user palette if there is one, otherwise from
+     * the color wheel. Saturation only applies to the color wheel.
+     */
+    static inline CRGB paletteColor(const CRGBPalette256 *palette, uint8_t index, uint8_t saturation, uint8_t value) {
+        if (palette == nullptr) return CHSV(index, saturation, value);
+        CRGB color = (*palette)[index];
+        return color.nscale8_video(value);
+    }
+
+    // Effects that move or fade once per step were tuned for one step every 10 ms. They run
+    // the steps due since their last call, so their speed does not depend on the frame rate.
+    static constexpr uint32_t STEP_MS = 10;
+    // After a longer pause (another mode, system off) an effect resumes with a single step
+    static constexpr uint32_t MAX_STEPS = 8;
+
+    /**
+     * Counts the steps due since `last` and advances it by them.
+     * @param last Time of the effect's last step, owned by the effect
+     * @return Steps to run now, 0 if the next one is not due yet
+     */
+    static uint32_t stepsDue(uint32_t &last) {
+        const uint32_t now = millis();
+        uint32_t steps = (now - last) / STEP_MS;
+        if (steps > MAX_STEPS) {
+            last = now;
+            return 1;
+        }
+        last += steps * STEP_MS;
+        return steps;
+    }
+
+    /**
+     * Rainbow shared by RAINBOW and RAINBOW_GLITTER, so switching between them keeps the phase.
+     */
+    static void fillRainbow(CRGB *leds, int numLeds, uint8_t step, uint8_t deltaHue) {
         static uint8_t hue = 0;
-        fill_rainbow(leds, numLeds, hue++, 7);
+        static uint32_t lastStep = 0;
+        hue += step * stepsDue(lastStep);
+        fill_rainbow(leds, numLeds, hue, deltaHue);
     }
 
-    void cylon(CRGB *leds, int numLeds) {
-        static uint8_t i = 0;
+    void rainbow(CRGB *leds, int numLeds, const Params &p) {
+        fillRainbow(leds, numLeds, p.value[SPEED], p.value[INTENSITY]);
+    }
+
+    void cylon(CRGB *leds, int numLeds, const Params &p) {
+        static int i = 0;
         static bool forward = true;
+        static uint32_t lastStep = 0;
 
-        fadeToBlackBy(leds, numLeds, 20);
-        leds[i] = CHSV(millis() / 10, 255, 255);
+        for (uint32_t step = stepsDue(lastStep); step > 0; step--) {
+            // The strip may have been shortened since the last call
+            if (i > numLeds - 1) i = numLeds - 1;
+            fadeToBlackBy(leds, numLeds, p.value[INTENSITY]);
+            leds[i] = CHSV(millis() / 10 + p.value[HUE], 255, 255);
 
-        if (forward) {
-            i++;
-            if (i >= numLeds - 1) forward = false;
-        } else {
-            i--;
-            if (i == 0) forward = true;
+            if (forward) {
+                i++;
+                if (i >= numLeds - 1) forward = false;
+            } else {
+                i--;
+                if (i == 0) forward = true;
+            }
         }
     }
 
-    void sparkle(CRGB *leds, int numLeds) {
-        fadeToBlackBy(leds, numLeds, 10);
-        if (random8() < 30) {
-            leds[random16(numLeds)] = CRGB::White;
+    void sparkle(CRGB *leds, int numLeds, const Params &p) {
+        static uint32_t lastStep = 0;
+        for (uint32_t step = stepsDue(lastStep); step > 0; step--) {
+            fadeToBlackBy(leds, numLeds, p.value[SPEED]);
+            if (random8() < p.value[INTENSITY]) {
+                leds[random16(numLeds)] = CRGB::White;
+            }
         }
     }
 
-    void fire(CRGB *leds, int numLeds) {
+    void fire(CRGB *leds, int numLeds, const Params &p) {
         // Simplified fire effect
+        const uint32_t time = static_cast<uint64_t>(millis()) * p.value[SPEED] / 16;
+        const uint8_t hue = p.value[HUE];
         for (int i = 0; i < numLeds; i++) {
-            uint8_t noise = qsub8(inoise8(i * 60, millis() / 4), 16);
-            leds[i] = CHSV(10 + (noise / 8), 255, noise);
+            uint8_t noise = qsub8(inoise8(i * 60, time), 16);
+            leds[i] = CHSV(hue + (noise / 8), 255, noise);
         }
     }
 
-    void confetti(CRGB *leds, int numLeds) {
-        fadeToBlackBy(leds, numLeds, 10);
-        int pos = random16(numLeds);
-        leds[pos] += CHSV(random8(255), 200, 255);
+    void confetti(CRGB *leds, int numLeds, const Params &p) {
+        static uint32_t lastStep = 0;
+        for (uint32_t step = stepsDue(lastStep); step > 0; step--) {
+            fadeToBlackBy(leds, numLeds, p.value[INTENSITY]);
+            int pos = random16(numLeds);
+            leds[pos] += paletteColor(Palettes::active(), random8(255), 200, 255);
+        }
     }
 
-    void sinelon(CRGB *leds, int numLeds) {
-        fadeToBlackBy(leds, numLeds, 20);
-        int pos = beatsin16(13, 0, numLeds - 1);
-        leds[pos] += CHSV(millis() / 20, 255, 192);
+    void sinelon(CRGB *leds, int numLeds, const Params &p) {
+        static uint32_t lastStep = 0;
+        for (uint32_t step = stepsDue(lastStep); step > 0; step--) {
+            fadeToBlackBy(leds, numLeds, p.value[INTENSITY]);
+        }
+        int pos = beatsin16(p.value[SPEED], 0, numLeds - 1);
+        leds[pos] += CHSV(millis() / 20 + p.value[HUE], 255, 192);
     }
 
-    void juggle(CRGB *leds, int numLeds) {
-        fadeToBlackBy(leds, numLeds, 20);
-        uint8_t dothue = 0;
+    void juggle(CRGB *leds, int numLeds, const Params &p) {
+        static uint32_t lastStep = 0;
+        for (uint32_t step = stepsDue(lastStep); step > 0; step--) {
+            fadeToBlackBy(leds, numLeds, p.value[INTENSITY]);
+        }
+        const CRGBPalette256 *palette = Palettes::active();
+        const uint8_t baseBpm = p.value[SPEED];
+        uint8_t dothue = p.value[HUE];
         for (int i = 0; i < 8; i++) {
-            leds[beatsin16(i + 7, 0, numLeds - 1)] |= CHSV(dothue, 200, 255);
+            leds[beatsin16(i + baseBpm, 0, numLeds - 1)] |= paletteColor(palette, dothue, 200, 255);
             dothue += 32;
         }
     }
 
-    void bpm(CRGB *leds, int numLeds) {
-        uint8_t BeatsPerMinute = 62;
-        CRGBPalette16 palette = PartyColors_p;
+    void bpm(CRGB *leds, int numLeds, const Params &p) {
+        uint8_t BeatsPerMinute = p.value[SPEED];
+        const CRGBPalette256 *custom = Palettes::active();
+        const CRGBPalette256 &palette = custom ? *custom : Palettes::party();
+        const uint8_t hue = p.value[HUE];
         uint8_t beat = beatsin8(BeatsPerMinute, 64, 255);
+        const uint8_t phase = millis() / 10;
         for (int i = 0; i < numLeds; i++) {
-            leds[i] = ColorFromPalette(palette, (millis() / 10) + (i * 2), beat - (millis() / 10) + (i * 10));
+            // Same scaling as the original ColorFromPalette(PartyColors_p, ...), from the expanded table
+            leds[i] = ColorFromPalette(palette, hue + phase + (i * 2), beat - phase + (i * 10));
         }
     }
 
-    void snow(CRGB *leds, int numLeds) {
-        fadeToBlackBy(leds, numLeds, 20);
-        if (random8() < 20) {
-            leds[random16(numLeds)] = CRGB::White;
+    void snow(CRGB *leds, int numLeds, const Params &p) {
+        static uint32_t lastStep = 0;
+        for (uint32_t step = stepsDue(lastStep); step > 0; step--) {
+            fadeToBlackBy(leds, numLeds, p.value[SPEED]);
+            if (random8() < p.value[INTENSITY]) {
+                leds[random16(numLeds)] = CRGB::White;
+            }
         }
     }
 
-    void comet(CRGB *leds, int numLeds) {
+    void comet(CRGB *leds, int numLeds, const Params &p) {
         static uint16_t pos = 0;
-        fadeToBlackBy(leds, numLeds, 40);
-        leds[pos % numLeds] = CHSV(millis() / 10, 255, 255);
-        pos++;
+        static uint32_t lastStep = 0;
+        for (uint32_t step = stepsDue(lastStep); step > 0; step--) {
+            fadeToBlackBy(leds, numLeds, p.value[INTENSITY]);
+            leds[pos % numLeds] = CHSV(millis() / 10 + p.value[HUE], 255, 255);
+            pos++;
+        }
     }
 
-    void rainbow_glitter(CRGB *leds, int numLeds) {
-        rainbow(leds, numLeds);
-        if (random8() < 80) {
-            leds[random16(numLeds)] += CRGB::White;
+    void rainbow_glitter(CRGB *leds, int numLeds, const Params &p) {
+        static uint32_t lastStep = 0;
+        fillRainbow(leds, numLeds, p.value[SPEED], 7);
+        // One chance of glitter per step, so its density does not depend on the frame rate
+        for (uint32_t step = stepsDue(lastStep); step > 0; step--) {
+            if (random8() < p.value[INTENSITY]) {
+                leds[random16(numLeds)] += CRGB::White;
+            }
         }
     }
 
-    void color_waves(CRGB *leds, int numLeds) {
-        uint8_t hue = millis() / 50;
+    void color_waves(CRGB *leds, int numLeds, const Params &p) {
+        uint8_t hue = millis() / 50 + p.value[HUE];
+        const uint8_t waveBpm = p.value[SPEED];
+        const CRGBPalette256 *palette = Palettes::active();
         for (int i = 0; i < numLeds; i++) {
             int colorIndex = (hue + (i * 255 / numLeds)) % 255;
-            leds[i] = CHSV(colorIndex, 255, beatsin8(10, 160, 255, 0, i * 10));
+            leds[i] = paletteColor(palette, colorIndex, 255, beatsin8(waveBpm, 160, 255, 0, i * 10));
         }
     }
 
-    void theater_chase(CRGB *leds, int numLeds) {
+    void theater_chase(CRGB *leds, int numLeds, const Params &p) {
         static uint8_t frame = 0;
-        fadeToBlackBy(leds, numLeds, 100);
-        for (int i = frame; i < numLeds; i += 3) {
-            leds[i] = CHSV(millis() / 20, 255, 255);
+        static uint32_t lastStep = 0;
+        for (uint32_t step = stepsDue(lastStep); step > 0; step--) {
+            fadeToBlackBy(leds, numLeds, p.value[INTENSITY]);
+            const CRGB color = CHSV(millis() / 20 + p.value[HUE], 255, 255);
+            for (int i = frame; i < numLeds; i += 3) {
+                leds[i] = color;
+            }
+            frame = (frame + 1) % 3;
+        }
+    }
+
+    void solid_glow(CRGB *leds, int numLeds, const Params &p) {
+        fill_solid(leds, numLeds, paletteColor(Palettes::active(), millis() / 50 + p.value[HUE], 255,
+                                               beatsin8(p.value[SPEED], 100, 255)));
+    }
+
+    void user(CRGB *leds, int numLeds, const Params &p) {
+        UserEffect::render(leds, numLeds, p);
+    }
+
+    /**
+     * Bands spread across the strip, each falling back slowly after a peak.
+     */
+    void audio_spectrum(CRGB *leds, int numLeds, const Params &p) {
+        static uint8_t level[AudioFeatures::NUM_BANDS] = {};
+        AudioFeatures::Frame frame;
+        AudioFeatures::read(frame);
+        for (size_t band = 0; band < AudioFeatures::NUM_BANDS; band++) {
+            level[band] = max(frame.bands[band], qsub8(level[band], p.value[INTENSITY]));
+        }
+
+        const CRGBPalette256 *palette = Palettes::active();
+        const uint8_t hue = p.value[HUE];
+        const int span = numLeds > 1 ? numLeds - 1 : 1;
+        for (int i = 0; i < numLeds; i++) {
+            // Position in bands as 8.8 fixed point, interpolated between neighbouring bands
+            const uint32_t position = static_cast<uint32_t>(i) * (AudioFeatures::NUM_BANDS - 1) * 256 / span;
+            const size_t band = position >> 8;
+            const uint8_t next = band + 1 < AudioFeatures::NUM_BANDS ? level[band + 1] : level[band];
+            const uint8_t energy = lerp8by8(level[band], next, position & 0xFF);
+            leds[i] = paletteColor(palette, hue + i * 255 / span, 255, energy);
+        }
+    }
+
+    /**
+     * Whole strip flashes on every beat and fades out; the overall level keeps a dim floor.
+     */
+    void audio_pulse(CRGB *leds, int numLeds, const Params &p) {
+        static uint32_t lastBeats = 0;
+        static uint8_t flash = 0;
+        static uint8_t beatHue = 0;
+        AudioFeatures::Frame frame;
+        AudioFeatures::read(frame);
+        if (frame.beats != lastBeats) {
+            lastBeats = frame.beats;
+            flash = 255;
+            beatHue += 32;
+        } else {
+            flash = qsub8(flash, p.value[SPEED]);
+        }
+        const uint8_t value = max(flash, scale8(frame.peak, 96));
+        fill_solid(leds, numLeds, paletteColor(Palettes::active(), p.value[HUE] + beatHue, 255, value));
+    }
+
+    /**
+     * Level meter growing from the center, green to red unless the hue is shifted.
+     */
+    void audio_vu(CRGB *leds, int numLeds, const Params &p) {
+        static uint8_t level = 0;
+        AudioFeatures::Frame frame;
+        AudioFeatures::read(frame);
+        level = max(frame.peak, qsub8(level, p.value[INTENSITY]));
+
+        const uint8_t hue = p.value[HUE];
+        const int half = (numLeds + 1) / 2;
+        const int lit = (level * half + 254) / 255;
+        for (int d = 0; d < half; d++) {
+            const CRGB color = d < lit ? CRGB(CHSV(hue - d * hue / half, 255, 255)) : CRGB::Black;
+            leds[half - 1 - d] = color;
+            leds[numLeds - half + d] = color; // Both halves meet on the middle LED of odd strips
+        }
+    }
+
+    /**
+     * Sum of three sine waves over the layout's grid (along the strip when no layout is set).
+     */
+    void plasma(CRGB *leds, int numLeds, const Params &p) {
+        const Layout::View layout = Layout::current(numLeds);
+        const CRGBPalette256 *palette = Palettes::active();
+        const uint32_t time = static_cast<uint64_t>(millis()) * p.value[SPEED] / 64;
+        const uint8_t scale = p.value[INTENSITY];
+        const uint8_t hue = p.value[HUE];
+        fill_solid(leds, numLeds, CRGB::Black);
+        for (uint16_t y = 0; y < layout.height; y++) {
+            for (uint16_t x = 0; x < layout.width; x++) {
+                const uint16_t index = layout.at(x, y);
+                if (index == Layout::NONE) continue;
+                const uint8_t value = (sin8(x * scale + time) + sin8(y * scale + time / 2)
+                                       + sin8((x + y) * scale / 2 + time / 3)) / 3;
+                leds[index] = paletteColor(palette, value + hue, 255, 255);
+            }
+        }
+    }
+
+    /**
+     * One color per row, scrolling upwards: rings on a wrapped tree, lines on a matrix.
+     */
+    void rows(CRGB *leds, int numLeds, const Params &p) {
+        const Layout::View layout = Layout::current(numLeds);
+        const CRGBPalette256 *palette = Palettes::active();
+        const uint8_t offset = static_cast<uint64_t>(millis()) * p.value[SPEED] / 256;
+        const uint8_t hue = p.value[HUE];
+        const uint8_t spread = p.value[INTENSITY];
+        fill_solid(leds, numLeds, CRGB::Black);
+        for (uint16_t y = 0; y < layout.height; y++) {
+            const CRGB color = paletteColor(palette, hue + y * spread - offset, 255, 255);
+            for (uint16_t x = 0; x < layout.width; x++) {
+                const uint16_t index = layout.at(x, y);
+                if (index != Layout::NONE) leds[index] = color;
+            }
         }
-        frame = (frame + 1) % 3;
     }
 
-    void solid_glow(CRGB *leds, int numLeds) {
-        fill_solid(leds, numLeds, CHSV(millis() / 50, 255, beatsin8(15, 100, 255)));
+    void animation(CRGB *leds, int numLeds, const Params &p) {
+        Animation::render(leds, numLeds, p);
+    }
+
+    bool isAvailable(Mode mode) {
+        if (mode < 0 || mode >= NUM_MODES) return false;
+        if (mode == USER) return UserEffect::isLoaded();
+        if (mode == ANIMATION) return Animation::isReady();
+        return true;
+    }
+
+    bool isAudioReactive(Mode mode) {
+        return mode == AUDIO_SPECTRUM || mode == AUDIO_PULSE || mode == AUDIO_VU;
+    }
+
+    uint8_t renderDivisor(Mode mode) {
+        // Costly per-pixel effects driven by millis() only: drawing them less often does not
+        // change their speed. Stepping effects catch up on missed steps, but a skipped frame
+        // would show two steps at once, so they run every frame.
+        switch (mode) {
+        case FIRE:
+        case BPM:
+        case COLOR_WAVES:
+        case PLASMA: return 2;
+        default: return 1;
+        }
     }
-}
\ No newline at end of file
+}
@@ -20,21 +20,134 @@ namespace Effects
         COLOR_WAVES,
         THEATER_CHASE,
         SOLID_GLOW,
+        USER,
+        AUDIO_SPECTRUM,
+        AUDIO_PULSE,
+        AUDIO_VU,
+        PLASMA,
+        ROWS,
+        ANIMATION,
         NUM_MODES
     };
 
-    void rainbow(CRGB* leds, int numLeds);
-    void cylon(CRGB* leds, int numLeds);
-    void sparkle(CRGB* leds, int numLeds);
-    void fire(CRGB* leds, int numLeds);
-    void confetti(CRGB* leds, int numLeds);
-    void sinelon(CRGB* leds, int numLeds);
-    void juggle(CRGB* leds, int numLeds);
-    void bpm(CRGB* leds, int numLeds);
-    void snow(CRGB* leds, int numLeds);
-    void comet(CRGB* leds, int numLeds);
-    void rainbow_glitter(CRGB* leds, int numLeds);
-    void color_waves(CRGB* leds, int numLeds);
-    void theater_chase(CRGB* leds, int numLeds);
-    void solid_glow(CRGB* leds, int numLeds);
+    /**
+     * @brief Tunable effect parameters; each effect declares which ones it uses
+     */
+    enum Param : uint8_t
+    {
+        SPEED,     ///< Animation rate (beats per minute, step size or fade rate)
+        INTENSITY, ///< Amount (trail length, sparkle density, hue spread)
+        HUE,       ///< Offset added to the effect's hue or palette index
+        NUM_PARAMS
+    };
+
+    /**
+     * @brief Range and default of one parameter
+     */
+    struct ParamSpec
+    {
+        bool used;   ///< Whether the effect reads this parameter
+        uint8_t min;
+        uint8_t max;
+        uint8_t def;
+    };
+
+    /**
+     * @brief Current parameter values of one effect, read as plain fields by its render function
+     */
+    struct Params
+    {
+        uint8_t value[NUM_PARAMS];
+    };
+
+    /// Size of the persisted parameter block; leaves room for modes added later
+    constexpr size_t PARAMS_STORAGE_SIZE = 96;
+
+    /**
+     * @brief Initializes parameters from storage, falling back to defaults
+     * @param stored Values of all modes as returned by rawParams(), or nullptr to use the defaults
+     * @param size Size of stored in bytes
+     */
+    void initParams(const uint8_t *stored, size_t size);
+
+    /**
+     * @brief Returns the parameter declaration of an effect
+     */
+    const ParamSpec &getParamSpec(Mode mode, Param param);
+
+    /**
+     * @brief Returns the current parameter values of an effect
+     */
+    const Params &getParams(Mode mode);
+
+    /**
+     * @brief Updates a parameter
+     * @param mode Effect mode
+     * @param param Parameter
+     * @param value New value
+     * @return false if the effect does not use the parameter or the value is out of range
+     */
+    bool setParam(Mode mode, Param param, int value);
+
+    /**
+     * @brief Updates all parameters of an effect at once
+     * @param mode Effect mode
+     * @param values New values; parameters the effect does not use or values out of range are skipped
+     */
+    void setParams(Mode mode, const Params &values);
+
+    /**
+     * @brief Values of all modes as one block for persistence
+     * @return Pointer to NUM_MODES * NUM_PARAMS bytes
+     */
+    const uint8_t *rawParams();
+
+    /**
+     * @brief Returns the protocol name of a parameter ("speed", "intensity", "hue")
+     */
+    const char *paramName(Param param);
+
+    /**
+     * @brief Looks up a parameter by its protocol name
+     * @return true if the name is known
+     */
+    bool parseParam(const char *name, Param &param);
+
+    void rainbow(CRGB* leds, int numLeds, const Params &p);
+    void cylon(CRGB* leds, int numLeds, const Params &p);
+    void sparkle(CRGB* leds, int numLeds, const Params &p);
+    void fire(CRGB* leds, int numLeds, const Params &p);
+    void confetti(CRGB* leds, int numLeds, const Params &p);
+    void sinelon(CRGB* leds, int numLeds, const Params &p);
+    void juggle(CRGB* leds, int numLeds, const Params &p);
+    void bpm(CRGB* leds, int numLeds, const Params &p);
+    void snow(CRGB* leds, int numLeds, const Params &p);
+    void comet(CRGB* leds, int numLeds, const Params &p);
+    void rainbow_glitter(CRGB* leds, int numLeds, const Params &p);
+    void color_waves(CRGB* leds, int numLeds, const Params &p);
+    void theater_chase(CRGB* leds, int numLeds, const Params &p);
+    void solid_glow(CRGB* leds, int numLeds, const Params &p);
+    void user(CRGB* leds, int numLeds, const Params &p);
+    void audio_spectrum(CRGB* leds, int numLeds, const Params &p);
+    void audio_pulse(CRGB* leds, int numLeds, const Params &p);
+    void audio_vu(CRGB* leds, int numLeds, const Params &p);
+    void plasma(CRGB* leds, int numLeds, const Params &p);
+    void rows(CRGB* leds, int numLeds, const Params &p);
+    void animation(CRGB* leds, int numLeds, const Params &p);
+
+    /**
+     * @brief Whether a mode can be shown (USER and ANIMATION need uploaded content)
+     */
+    bool isAvailable(Mode mode);
+
+    /**
+     * @brief Whether a mode renders from streamed audio features and should be redrawn per packet
+     */
+    bool isAudioReactive(Mode mode);
+
+    /**
+     * @brief Output frames per rendered keyframe; the frames between are interpolated
+     * @return 1 for effects drawn every frame
+     */
+    uint8_t renderDivisor(Mode mode);
 }
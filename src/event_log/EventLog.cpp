@@ -0,0 +1,125 @@
+#include <atomic>
+#include "EventLog.h"
+
+namespace EventLog {
+    /**
+     * How an event is shown. The format is expanded at read time: %u prints an argument as an
+     * unsigned number, %i as an IPv4 address; arguments are consumed in order.
+     */
+    struct Descriptor {
+        const char *tag;
+        const char *format;
+    };
+
+    static const Descriptor DESCRIPTORS[NUM_EVENTS] = {
+        /* UDP_COMMAND */        {"UDP", "Command of %u bytes from %i:%u"},
+        /* UDP_DISCOVERY */      {"UDP", "Discovery reply to %i:%u"},
+        /* UDP_MULTICAST */      {"UDP", "Group command of %u bytes from %i"},
+        /* TCP_CLIENT */         {"TCP_SOCKET", "Client connected from %i"},
+        /* TCP_COMMAND */        {"TCP_SOCKET", "Command of %u bytes"},
+        /* TCP_LINE_DROPPED */   {"TCP_SOCKET", "Line exceeds %u bytes, dropped"},
+        /* COMMAND */            {"PARSER", "Command of %u bytes, success %u"},
+        /* COMMAND_INVALID */    {"PARSER", "JSON parse error in %u bytes"},
+        /* COMMAND_SCHEDULED */  {"GROUPS", "Command of %u bytes scheduled %u ms ahead"},
+        /* SCHEDULED_RUN */      {"GROUPS", "Scheduled command run %u ms late"},
+        /* SAVE_MODE */          {"SETTINGS", "Mode %u"},
+        /* SAVE_POWER */         {"SETTINGS", "System off %u"},
+        /* SAVE_BRIGHTNESS */    {"SETTINGS", "Brightness %u"},
+        /* SAVE_LED_COUNT */     {"SETTINGS", "LED count %u"},
+        /* SAVE_BLE_RELEASE */   {"SETTINGS", "BLE release %u"},
+        /* SAVE_PALETTE */       {"SETTINGS", "Palette %u"},
+        /* SAVE_PARAMS */        {"SETTINGS", "Effect parameters, %u bytes"},
+        /* SAVE_DITHER */        {"SETTINGS", "Dithering %u"},
+        /* SAVE_WIFI */          {"SETTINGS", "WiFi credentials, SSID of %u characters"},
+        /* SAVE_GROUPS */        {"SETTINGS", "Group mask %u"},
+        /* SAVE_STRIP */         {"SETTINGS", "Strip chipset %u, color order %u, white %u"},
+        /* STATE_COMMITTED */    {"SETTINGS", "Light state committed: mode %u, brightness %u, %u LEDs"},
+    };
+
+    struct Entry {
+        std::atomic<uint32_t> seq; ///< Sequence number + 1 once written, 0 while being written
+        uint32_t time;
+        uint32_t args[3];
+        uint8_t event;
+    };
+
+    static Entry ring[CAPACITY];
+    static std::atomic<uint32_t> nextSeq{0};
+
+    void log(Event event, uint32_t a, uint32_t b, uint32_t c) {
+        const uint32_t seq = nextSeq.fetch_add(1, std::memory_order_relaxed);
+        Entry &entry = ring[seq % CAPACITY];
+        entry.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        entry.time = millis();
+        entry.event = event;
+        entry.args[0] = a;
+        entry.args[1] = b;
+        entry.args[2] = c;
+        entry.seq.store(seq + 1, std::memory_order_release);
+    }
+
+    uint32_t head() {
+        return nextSeq.load(std::memory_order_relaxed);
+    }
+
+    static void appendMessage(const Descriptor &descriptor, const uint32_t *args, ResponseWriter &out) {
+        size_t arg = 0;
+        for (const char *p = descriptor.format; *p; p++) {
+            if (*p != '%' || (p[1] != 'u' && p[1] != 'i') || arg >= 3) {
+                out.add(*p);
+                continue;
+            }
+            const uint32_t value = args[arg++];
+            if (*++p == 'i') {
+                out.addIp(value);
+            } else {
+                out.addUnsigned(value);
+            }
+        }
+    }
+
+    uint32_t format(uint32_t since, size_t maxEntries, ResponseWriter &out, size_t reserve, uint32_t &lost) {
+        const uint32_t end = head();
+        lost = 0;
+        if (static_cast<int32_t>(end - since) < 0) since = end; // From a previous boot
+        if (end - since > CAPACITY) {
+            lost = end - since - CAPACITY;
+            since = end - CAPACITY;
+        }
+
+        bool first = true;
+        uint32_t seq = since;
+        for (; seq != end && maxEntries > 0; seq++) {
+            const Entry &slot = ring[seq % CAPACITY];
+            const uint32_t before = slot.seq.load(std::memory_order_acquire);
+            const uint32_t time = slot.time;
+            const uint8_t event = slot.event;
+            uint32_t args[3] = {slot.args[0], slot.args[1], slot.args[2]};
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (before != seq + 1 || slot.seq.load(std::memory_order_relaxed) != before || event >= NUM_EVENTS) {
+                // Overwritten or still being written while we read it
+                lost++;
+                continue;
+            }
+
+            const Descriptor &descriptor = DESCRIPTORS[event];
+            const size_t mark = out.length();
+            if (!first) out.add(',');
+            out.add("{\"seq\":").addUnsigned(seq);
+            out.add(",\"t\":").addUnsigned(time);
+            out.add(",\"tag\":\"").add(descriptor.tag);
+            out.add("\",\"msg\":\"");
+            appendMessage(descriptor, args, out);
+            out.add("\"}");
+            if (out.overflowed() || out.remaining() < reserve) {
+                // The client continues from this event with the next request
+                out.truncate(mark);
+                break;
+            }
+            first = false;
+            maxEntries--;
+        }
+        return seq;
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../parser/ResponseWriter.h"
+
+/**
+ * @brief Low-overhead event log for hot paths
+ *
+ * Recording an event stores its ID, a millisecond timestamp and up to three raw 32-bit arguments
+ * into a fixed RAM ring; nothing is formatted and nothing touches the serial port. Messages are
+ * formatted only when a client pulls them with the get_logs command. Safe to call from any task.
+ */
+namespace EventLog {
+    constexpr size_t CAPACITY = 128; ///< Entries kept; older ones are overwritten
+
+    enum Event : uint8_t {
+        UDP_COMMAND,        ///< bytes, remote IP, remote port
+        UDP_DISCOVERY,      ///< remote IP, remote port
+        UDP_MULTICAST,      ///< bytes, remote IP
+        TCP_CLIENT,         ///< remote IP
+        TCP_COMMAND,        ///< bytes
+        TCP_LINE_DROPPED,   ///< line limit
+        COMMAND,            ///< bytes, success
+        COMMAND_INVALID,    ///< bytes
+        COMMAND_SCHEDULED,  ///< bytes, lead time in ms
+        SCHEDULED_RUN,      ///< lateness in ms
+        SAVE_MODE,          ///< mode
+        SAVE_POWER,         ///< off
+        SAVE_BRIGHTNESS,    ///< brightness
+        SAVE_LED_COUNT,     ///< LED count
+        SAVE_BLE_RELEASE,   ///< enabled
+        SAVE_PALETTE,       ///< slot
+        SAVE_PARAMS,        ///< bytes
+        SAVE_DITHER,        ///< enabled
+        SAVE_WIFI,          ///< SSID length
+        SAVE_GROUPS,        ///< group mask
+        SAVE_STRIP,         ///< chipset, color order, white channel
+        STATE_COMMITTED,    ///< mode, brightness, LED count
+        NUM_EVENTS
+    };
+
+    /**
+     * @brief Records an event
+     * @param event Event ID
+     * @param a, b, c Raw arguments, interpreted by the event's format
+     */
+    void log(Event event, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0);
+
+    /**
+     * @brief Sequence number the next event will get
+     */
+    uint32_t head();
+
+    /**
+     * @brief Formats logged events as JSON objects
+     * @param since Sequence number of the first event wanted
+     * @param maxEntries Most events to format
+     * @param out Appended with comma-separated {"seq":..,"t":..,"tag":"..","msg":".."} objects;
+     *            stops early at the first event that does not fit
+     * @param reserve Bytes to leave free in `out` for the rest of the reply
+     * @param lost Set to the number of requested events already overwritten
+     * @return Sequence number to pass as `since` on the next call
+     */
+    uint32_t format(uint32_t since, size_t maxEntries, ResponseWriter &out, size_t reserve, uint32_t &lost);
+}
@@ -0,0 +1,55 @@
+#include <Arduino.h>
+#include "AppEvents.h"
+
+namespace AppEvents {
+    static constexpr uint32_t STATS_WINDOW_US = 1000000;
+
+    static EventGroupHandle_t eventGroup = nullptr;
+    static uint32_t windowStart = 0;
+    static uint32_t windowBlockedUs = 0;
+    static uint32_t windowWakeups = 0;
+    static Stats stats = {0, 0};
+
+    void init() {
+        if (eventGroup == nullptr) {
+            eventGroup = xEventGroupCreate();
+        }
+        windowStart = micros();
+    }
+
+    void notify(EventBits_t events) {
+        if (eventGroup) xEventGroupSetBits(eventGroup, events);
+    }
+
+    void IRAM_ATTR notifyFromISR(EventBits_t events) {
+        if (eventGroup == nullptr) return;
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
+        xEventGroupSetBitsFromISR(eventGroup, events, &higherPriorityTaskWoken);
+        if (higherPriorityTaskWoken) portYIELD_FROM_ISR();
+    }
+
+    EventBits_t wait(uint32_t timeoutMs) {
+        if (eventGroup == nullptr) return 0;
+
+        const TickType_t ticks = timeoutMs == NO_DEADLINE ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+        const uint32_t blockStart = micros();
+        const EventBits_t events = xEventGroupWaitBits(eventGroup, ALL_EVENTS, pdTRUE, pdFALSE, ticks);
+        const uint32_t now = micros();
+
+        windowBlockedUs += now - blockStart;
+        windowWakeups++;
+        const uint32_t elapsed = now - windowStart;
+        if (elapsed >= STATS_WINDOW_US) {
+            stats.wakeupsPerSecond = static_cast<uint32_t>(static_cast<uint64_t>(windowWakeups) * 1000000 / elapsed);
+            stats.idlePercent = static_cast<uint8_t>(static_cast<uint64_t>(windowBlockedUs) * 100 / elapsed);
+            windowStart = now;
+            windowBlockedUs = 0;
+            windowWakeups = 0;
+        }
+        return events;
+    }
+
+    Stats getStats() {
+        return stats;
+    }
+}
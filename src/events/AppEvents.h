@@ -0,0 +1,62 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+/**
+ * @brief Wake-up sources for the application task
+ *
+ * loop() blocks in wait() until one of the sources signals or the nearest module deadline
+ * (debounce, reconnect, blink...) expires, instead of spinning.
+ */
+namespace AppEvents {
+    constexpr uint32_t NO_DEADLINE = UINT32_MAX;
+
+    /**
+     * @brief Event bits
+     */
+    enum Event : EventBits_t {
+        BUTTON = 1 << 0,   ///< Button edge captured
+        NETWORK = 1 << 1,  ///< Command applied outside loop(); module deadlines may have moved
+        WIFI = 1 << 2,     ///< Wi-Fi connection event
+        BLE = 1 << 3,      ///< BLE command queued
+        ALL_EVENTS = BUTTON | NETWORK | WIFI | BLE
+    };
+
+    /**
+     * @brief Loop activity statistics over the last full second
+     */
+    struct Stats {
+        uint32_t wakeupsPerSecond; ///< Returns from wait() per second
+        uint8_t idlePercent;       ///< Share of time the application task spent blocked
+    };
+
+    /**
+     * @brief Creates the event group (call in setup() before any source is enabled)
+     */
+    void init();
+
+    /**
+     * @brief Signals events from task context
+     * @param events Event bits
+     */
+    void notify(EventBits_t events);
+
+    /**
+     * @brief Signals events from an interrupt handler
+     * @param events Event bits
+     */
+    void notifyFromISR(EventBits_t events);
+
+    /**
+     * @brief Blocks until an event is signaled or the timeout expires
+     * @param timeoutMs Maximum time to wait, NO_DEADLINE to wait for an event only
+     * @return Event bits that were signaled (cleared on return)
+     */
+    EventBits_t wait(uint32_t timeoutMs);
+
+    /**
+     * @brief Returns loop activity statistics
+     */
+    Stats getStats();
+}
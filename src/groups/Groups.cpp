@@ -0,0 +1,122 @@
+#include <sys/time.h>
+#include "Groups.h"
+#include "../settings/Settings.h"
+#include "../board/BoardTraits.h"
+#include "../event_log/EventLog.h"
+
+namespace Groups {
+    static const char *TAG = "GROUPS";
+    static constexpr const char *NTP_SERVER = "pool.ntp.org";
+    // Anything earlier means SNTP has not set the clock yet (the RTC starts at 1970)
+    static constexpr time_t MIN_VALID_TIME = 1700000000;
+
+    /**
+     * A command waiting for its time. The slot stays in use while its command runs, so a
+     * command scheduling another one cannot overwrite it.
+     */
+    struct Scheduled {
+        uint64_t atMs;
+        uint16_t length;
+        bool used;
+        char message[Board::TRAITS.commandBufferSize];
+    };
+
+    static uint32_t membership = 0;
+    static bool clockStarted = false;
+    static GroupCommandCallback commandCallback = nullptr;
+    static Scheduled queue[MAX_SCHEDULED];
+
+    void init() {
+        membership = Settings::getGroups();
+        ESP_LOGI(TAG, "Group membership: 0x%08X", (unsigned) membership);
+    }
+
+    void startClock() {
+        if (clockStarted) return;
+        configTime(0, 0, NTP_SERVER);
+        clockStarted = true;
+        ESP_LOGI(TAG, "SNTP started with %s", NTP_SERVER);
+    }
+
+    bool clockMs(uint64_t &nowMs) {
+        struct timeval now;
+        gettimeofday(&now, nullptr);
+        if (now.tv_sec < MIN_VALID_TIME) return false;
+        nowMs = static_cast<uint64_t>(now.tv_sec) * 1000 + now.tv_usec / 1000;
+        return true;
+    }
+
+    void setMembership(const uint32_t mask) {
+        membership = mask;
+        Settings::saveGroups(mask);
+    }
+
+    uint32_t getMembership() {
+        return membership;
+    }
+
+    bool isMember(const int group) {
+        return group >= 0 && group < MAX_GROUPS && (membership & (1u << group)) != 0;
+    }
+
+    void setCommandListener(GroupCommandCallback callback) {
+        commandCallback = callback;
+    }
+
+    bool schedule(const uint64_t atMs, const char *message, const size_t length) {
+        if (length > sizeof(queue[0].message)) return false;
+        for (Scheduled &slot : queue) {
+            if (slot.used) continue;
+            memcpy(slot.message, message, length);
+            slot.length = length;
+            slot.atMs = atMs;
+            slot.used = true;
+            return true;
+        }
+        ESP_LOGW(TAG, "Schedule queue full, command dropped");
+        return false;
+    }
+
+    size_t pendingCount() {
+        size_t count = 0;
+        for (const Scheduled &slot : queue) {
+            if (slot.used) count++;
+        }
+        return count;
+    }
+
+    /**
+     * @return The earliest waiting command, or nullptr if none is waiting
+     */
+    static Scheduled *earliest() {
+        Scheduled *first = nullptr;
+        for (Scheduled &slot : queue) {
+            if (slot.used && (first == nullptr || slot.atMs < first->atMs)) first = &slot;
+        }
+        return first;
+    }
+
+    void handle() {
+        uint64_t now;
+        if (!clockMs(now)) return;
+
+        Scheduled *next;
+        while ((next = earliest()) != nullptr && next->atMs <= now) {
+            EventLog::log(EventLog::SCHEDULED_RUN, now - next->atMs);
+            if (commandCallback != nullptr) {
+                // The sender was answered when the command was accepted
+                char sink[64];
+                ResponseWriter reply(sink, sizeof(sink));
+                commandCallback(next->message, next->length, reply);
+            }
+            next->used = false;
+        }
+    }
+
+    uint32_t msUntilDue() {
+        const Scheduled *next = earliest();
+        uint64_t now;
+        if (next == nullptr || !clockMs(now)) return UINT32_MAX;
+        return next->atMs <= now ? 0 : static_cast<uint32_t>(min<uint64_t>(next->atMs - now, UINT32_MAX));
+    }
+}
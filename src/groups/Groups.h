@@ -0,0 +1,91 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../parser/ResponseWriter.h"
+
+/**
+ * @brief Callback type for running a scheduled command
+ * @param message Command line, as received
+ * @param length Length of the command line
+ * @param reply Output reply; discarded, the sender was answered when the command was scheduled
+ * @return true if the command was processed successfully
+ */
+typedef bool (*GroupCommandCallback)(const char *message, size_t length, ResponseWriter &reply);
+
+/**
+ * @brief Fleet control: group membership, a shared wall clock and commands scheduled on it
+ *
+ * A command carrying "group" is executed only by members of that group, so one multicast
+ * datagram can address part of a fleet. A command carrying "at" (Unix time in milliseconds)
+ * is held until the SNTP-synchronized clock reaches it, so every device applies it at the
+ * same moment no matter how long delivery took.
+ */
+namespace Groups {
+    constexpr int MAX_GROUPS = 32;          ///< Groups are numbered 0-31
+    constexpr size_t MAX_SCHEDULED = 4;     ///< Commands waiting for their time at once
+    constexpr uint32_t MAX_LEAD_MS = 60000; ///< Furthest a command may be scheduled ahead
+
+    /**
+     * @brief Restores the group membership saved in Settings
+     */
+    void init();
+
+    /**
+     * @brief Starts SNTP once the network is up; repeated calls are ignored
+     */
+    void startClock();
+
+    /**
+     * @brief Reads the synchronized wall clock
+     * @param nowMs Set to the Unix time in milliseconds
+     * @return false until SNTP has set the clock
+     */
+    bool clockMs(uint64_t &nowMs);
+
+    /**
+     * @brief Replaces and persists the group membership
+     * @param mask One bit per group
+     */
+    void setMembership(uint32_t mask);
+
+    /**
+     * @brief Returns the group membership, one bit per group
+     */
+    uint32_t getMembership();
+
+    /**
+     * @brief Whether this device belongs to a group
+     */
+    bool isMember(int group);
+
+    /**
+     * @brief Sets the function that runs scheduled commands
+     * @param callback Callback function
+     */
+    void setCommandListener(GroupCommandCallback callback);
+
+    /**
+     * @brief Holds a command until the clock reaches its time
+     * @param atMs Unix time in milliseconds to run the command at
+     * @param message Command line; copied
+     * @param length Length of the command line
+     * @return false if the command is too long or the queue is full
+     */
+    bool schedule(uint64_t atMs, const char *message, size_t length);
+
+    /**
+     * @brief Number of commands waiting for their time
+     */
+    size_t pendingCount();
+
+    /**
+     * @brief Runs the scheduled commands that are due, earliest first
+     */
+    void handle();
+
+    /**
+     * @brief Returns how long until handle() has a scheduled command to run
+     * @return Milliseconds until the earliest command is due, or UINT32_MAX if none is waiting
+     */
+    uint32_t msUntilDue();
+}
@@ -0,0 +1,280 @@
+#include <esp_heap_caps.h>
+#include "Layout.h"
+#include "../settings/Settings.h"
+#include "../switcher/Switcher.h"
+
+#define KEY_LAYOUT "layout"
+
+namespace Layout {
+    static const char *TAG = "LAYOUT";
+
+    // A record payload holds 256 coordinate pairs, so a map is split over a few records
+    static constexpr size_t MAP_LEDS_PER_RECORD = 256;
+    // Tables at least this large go to PSRAM on boards that have it
+    static constexpr size_t PSRAM_MIN_BYTES = 1024;
+
+    struct Table {
+        uint16_t width;
+        uint16_t height;
+        uint16_t cells[MAX_CELLS];
+    };
+
+    // Allocated on first use, so a plain strip costs no table memory
+    static Table *tables[2] = {};
+    static const Table *volatile active = nullptr;
+    static int nextTable = 0;
+    static uint32_t volatile retiredAt = 0; // Switcher::frameSequence() when the spare table was retired
+    // Layout compiled by stage(), published by the render task in commitStaged()
+    static const Table *volatile staged = nullptr;
+    static bool volatile stagePending = false;
+
+    static Config config = {STRIP, 0, 0, 0, 0, 0};
+    static uint8_t mapCoords[Board::TRAITS.maxLeds][2];
+    static size_t stagedLeds = 0;
+    static size_t mapLeds = 0; // LEDs of the complete map held in mapCoords
+
+    static const char *const TYPE_NAMES[] = {"strip", "grid", "map"};
+
+    static Table *allocateTable() {
+        void *memory = nullptr;
+        if constexpr (Board::TRAITS.psram) {
+            if (sizeof(Table) >= PSRAM_MIN_BYTES) memory = heap_caps_malloc(sizeof(Table), MALLOC_CAP_SPIRAM);
+        }
+        if (memory == nullptr) memory = heap_caps_malloc(sizeof(Table), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        return static_cast<Table *>(memory);
+    }
+
+    static bool allocateTables() {
+        if (tables[0] != nullptr) return true;
+        Table *first = allocateTable();
+        Table *second = allocateTable();
+        if (first == nullptr || second == nullptr) {
+            heap_caps_free(first);
+            heap_caps_free(second);
+            ESP_LOGE(TAG, "Failed to allocate layout tables (%u bytes each)", (unsigned) sizeof(Table));
+            return false;
+        }
+        tables[0] = first;
+        tables[1] = second;
+        return true;
+    }
+
+    /**
+     * Turns a physical cell of a width x height arrangement clockwise by quarter turns.
+     */
+    static void rotate(uint8_t rotation, uint16_t width, uint16_t height, uint16_t x, uint16_t y,
+                       uint16_t &rx, uint16_t &ry) {
+        switch (rotation) {
+            case 1: rx = height - 1 - y; ry = x; break;
+            case 2: rx = width - 1 - x; ry = height - 1 - y; break;
+            case 3: rx = y; ry = width - 1 - x; break;
+            default: rx = x; ry = y; break;
+        }
+    }
+
+    /**
+     * Makes a compiled table the one effects read: at once, or with the next scene (stage()).
+     */
+    static void publish(const Table *table, bool now) {
+        if (now) {
+            active = table;
+            retiredAt = Switcher::frameSequence();
+        } else {
+            staged = table;
+            stagePending = true;
+        }
+    }
+
+    static bool compile(const Config &cfg, bool now = true) {
+        // A staged table is the spare one until the render task has published it
+        while (stagePending) vTaskDelay(1);
+        if (cfg.type == STRIP) {
+            publish(nullptr, now);
+            return true;
+        }
+
+        uint16_t width = 0;
+        uint16_t height = 0;
+        size_t leds = 0;
+        if (cfg.type == GRID) {
+            width = cfg.width;
+            height = cfg.height;
+            leds = width * height;
+        } else {
+            leds = cfg.mapLeds;
+            for (size_t i = 0; i < leds; i++) {
+                width = max<uint16_t>(width, mapCoords[i][0] + 1);
+                height = max<uint16_t>(height, mapCoords[i][1] + 1);
+            }
+        }
+        const size_t cells = static_cast<size_t>(width) * height;
+        if (leds == 0 || leds > Board::TRAITS.maxLeds || cells > MAX_CELLS) {
+            ESP_LOGW(TAG, "Layout of %ux%u with %u LEDs does not fit", width, height, (unsigned) leds);
+            return false;
+        }
+        if (!allocateTables()) return false;
+
+        // The spare table may still be read by the frame that was drawn when it was retired
+        Switcher::waitForFrame(retiredAt);
+        Table &table = *tables[nextTable];
+        const bool quarterTurn = cfg.rotation & 1;
+        table.width = quarterTurn ? height : width;
+        table.height = quarterTurn ? width : height;
+        for (size_t i = 0; i < cells; i++) table.cells[i] = NONE;
+
+        for (size_t i = 0; i < leds; i++) {
+            uint16_t x;
+            uint16_t y;
+            if (cfg.type == GRID) {
+                y = i / width;
+                x = i % width;
+                if (cfg.serpentine && (y & 1)) x = width - 1 - x;
+            } else {
+                x = mapCoords[i][0];
+                y = mapCoords[i][1];
+            }
+            uint16_t rx;
+            uint16_t ry;
+            rotate(cfg.rotation, width, height, x, y, rx, ry);
+            table.cells[ry * table.width + rx] = i;
+        }
+
+        publish(&table, now);
+        nextTable ^= 1;
+        ESP_LOGI(TAG, "Compiled %s layout: %ux%u cells, %u LEDs", typeName(cfg.type), table.width, table.height,
+                 (unsigned) leds);
+        return true;
+    }
+
+    static void mapKeyFor(size_t record, char *key, size_t size) {
+        snprintf(key, size, "lmap%u", (unsigned) record);
+    }
+
+    static bool saveMap(size_t leds) {
+        for (size_t record = 0; record * MAP_LEDS_PER_RECORD < leds; record++) {
+            const size_t first = record * MAP_LEDS_PER_RECORD;
+            const size_t count = min(MAP_LEDS_PER_RECORD, leds - first);
+            char key[8];
+            mapKeyFor(record, key, sizeof(key));
+            if (!Settings::saveRecord(key, mapCoords[first], count * 2)) return false;
+        }
+        return true;
+    }
+
+    static bool loadMap(size_t leds) {
+        for (size_t record = 0; record * MAP_LEDS_PER_RECORD < leds; record++) {
+            const size_t first = record * MAP_LEDS_PER_RECORD;
+            const size_t count = min(MAP_LEDS_PER_RECORD, leds - first);
+            char key[8];
+            mapKeyFor(record, key, sizeof(key));
+            if (!Settings::loadRecord(key, mapCoords[first], count * 2)) return false;
+        }
+        return true;
+    }
+
+    static bool saveConfig() {
+        return Settings::saveRecord(KEY_LAYOUT, &config, sizeof(config));
+    }
+
+    static bool apply(const Config &cfg) {
+        if (!compile(cfg)) return false;
+        config = cfg;
+        return saveConfig();
+    }
+
+    void init() {
+        Config stored = {};
+        if (!Settings::loadRecord(KEY_LAYOUT, &stored, sizeof(stored)) || stored.type == STRIP) return;
+
+        const bool valid = stored.rotation < 4 && stored.type <= MAP
+                           && (stored.type != MAP || (stored.mapLeds <= Board::TRAITS.maxLeds && loadMap(stored.mapLeds)));
+        if (valid && compile(stored)) {
+            config = stored;
+            if (stored.type == MAP) mapLeds = stored.mapLeds;
+        } else {
+            ESP_LOGW(TAG, "Stored layout is invalid, using a plain strip");
+        }
+    }
+
+    bool setStrip() {
+        stagedLeds = 0;
+        return apply({STRIP, 0, 0, 0, 0, 0});
+    }
+
+    bool setGrid(int width, int height, bool serpentine, int rotation) {
+        if (width < 1 || width > MAX_DIMENSION || height < 1 || height > MAX_DIMENSION
+            || width * height > Board::TRAITS.maxLeds || rotation < 0 || rotation > 3) {
+            return false;
+        }
+        stagedLeds = 0;
+        return apply({GRID, static_cast<uint8_t>(width), static_cast<uint8_t>(height), serpentine,
+                      static_cast<uint8_t>(rotation), 0});
+    }
+
+    bool storeMapChunk(size_t offset, const uint8_t *coords, size_t count, size_t total, int rotation,
+                       bool &complete) {
+        complete = false;
+        if (offset == 0) stagedLeds = 0;
+        if (offset != stagedLeds || total == 0 || total > Board::TRAITS.maxLeds || offset + count > total
+            || rotation < 0 || rotation > 3) {
+            ESP_LOGW(TAG, "Map chunk at %u out of sequence or too large", (unsigned) offset);
+            return false;
+        }
+        if (offset == 0) mapLeds = 0; // The previous map is overwritten from here on
+        memcpy(mapCoords[offset], coords, count * 2);
+        stagedLeds += count;
+        if (stagedLeds < total) return true;
+
+        stagedLeds = 0;
+        mapLeds = total;
+        const Config cfg = {MAP, 0, 0, 0, static_cast<uint8_t>(rotation), static_cast<uint16_t>(total)};
+        if (!compile(cfg)) return false;
+        config = cfg;
+        complete = true;
+        return saveMap(total) && saveConfig();
+    }
+
+    bool isValid(const Config &cfg) {
+        if (cfg.rotation > 3) return false;
+        switch (cfg.type) {
+        case STRIP: return true;
+        case GRID: return cfg.width > 0 && cfg.height > 0 && cfg.width * cfg.height <= Board::TRAITS.maxLeds;
+        case MAP: return cfg.mapLeds > 0 && cfg.mapLeds == mapLeds;
+        default: return false;
+        }
+    }
+
+    bool stage(const Config &cfg) {
+        if (!isValid(cfg)) {
+            ESP_LOGW(TAG, "Cannot stage %s layout", typeName(cfg.type));
+            return false;
+        }
+        stagedLeds = 0;
+        if (!compile(cfg, false)) return false;
+        config = cfg;
+        return saveConfig();
+    }
+
+    void commitStaged() {
+        if (!stagePending) return;
+        active = staged;
+        retiredAt = Switcher::frameSequence();
+        stagePending = false;
+    }
+
+    View current(int numLeds) {
+        const Table *table = active;
+        if (table == nullptr) {
+            return {static_cast<uint16_t>(numLeds), 1, nullptr, static_cast<uint16_t>(numLeds)};
+        }
+        return {table->width, table->height, table->cells, static_cast<uint16_t>(numLeds)};
+    }
+
+    Config getConfig() {
+        return config;
+    }
+
+    const char *typeName(uint8_t type) {
+        return type <= MAP ? TYPE_NAMES[type] : "";
+    }
+}
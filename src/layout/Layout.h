@@ -0,0 +1,124 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../board/BoardTraits.h"
+
+/**
+ * @brief Physical arrangement of the LEDs for 2D-aware effects
+ *
+ * The strip is a plain line by default. A grid (width, height, serpentine wiring, rotation) or an
+ * uploaded coordinate per LED is compiled once into a table that maps every (x, y) cell straight
+ * to an LED index, so effects address pixels with a single lookup. Cells without an LED hold
+ * NONE. Tables are double-buffered: a new layout is compiled while the render task still reads
+ * the previous one.
+ */
+namespace Layout {
+    constexpr uint16_t NONE = 0xFFFF;                     ///< Cell without an LED
+    constexpr int MAX_DIMENSION = 255;                    ///< Coordinates are stored as bytes
+    constexpr size_t MAX_CELLS = Board::TRAITS.maxLeds * 4; ///< Room for sparse custom maps
+
+    enum Type : uint8_t {
+        STRIP, ///< LEDs in a line: x is the LED index, height is 1
+        GRID,  ///< Rows of `width` LEDs, optionally wired serpentine
+        MAP    ///< Uploaded (x, y) coordinate per LED
+    };
+
+    /**
+     * @brief Persisted layout description
+     */
+    struct __attribute__((packed)) Config {
+        uint8_t type;       ///< Type
+        uint8_t width;      ///< GRID: LEDs per row
+        uint8_t height;     ///< GRID: number of rows
+        uint8_t serpentine; ///< GRID: every other row runs backwards
+        uint8_t rotation;   ///< Clockwise quarter turns, 0-3
+        uint16_t mapLeds;   ///< MAP: number of LEDs with a coordinate
+    };
+
+    /**
+     * @brief Compiled layout as seen by an effect during one frame
+     */
+    struct View {
+        uint16_t width;
+        uint16_t height;
+        const uint16_t *cells; ///< Row-major cell table, nullptr for STRIP
+        uint16_t numLeds;
+
+        /**
+         * @brief LED at a cell, or NONE if the cell is empty or beyond the current LED count
+         */
+        inline uint16_t at(uint16_t x, uint16_t y) const {
+            const uint16_t index = cells ? cells[y * width + x] : x;
+            return index < numLeds ? index : NONE;
+        }
+    };
+
+    /**
+     * @brief Loads and compiles the stored layout
+     */
+    void init();
+
+    /**
+     * @brief Switches back to a plain strip
+     * @return true if the change was written
+     */
+    bool setStrip();
+
+    /**
+     * @brief Compiles and persists a grid layout
+     * @param width LEDs per row
+     * @param height Number of rows
+     * @param serpentine Every other row runs backwards
+     * @param rotation Clockwise quarter turns, 0-3
+     * @return false if the grid is empty, does not fit the LED buffer or the rotation is invalid
+     */
+    bool setGrid(int width, int height, bool serpentine, int rotation);
+
+    /**
+     * @brief Adds a chunk of an uploaded coordinate map; the map is compiled and persisted once
+     *        the last chunk arrives
+     * @param offset Index of the first LED in this chunk; 0 starts a new upload
+     * @param coords (x, y) byte pairs, one per LED
+     * @param count Number of LEDs in this chunk
+     * @param total Number of LEDs in the whole map
+     * @param rotation Clockwise quarter turns, 0-3
+     * @param complete Set to true when this chunk completed the map
+     * @return false if the chunk is out of sequence, too large or the map does not fit
+     */
+    bool storeMapChunk(size_t offset, const uint8_t *coords, size_t count, size_t total, int rotation,
+                       bool &complete);
+
+    /**
+     * @brief Checks a layout description, e.g. one stored in a preset
+     * @return false for invalid values, or a MAP whose LED count differs from the uploaded map
+     */
+    bool isValid(const Config &cfg);
+
+    /**
+     * @brief Compiles and persists a layout without showing it yet; the render task switches to
+     *        it in commitStaged(), so it can change on the same frame as a scene
+     * @return false if the layout is invalid or does not fit
+     */
+    bool stage(const Config &cfg);
+
+    /**
+     * @brief Publishes the layout compiled by stage(); called by the render task
+     */
+    void commitStaged();
+
+    /**
+     * @brief Returns the compiled layout for rendering one frame
+     * @param numLeds Current LED count; cells referring to LEDs beyond it read as NONE
+     */
+    View current(int numLeds);
+
+    /**
+     * @brief Returns the persisted layout description
+     */
+    Config getConfig();
+
+    /**
+     * @brief Returns the name of a layout type ("strip", "grid", "map")
+     */
+    const char *typeName(uint8_t type);
+}
@@ -9,29 +9,69 @@
 #include "parser/DataParser.h"
 #include "board/BoardSelector.h"
 #include "switcher/Switcher.h"
+#include "boot/BootProfiler.h"
+#include "presets/Presets.h"
+#include "palettes/Palettes.h"
+#include "user_effect/UserEffect.h"
+#include "layout/Layout.h"
+#include "animation/Animation.h"
+#include "groups/Groups.h"
+#include "events/AppEvents.h"
+#include "tasks/Tasks.h"
 
 #undef ARDUHAL_LOG_FORMAT
 #define ARDUHAL_LOG_FORMAT(letter, format) ARDUHAL_LOG_COLOR_ ## letter "[" #letter "]: " format ARDUHAL_LOG_RESET_COLOR "\r\n"
 
 static const char *TAG = "MAIN";
 
+// WiFiServer/WiFiUDP offer no readiness callback, so sockets are checked at this interval while connected
+static constexpr uint32_t NETWORK_POLL_MS = 10;
+// Upper bound on how long the persistence task sleeps before re-checking for pending changes
+static constexpr uint32_t PERSISTENCE_POLL_MS = 1000;
+
+static TaskHandle_t networkTaskHandle = nullptr;
+
 Button button(Pins::BUTTON);
 BtIndicator btIndicator;
 Effects::Mode currentMode = Effects::RAINBOW;
 bool isSystemOff = false;
 
-bool onCommandMessageReceived(const String &message) {
-    return DataParser::parse(message);
+void setSystemOff(bool off) {
+    isSystemOff = off;
+    Switcher::setSystemOff(isSystemOff);
+    Settings::saveSystemState(isSystemOff);
+    WiFiManager::setPowerProfile(isSystemOff ? POWER_SAVE : LOW_LATENCY);
+}
+
+void notifyLocalStateChange() {
+    char buffer[48];
+    ResponseWriter state(buffer, sizeof(buffer));
+    state.add("{\"type\":\"state\",\"mode\":").addUnsigned(currentMode);
+    state.add(",\"power\":").addUnsigned(isSystemOff ? 0 : 1).add("}\n");
+    Bluetooth::notifyState(state.c_str());
+}
+
+bool onCommandMessageReceived(const char *message, size_t length, ResponseWriter &reply) {
+    const bool result = DataParser::parse(message, length, reply);
+    // A command from the network task may have moved loop()'s deadlines (Wi-Fi, BLE)
+    AppEvents::notify(AppEvents::NETWORK);
+    return result;
 }
 
-void onWifiStatusChanged(bool connected, const String &message) {
+void onWifiStatusChanged(bool connected, const char *message) {
     if (connected) {
         SocketManager::init();
         SocketManager::setMessageListener(onCommandMessageReceived);
         UdpManager::init();
         UdpManager::setMessageListener(onCommandMessageReceived);
+        Groups::startClock();
+        BootProfiler::mark(BootProfiler::SERVERS_READY);
+        if (networkTaskHandle) xTaskNotifyGive(networkTaskHandle);
         // Send info back to BLE
         Bluetooth::sendWiFiConnectInfo(true, message);
+        if (Settings::isBleReleaseEnabled()) {
+            Bluetooth::releaseMemory();
+        }
     } else {
         // Send info back to BLE
         Bluetooth::sendWiFiConnectInfo(false, message);
@@ -42,17 +82,22 @@ void onWifiStatusChanged(bool connected, const String &message) {
     }
 }
 
+/**
+ * Applies credentials written over BLE; runs from Bluetooth::handle() in loop(), under the state lock.
+ */
 void onBleDataReceived(String value) {
-    ESP_LOGI(TAG, "Received message: %s", value.c_str());
-
     int colonIndex = value.indexOf(':');
     if (colonIndex != -1) {
         String ssid = value.substring(0, colonIndex);
         String password = value.substring(colonIndex + 1);
         ESP_LOGI(TAG, "Extracted SSID: %s", ssid.c_str());
+        if (ssid.isEmpty() || ssid.length() >= Settings::SSID_SIZE || password.length() >= Settings::PASSWORD_SIZE) {
+            ESP_LOGW(TAG, "Invalid SSID or password length");
+            return;
+        }
 
-        WiFiManager::connect(ssid, password);
-        Settings::setWiFiCredentials(ssid, password);
+        WiFiManager::connect(ssid.c_str(), password.c_str());
+        Settings::setWiFiCredentials(ssid.c_str(), password.c_str());
     } else {
         ESP_LOGW(TAG, "Invalid format received. Expected 'ssid:password'");
     }
@@ -60,56 +105,169 @@ void onBleDataReceived(String value) {
 
 void onBleStateChanged(BT_ConnectionState state) {
     btIndicator.setState(state);
+    if (state == BT_DISABLED) {
+        // BLE coexistence forces modem sleep; restore the profile once the radio is WiFi-only
+        WiFiManager::setPowerProfile(WiFiManager::getPowerProfile());
+    }
+}
+
+/**
+ * Steps brightness from the button: double click jumps up an eighth (wrapping to dim),
+ * click-and-hold ramps and turns around at either end.
+ */
+void stepBrightness(ButtonAction action) {
+    static constexpr int HOLD_STEP = 8;
+    static constexpr int CLICK_STEP = 32;
+    static constexpr int MIN_BRIGHTNESS = 8;
+    static int holdDirection = 1;
+
+    int value = Switcher::getBrightness();
+    if (action == DOUBLE_CLICK) {
+        value = value >= 255 ? MIN_BRIGHTNESS : value + CLICK_STEP;
+    } else {
+        value += holdDirection * HOLD_STEP;
+        if (value >= 255 || value <= MIN_BRIGHTNESS) holdDirection = -holdDirection;
+    }
+    value = constrain(value, MIN_BRIGHTNESS, 255);
+    Switcher::setBrightness(value);
+    Settings::saveBrightness(value);
+    ESP_LOGD(TAG, "Brightness stepped to: %d", value);
+}
+
+/**
+ * Returns how long loop() may sleep: the nearest deadline of all timer-driven modules.
+ */
+uint32_t msUntilNextWork() {
+    uint32_t timeout = AppEvents::NO_DEADLINE;
+    const auto nearest = [&timeout](uint32_t ms) {
+        if (ms < timeout) timeout = ms;
+    };
+    nearest(btIndicator.msUntilDeadline());
+    nearest(button.msUntilDeadline());
+    nearest(Bluetooth::msUntilDeadline());
+    nearest(WiFiManager::msUntilNextAction());
+    return timeout;
+}
+
+/**
+ * Serves UDP and TCP and runs scheduled commands while Wi-Fi is up; parks while it is down.
+ */
+void networkTask(void *pvParameters) {
+    for (;;) {
+        bool connected;
+        uint32_t wait = NETWORK_POLL_MS;
+        {
+            Tasks::StateLock lock;
+            connected = WiFiManager::isConnected();
+            if (connected) {
+                UdpManager::handle();
+                SocketManager::handle();
+                Groups::handle();
+                // Wake up right on time for the next scheduled command
+                wait = min(wait, Groups::msUntilDue());
+            }
+        }
+        if (connected) {
+            // At least one tick, so other tasks can take the state lock between passes
+            vTaskDelay(max<TickType_t>(pdMS_TO_TICKS(wait), 1));
+        } else {
+            // Woken by onWifiStatusChanged() once the servers are up
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+    }
+}
+
+/**
+ * Commits debounced settings in the background so flash writes never stall loop() or the renderer.
+ */
+void persistenceTask(void *pvParameters) {
+    for (;;) {
+        uint32_t wait;
+        {
+            Tasks::StateLock lock;
+            Settings::handleSettingsSync();
+            wait = Settings::msUntilSync();
+        }
+        vTaskDelay(pdMS_TO_TICKS(wait < PERSISTENCE_POLL_MS ? wait + 1 : PERSISTENCE_POLL_MS));
+    }
 }
 
 void setup() {
     Serial.begin(115200);
+    BootProfiler::mark(BootProfiler::SERIAL_READY);
 
     // Restore settings
     int savedMode;
     int savedBrightness;
     int savedNumLeds;
     Settings::loadLightSettings(savedMode, isSystemOff, savedBrightness, savedNumLeds);
+    BootProfiler::mark(BootProfiler::SETTINGS_LOADED);
 
     currentMode = static_cast<Effects::Mode>(savedMode);
+    Palettes::init(Settings::getPalette());
+    Effects::initParams(Settings::getEffectParams(), Effects::PARAMS_STORAGE_SIZE);
+    UserEffect::init();
+    Layout::init();
+    Animation::init();
+    Groups::init();
+    Groups::setCommandListener(onCommandMessageReceived);
+    if (!Effects::isAvailable(currentMode)) currentMode = Effects::RAINBOW;
+
+    Tasks::init();
 
-    // Switcher and FastLED initializing
-    Switcher::init(savedNumLeds);
+    // Switcher and FastLED initializing; the first frame is shown before any radio work
+    // The wire layout is set before the controller is created so its length is right from the start
+    Switcher::setColorOrder(static_cast<Switcher::ColorOrder>(Settings::getColorOrder()), Settings::hasWhiteChannel());
+    Switcher::init(savedNumLeds, static_cast<Switcher::Chipset>(Settings::getChipset()));
     Switcher::setMode(currentMode);
     Switcher::setSystemOff(isSystemOff);
     Switcher::setBrightness(savedBrightness);
+    Switcher::setDithering(Settings::isDitherEnabled());
+    Switcher::start();
     ESP_LOGI(TAG, "System state: %s", isSystemOff ? "OFF" : "ON");
     ESP_LOGI(TAG, "Loaded mode: %d", currentMode);
     ESP_LOGI(TAG, "Brightness: %d, LED count: %d", savedBrightness, savedNumLeds);
 
     DataParser::setContext(&currentMode, &isSystemOff);
+    AppEvents::init();
+    button.begin();
+    WiFiManager::setPowerProfile(isSystemOff ? POWER_SAVE : LOW_LATENCY);
+    Presets::init();
 
     WiFiManager::init(onWifiStatusChanged);
 
-    Bluetooth::init(onBleDataReceived, onBleStateChanged);
+    Bluetooth::init(onBleDataReceived, onBleStateChanged, onCommandMessageReceived);
+
+    Tasks::spawn(networkTask, "NetworkTask", Board::TASKS.network, &networkTaskHandle);
+    Tasks::spawn(persistenceTask, "PersistTask", Board::TASKS.persistence);
+    BootProfiler::mark(BootProfiler::SETUP_DONE);
 }
 
 void loop() {
+    static uint32_t timeout = 0;
+    AppEvents::wait(timeout);
+
+    Tasks::StateLock lock;
     btIndicator.handle();
+    Bluetooth::handle();
 
-    switch (button.handle()) {
+    const ButtonAction action = button.handle();
+    switch (action) {
         case SHORT_PRESS:
             if (!isSystemOff) {
-                currentMode = static_cast<Effects::Mode>((currentMode + 1) % Effects::NUM_MODES);
+                do {
+                    currentMode = static_cast<Effects::Mode>((currentMode + 1) % Effects::NUM_MODES);
+                } while (!Effects::isAvailable(currentMode));
                 Switcher::setMode(currentMode);
                 Settings::saveLightMode(currentMode);
                 ESP_LOGI(TAG, "Mode changed to: %d", currentMode);
             } else {
-                isSystemOff = false;
-                Switcher::setSystemOff(isSystemOff);
-                Settings::saveSystemState(isSystemOff);
+                setSystemOff(false);
                 ESP_LOGI(TAG, "System ON, Mode: %d", currentMode);
             }
             break;
         case MEDIUM_PRESS:
-            isSystemOff = !isSystemOff;
-            Switcher::setSystemOff(isSystemOff);
-            Settings::saveSystemState(isSystemOff);
+            setSystemOff(!isSystemOff);
             if (isSystemOff) {
                 ESP_LOGI(TAG, "System OFF");
                 Bluetooth::disable();
@@ -121,23 +279,25 @@ void loop() {
             if (!isSystemOff) {
                 Bluetooth::enable();
             } else {
-                isSystemOff = false;
-                Switcher::setSystemOff(isSystemOff);
-                Settings::saveSystemState(isSystemOff);
+                setSystemOff(false);
                 ESP_LOGI(TAG, "System ON, Mode: %d", currentMode);
             }
             break;
+        case DOUBLE_CLICK:
+        case HOLD_REPEAT:
+            if (!isSystemOff) {
+                stepBrightness(action);
+            }
+            break;
         case NO_ACTION:
         default:
             break;
     }
-
-    Settings::handleSettingsSync();
+    if (action != NO_ACTION) {
+        notifyLocalStateChange();
+    }
 
     WiFiManager::handleReconnect();
 
-    if (WiFiManager::isConnected()) {
-        UdpManager::handle();
-        SocketManager::handle();
-    }
+    timeout = msUntilNextWork();
 }
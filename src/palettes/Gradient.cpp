@@ -0,0 +1,32 @@
+#include "Gradient.h"
+
+namespace Palettes {
+    bool isValid(const Stop *stops, size_t count) {
+        if (count < 2 || count > MAX_STOPS) return false;
+        if (stops[0].position != 0 || stops[count - 1].position != 255) return false;
+        for (size_t i = 1; i < count; i++) {
+            if (stops[i].position < stops[i - 1].position) return false;
+        }
+        return true;
+    }
+
+    void expand(const Stop *stops, size_t count, uint8_t *rgb) {
+        // Like FastLED, stops after the first one at 255 are ignored
+        for (size_t i = 1; i < count && stops[i - 1].position < 255; i++) {
+            const Stop &from = stops[i - 1];
+            const Stop &to = stops[i];
+            const uint8_t start[3] = {from.r, from.g, from.b};
+            const uint8_t end[3] = {to.r, to.g, to.b};
+            const int distance = to.position - from.position;
+            for (int c = 0; c < 3; c++) {
+                // Steps of 1/128 channel unit per entry, accumulated in 8.8
+                const int delta = (end[c] - start[c]) * 128 / (distance ? distance : 1) * 2;
+                uint16_t value = start[c] << 8;
+                for (int index = from.position; index <= to.position; index++) {
+                    rgb[index * 3 + c] = value >> 8;
+                    value += delta;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Expansion of gradient stops into a 256-entry color table
+ *
+ * Works on plain RGB byte triples, so it runs on the host as well as into the FastLED table.
+ */
+namespace Palettes {
+    constexpr size_t MAX_STOPS = 16;
+    constexpr size_t TABLE_SIZE = 256;
+
+    /**
+     * @brief Gradient stop, laid out like a FastLED gradient palette entry
+     */
+    struct __attribute__((packed)) Stop {
+        uint8_t position; ///< 0 for the first stop, 255 for the last
+        uint8_t r;
+        uint8_t g;
+        uint8_t b;
+    };
+
+    /**
+     * @brief Checks that stops form a complete gradient
+     * @return true for 2..MAX_STOPS stops with non-decreasing positions from 0 to 255
+     */
+    bool isValid(const Stop *stops, size_t count);
+
+    /**
+     * @brief Fills a table with the linear gradient through the stops, with the same 8.7
+     *        fixed-point steps as FastLED's loadDynamicGradientPalette()
+     * @param stops Stops that passed isValid()
+     * @param count Number of stops
+     * @param rgb TABLE_SIZE RGB triples
+     */
+    void expand(const Stop *stops, size_t count, uint8_t *rgb);
+}
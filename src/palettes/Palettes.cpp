@@ -0,0 +1,102 @@
+#include <Arduino.h>
+#include "Palettes.h"
+#include "../settings/Settings.h"
+#include "../switcher/Switcher.h"
+
+namespace Palettes {
+    static const char *TAG = "PALETTES";
+
+    /**
+     * Stored layout of one slot.
+     */
+    struct __attribute__((packed)) StoredPalette {
+        uint8_t count;
+        Stop stops[MAX_STOPS];
+    };
+
+    static StoredPalette table[MAX_PALETTES] = {};
+    static int selected = NONE;
+
+    // Two tables so a new palette is built while the render task still reads the previous one
+    static CRGBPalette256 luts[2];
+    static CRGBPalette256 partyLut;
+    static CRGBPalette256 *volatile activeLut = nullptr;
+    static int nextLut = 0;
+    static uint32_t retiredAt = 0; // Switcher::frameSequence() when the spare table was retired
+
+    static void keyFor(int slot, char *key, size_t size) {
+        snprintf(key, size, "pal%d", slot);
+    }
+
+    static void build(const StoredPalette &palette) {
+        Switcher::waitForFrame(retiredAt);
+        CRGBPalette256 &lut = luts[nextLut];
+        expand(palette.stops, palette.count, lut.entries[0].raw);
+        activeLut = &lut;
+        nextLut ^= 1;
+        retiredAt = Switcher::frameSequence();
+    }
+
+    void init(int slot) {
+        partyLut = PartyColors_p;
+
+        int loaded = 0;
+        for (int i = 0; i < MAX_PALETTES; i++) {
+            char key[8];
+            keyFor(i, key, sizeof(key));
+            StoredPalette stored = {};
+            if (Settings::loadRecord(key, &stored, sizeof(stored)) && isValid(stored.stops, stored.count)) {
+                table[i] = stored;
+                loaded++;
+            }
+        }
+        ESP_LOGI(TAG, "Loaded %d palettes", loaded);
+        select(slot);
+    }
+
+    bool store(int slot, const Stop *stops, size_t count) {
+        if (slot < 0 || slot >= MAX_PALETTES || !isValid(stops, count)) return false;
+
+        StoredPalette &palette = table[slot];
+        palette = {};
+        palette.count = count;
+        memcpy(palette.stops, stops, count * sizeof(Stop));
+
+        char key[8];
+        keyFor(slot, key, sizeof(key));
+        // Only the used stops are written
+        if (!Settings::saveRecord(key, &palette, 1 + count * sizeof(Stop))) return false;
+        ESP_LOGI(TAG, "Palette %d saved: %u stops", slot, (unsigned) count);
+        return select(slot);
+    }
+
+    bool select(int slot) {
+        if (slot == NONE) {
+            activeLut = nullptr;
+            retiredAt = Switcher::frameSequence();
+            selected = NONE;
+            return true;
+        }
+        if (getStopCount(slot) == 0) return false;
+        build(table[slot]);
+        selected = slot;
+        return true;
+    }
+
+    int getSelected() {
+        return selected;
+    }
+
+    size_t getStopCount(int slot) {
+        if (slot < 0 || slot >= MAX_PALETTES) return 0;
+        return table[slot].count;
+    }
+
+    const CRGBPalette256 *active() {
+        return activeLut;
+    }
+
+    const CRGBPalette256 &party() {
+        return partyLut;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <FastLED.h>
+#include "Gradient.h"
+
+/**
+ * @brief User-uploaded gradient palettes
+ *
+ * A palette is uploaded as up to MAX_STOPS gradient stops and expanded once into a 256-entry
+ * lookup table, so palette-aware effects fetch a pixel color with a single indexed load instead
+ * of interpolating with ColorFromPalette() on every pixel. Stops are kept in RAM and persisted
+ * as one NVS record per slot.
+ */
+namespace Palettes {
+    constexpr int MAX_PALETTES = 4;
+    constexpr int NONE = -1; ///< No palette selected: effects use their built-in colors
+
+    /**
+     * @brief Loads stored palettes and builds the lookup table of the selected one
+     * @param slot Slot selected before the last reboot, or NONE
+     */
+    void init(int slot);
+
+    /**
+     * @brief Validates, persists and selects a palette
+     * @param slot Slot index (0..MAX_PALETTES-1)
+     * @param stops Gradient stops with non-decreasing positions from 0 to 255
+     * @param count Number of stops (2..MAX_STOPS)
+     * @return true if the palette was valid and written
+     */
+    bool store(int slot, const Stop *stops, size_t count);
+
+    /**
+     * @brief Selects a stored palette
+     * @param slot Slot index, or NONE for the built-in colors
+     * @return true if the slot is NONE or holds a palette
+     */
+    bool select(int slot);
+
+    /**
+     * @brief Returns the selected slot, or NONE
+     */
+    int getSelected();
+
+    /**
+     * @brief Returns the number of stops stored in a slot
+     * @param slot Slot index
+     * @return Stop count, 0 if the slot is invalid or empty
+     */
+    size_t getStopCount(int slot);
+
+    /**
+     * @brief Lookup table of the selected palette, read by the render task
+     * @return Table, or nullptr when no palette is selected
+     */
+    const CRGBPalette256 *active();
+
+    /**
+     * @brief Built-in party palette expanded to a lookup table (used by BPM without a user palette)
+     */
+    const CRGBPalette256 &party();
+}
@@ -5,9 +5,40 @@
 #include "../settings/Settings.h"
 #include "../switcher/Switcher.h"
 #include "../effects/Effects.h"
+#include "../boot/BootProfiler.h"
+#include "../presets/Presets.h"
+#include "../palettes/Palettes.h"
+#include "../user_effect/UserEffect.h"
+#include "../audio/AudioFeatures.h"
+#include "../layout/Layout.h"
+#include "../animation/Animation.h"
+#include "../event_log/EventLog.h"
+#include "../groups/Groups.h"
+#include "../udp/UdpManager.h"
+#include "../bluetooth/Bluetooth.h"
+#include "../events/AppEvents.h"
+#include "../board/BoardTraits.h"
+#include "../tasks/Tasks.h"
 
 namespace DataParser {
     static const char *TAG = "PARSER";
+    // get_logs: entries per reply by default and at most; each entry is roughly 100 bytes of JSON
+    static constexpr int DEFAULT_LOG_ENTRIES = 16;
+    static constexpr int MAX_LOG_ENTRIES = 32;
+    // get_logs: room kept after the entries for the closing bracket, "next", "lost" and "}"
+    static constexpr size_t LOG_REPLY_TAIL = 48;
+    // get_status without tasks, worst case: 493 bytes of literal fragments, 31 numbers of at most
+    // 11 characters, parameters, Wi-Fi state and power profile names, 7 boot phases of up to
+    // 30 bytes and the envelope with "id" come to about 1160 bytes
+    static constexpr size_t STATUS_MAX_LENGTH = 1280;
+    // get_status with "tasks":1: largest entry of the task array, and room kept after it
+    static constexpr size_t TASK_ENTRY_MAX = 96;
+    static constexpr size_t TASKS_REPLY_TAIL = 32;
+    static_assert(Board::TRAITS.replyBufferSize >= STATUS_MAX_LENGTH + TASKS_REPLY_TAIL,
+                  "get_status does not fit into the reply buffer");
+    // Same length, so the status can be written before the command runs and patched after
+    static constexpr const char *STATUS_SUCCESS = "Success";
+    static constexpr const char *STATUS_FAILURE = "Failure";
 
     static Effects::Mode *s_currentMode = nullptr;
     static bool *s_isSystemOff = nullptr;
@@ -17,18 +48,185 @@ namespace DataParser {
         s_isSystemOff = isSystemOff;
     }
 
-    bool parse(const String &data) {
-        String input = data;
-        input.trim();
-        ESP_LOGD(TAG, "DATA: %s", input.c_str());
+    /**
+     * Bump allocator for the command document, so parsing never touches the heap. Blocks are
+     * reclaimed all at once when the document is destroyed at the end of parse(). Commands are
+     * parsed under Tasks::StateLock, so one arena serves every transport.
+     */
+    class ArenaAllocator : public ArduinoJson::Allocator {
+    public:
+        void *allocate(size_t size) override {
+            size = align(size);
+            if (HEADER_SIZE + size > sizeof(_arena) - _used) return nullptr;
+            uint8_t *block = _arena + _used + HEADER_SIZE;
+            blockSize(block) = size;
+            _used += HEADER_SIZE + size;
+            _live++;
+            return block;
+        }
 
-        JsonDocument doc;
-        DeserializationError err = deserializeJson(doc, input);
-        if (err) {
-            ESP_LOGW(TAG, "JSON parse error: %s", err.c_str());
-            return false;
+        void deallocate(void *ptr) override {
+            if (ptr != nullptr && --_live == 0) _used = 0;
+        }
+
+        void *reallocate(void *ptr, size_t size) override {
+            if (ptr == nullptr) return allocate(size);
+            uint8_t *block = static_cast<uint8_t *>(ptr);
+            size_t &current = blockSize(block);
+            size = align(size);
+            if (block + current == _arena + _used) {
+                // The newest block grows or shrinks in place
+                if (size > current && size - current > sizeof(_arena) - _used) return nullptr;
+                _used = _used - current + size;
+                current = size;
+                return block;
+            }
+            if (size <= current) return block;
+            void *moved = allocate(size);
+            if (moved == nullptr) return nullptr;
+            memcpy(moved, block, current);
+            _live--;
+            return moved;
+        }
+
+    private:
+        static constexpr size_t HEADER_SIZE = 8;
+        // Room for the variant pool and the strings of the longest command line
+        static constexpr size_t ARENA_SIZE = Board::TRAITS.commandBufferSize * 2 + 2048;
+
+        static size_t align(size_t size) { return (size + HEADER_SIZE - 1) & ~(HEADER_SIZE - 1); }
+        static size_t &blockSize(uint8_t *block) { return *reinterpret_cast<size_t *>(block - HEADER_SIZE); }
+
+        alignas(HEADER_SIZE) uint8_t _arena[ARENA_SIZE];
+        size_t _used = 0;
+        size_t _live = 0;
+    };
+
+    static ArenaAllocator arena;
+
+    /**
+     * Decodes a hex string of binary uploads.
+     * @return false if the string is missing, has an odd length or invalid digits, or decodes
+     *         to more than maxBytes
+     */
+    static bool decodeHex(const char *hex, uint8_t *out, size_t maxBytes, size_t &length) {
+        const size_t hexLength = hex ? strlen(hex) : 0;
+        if (!hex || hexLength % 2 != 0 || hexLength / 2 > maxBytes) return false;
+        length = hexLength / 2;
+        for (size_t i = 0; i < length; i++) {
+            char byte[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+            char *end = nullptr;
+            out[i] = strtoul(byte, &end, 16);
+            if (end != byte + 2) return false;
+        }
+        return true;
+    }
+
+    /**
+     * Appends "name":value for every parameter the effect uses.
+     */
+    static void appendParams(ResponseWriter &reply, Effects::Mode mode, const Effects::Params &params) {
+        bool first = true;
+        for (int i = 0; i < Effects::NUM_PARAMS; i++) {
+            const auto param = static_cast<Effects::Param>(i);
+            if (!Effects::getParamSpec(mode, param).used) continue;
+            if (!first) reply.add(',');
+            reply.add('"').add(Effects::paramName(param)).add("\":").addUnsigned(params.value[i]);
+            first = false;
+        }
+    }
+
+    /**
+     * Appends one entry per FreeRTOS task while there is room; a cut list ends with "tasks_more".
+     */
+    static void appendTasks(ResponseWriter &reply) {
+        static Tasks::TaskStats tasks[Tasks::MAX_TASKS];
+        const size_t taskCount = Tasks::getStats(tasks, Tasks::MAX_TASKS);
+        reply.add(",\"tasks\":[");
+        size_t i = 0;
+        for (; i < taskCount && reply.remaining() >= TASK_ENTRY_MAX + TASKS_REPLY_TAIL; i++) {
+            if (i > 0) reply.add(',');
+            reply.add("{\"name\":\"").add(tasks[i].name).add('"');
+            reply.add(",\"core\":").addInt(tasks[i].core);
+            reply.add(",\"prio\":").addUnsigned(tasks[i].priority);
+            if (Tasks::hasRuntimeStats()) reply.add(",\"cpu\":").addUnsigned(tasks[i].cpuPercent);
+            reply.add(",\"stack_free\":").addUnsigned(tasks[i].stackFree).add('}');
+        }
+        reply.add(']');
+        if (i < taskCount) reply.add(",\"tasks_more\":").addUnsigned(taskCount - i);
+    }
+
+    static void appendStatus(ResponseWriter &reply, bool withTasks) {
+        const Settings::Stats session = Settings::getStats();
+        const Settings::Stats lifetime = Settings::getLifetimeStats();
+        reply.add("\"mode\":").addUnsigned(*s_currentMode);
+        reply.add(",\"power\":").addUnsigned(*s_isSystemOff ? 0 : 1);
+        reply.add(",\"palette\":").addInt(Palettes::getSelected());
+        reply.add(",\"user_effect\":").addUnsigned(UserEffect::getLength());
+        reply.add(",\"params\":{");
+        appendParams(reply, *s_currentMode, Effects::getParams(*s_currentMode));
+        reply.add('}');
+        reply.add(",\"nvs\":{\"commits\":").addUnsigned(session.commits);
+        reply.add(",\"bytes\":").addUnsigned(session.bytesWritten);
+        reply.add(",\"lifetime_commits\":").addUnsigned(lifetime.commits);
+        reply.add(",\"lifetime_bytes\":").addUnsigned(lifetime.bytesWritten).add('}');
+
+        const WiFiManager::Stats wifi = WiFiManager::getStats();
+        reply.add(",\"wifi\":{\"state\":\"").add(WiFiManager::getStateName()).add('"');
+        reply.add(",\"attempts\":").addUnsigned(wifi.attempts);
+        reply.add(",\"connects\":").addUnsigned(wifi.connects);
+        reply.add(",\"fast_connects\":").addUnsigned(wifi.fastConnects);
+        reply.add(",\"reconnect_ms\":").addUnsigned(wifi.lastReconnectMs);
+        reply.add(",\"power_profile\":\"");
+        reply.add(WiFiManager::getPowerProfile() == LOW_LATENCY ? "low_latency" : "power_save");
+        reply.add("\",\"modem_sleep\":").addUnsigned(WiFiManager::isModemSleepEnabled() ? 1 : 0).add('}');
+
+        const Bluetooth::MemoryStats ble = Bluetooth::getMemoryStats();
+        reply.add(",\"heap\":{\"free\":").addUnsigned(ESP.getFreeHeap());
+        reply.add(",\"largest\":").addUnsigned(ESP.getMaxAllocHeap());
+        reply.add(",\"min\":").addUnsigned(ESP.getMinFreeHeap()).add('}');
+        const Switcher::OutputStats output = Switcher::getOutputStats();
+        reply.add(",\"output\":{\"dither\":").addUnsigned(Switcher::isDithering() ? 1 : 0);
+        reply.add(",\"output_us\":").addUnsigned(output.outputUs);
+        reply.add(",\"show_us\":").addUnsigned(output.showUs);
+        reply.add(",\"render_us\":").addUnsigned(output.renderUs);
+        reply.add(",\"blend_us\":").addUnsigned(output.blendUs);
+        reply.add(",\"render_div\":").addUnsigned(Effects::renderDivisor(*s_currentMode));
+        reply.add('}');
+        reply.add(",\"ble\":{\"release\":").addUnsigned(Settings::isBleReleaseEnabled() ? 1 : 0);
+        reply.add(",\"released\":").addUnsigned(ble.released ? 1 : 0);
+        if (ble.released) {
+            reply.add(",\"heap_before\":").addUnsigned(ble.heapBefore);
+            reply.add(",\"heap_after\":").addUnsigned(ble.heapAfter);
+        }
+        reply.add('}');
+
+        const AppEvents::Stats loopStats = AppEvents::getStats();
+        reply.add(",\"loop\":{\"idle_pct\":").addUnsigned(loopStats.idlePercent);
+        reply.add(",\"wakeups_per_s\":").addUnsigned(loopStats.wakeupsPerSecond).add('}');
+
+        const AudioFeatures::Stats audioStats = AudioFeatures::getStats();
+        reply.add(",\"audio\":{\"packets\":").addUnsigned(audioStats.packets);
+        reply.add(",\"dropped\":").addUnsigned(audioStats.dropped);
+        reply.add(",\"malformed\":").addUnsigned(audioStats.malformed).add('}');
+
+        reply.add(",\"boot_us\":{");
+        bool first = true;
+        for (int i = 0; i < BootProfiler::NUM_PHASES; i++) {
+            const auto phase = static_cast<BootProfiler::Phase>(i);
+            const uint32_t us = BootProfiler::elapsedUs(phase);
+            if (us == 0) continue;
+            if (!first) reply.add(',');
+            reply.add('"').add(BootProfiler::name(phase)).add("\":").addUnsigned(us);
+            first = false;
         }
+        reply.add('}');
 
+        // Last, so it can be cut to the room left without touching the fields before it
+        if (withTasks) appendTasks(reply);
+    }
+
+    static bool execute(const JsonDocument &doc, ResponseWriter &reply) {
         const char *cmd = doc["cmd"];
         if (!cmd) {
             ESP_LOGW(TAG, "ERROR: Missing 'cmd' field");
@@ -38,11 +236,10 @@ namespace DataParser {
         if (strcmp(cmd, "set_mode") == 0) {
             if (!s_currentMode) return false;
             int mode = doc["mode"] | -1;
-            if (mode >= 0 && mode < Effects::NUM_MODES) {
+            if (Effects::isAvailable(static_cast<Effects::Mode>(mode))) {
                 *s_currentMode = static_cast<Effects::Mode>(mode);
                 Settings::saveLightMode(mode);
                 Switcher::setMode(*s_currentMode);
-                ESP_LOGI(TAG, "Mode set to: %d", mode);
                 return true;
             }
             ESP_LOGW(TAG, "Invalid mode value: %d", mode);
@@ -56,7 +253,7 @@ namespace DataParser {
                 *s_isSystemOff = (state == 0);
                 Settings::saveSystemState(*s_isSystemOff);
                 Switcher::setSystemOff(*s_isSystemOff);
-                ESP_LOGI(TAG, "System power set to: %s", *s_isSystemOff ? "OFF" : "ON");
+                WiFiManager::setPowerProfile(*s_isSystemOff ? POWER_SAVE : LOW_LATENCY);
                 return true;
             }
             ESP_LOGW(TAG, "Invalid state value: %d", state);
@@ -66,6 +263,7 @@ namespace DataParser {
         if (strcmp(cmd, "get_status") == 0) {
             if (s_currentMode && s_isSystemOff) {
                 ESP_LOGI(TAG, "Status - Mode: %d, Power: %s", *s_currentMode, *s_isSystemOff ? "OFF" : "ON");
+                appendStatus(reply, (doc["tasks"] | 0) == 1);
                 return true;
             }
             return false;
@@ -79,13 +277,12 @@ namespace DataParser {
             }
             Switcher::setBrightness(value);
             Settings::saveBrightness(value);
-            ESP_LOGI(TAG, "Brightness set to: %d", value);
             return true;
         }
 
         if (strcmp(cmd, "set_led_count") == 0) {
             int value = doc["value"] | -1;
-            if (value < 1 || value > 256) {
+            if (value < 1 || value > Board::TRAITS.maxLeds) {
                 ESP_LOGW(TAG, "Invalid LED count: %d", value);
                 return false;
             }
@@ -98,17 +295,474 @@ namespace DataParser {
         if (strcmp(cmd, "set_wifi") == 0) {
             const char *ssid = doc["ssid"];
             const char *password = doc["pass"] | "";
-            if (ssid && strlen(ssid) > 0) {
-                Settings::setWiFiCredentials(String(ssid), String(password));
-                WiFiManager::connect(ssid, password);
-                ESP_LOGI(TAG, "WiFi credentials saved - SSID: %s", ssid);
+            if (!ssid || ssid[0] == '\0' || strlen(ssid) >= Settings::SSID_SIZE) {
+                ESP_LOGW(TAG, "Missing, empty or too long SSID");
+                return false;
+            }
+            if (strlen(password) >= Settings::PASSWORD_SIZE) {
+                ESP_LOGW(TAG, "Password too long");
+                return false;
+            }
+            Settings::setWiFiCredentials(ssid, password);
+            WiFiManager::connect(ssid, password);
+            ESP_LOGI(TAG, "WiFi credentials saved - SSID: %s", ssid);
+            return true;
+        }
+
+        if (strcmp(cmd, "set_ble_release") == 0) {
+            int enabled = doc["enabled"] | -1;
+            if (enabled != 0 && enabled != 1) {
+                ESP_LOGW(TAG, "Invalid enabled value: %d", enabled);
+                return false;
+            }
+            Settings::saveBleRelease(enabled == 1);
+            if (enabled == 1 && WiFiManager::isConnected()) {
+                Bluetooth::releaseMemory();
+            }
+            ESP_LOGI(TAG, "BLE release after provisioning: %s", enabled ? "ON" : "OFF");
+            return true;
+        }
+
+        if (strcmp(cmd, "set_dither") == 0) {
+            int enabled = doc["enabled"] | -1;
+            if (enabled != 0 && enabled != 1) {
+                ESP_LOGW(TAG, "Invalid enabled value: %d", enabled);
+                return false;
+            }
+            Switcher::setDithering(enabled == 1);
+            Settings::saveDither(enabled == 1);
+            ESP_LOGI(TAG, "Temporal dithering: %s", enabled ? "ON" : "OFF");
+            return true;
+        }
+
+        if (strcmp(cmd, "set_strip") == 0) {
+            Switcher::Chipset chipset = static_cast<Switcher::Chipset>(Settings::getChipset());
+            Switcher::ColorOrder order = Switcher::getColorOrder();
+            const char *chipsetName = doc["chipset"];
+            const char *orderName = doc["order"];
+            const int white = doc["white"] | static_cast<int>(Switcher::hasWhiteChannel());
+            if ((chipsetName && !Switcher::parseChipset(chipsetName, chipset))
+                || (orderName && !Switcher::parseOrder(orderName, order)) || (white != 0 && white != 1)) {
+                ESP_LOGW(TAG, "Invalid strip: chipset=%s, order=%s, white=%d",
+                         chipsetName ? chipsetName : "-", orderName ? orderName : "-", white);
+                return false;
+            }
+            Switcher::setColorOrder(order, white == 1);
+            Settings::saveStrip(chipset, order, white == 1);
+            // The driver timing is fixed when the controller is created
+            const bool reboot = chipset != Switcher::getChipset();
+            reply.add("\"reboot\":").addUnsigned(reboot ? 1 : 0);
+            ESP_LOGI(TAG, "Strip: %s, %s%s%s", Switcher::chipsetName(chipset), Switcher::orderName(order),
+                     white ? "+w" : "", reboot ? " (after reboot)" : "");
+            return true;
+        }
+
+        if (strcmp(cmd, "get_strip") == 0) {
+            reply.add("\"chipset\":\"").add(Switcher::chipsetName(Settings::getChipset()));
+            reply.add("\",\"running\":\"").add(Switcher::chipsetName(Switcher::getChipset()));
+            reply.add("\",\"order\":\"").add(Switcher::orderName(Switcher::getColorOrder()));
+            reply.add("\",\"white\":").addUnsigned(Switcher::hasWhiteChannel() ? 1 : 0);
+            return true;
+        }
+
+        if (strcmp(cmd, "save_preset") == 0) {
+            if (!s_currentMode) return false;
+            int slot = doc["slot"] | -1;
+            int mode = doc["mode"] | static_cast<int>(*s_currentMode);
+            int brightness = doc["brightness"] | Switcher::getBrightness();
+            const char *name = doc["name"] | "";
+            if (slot < 0 || slot >= Presets::MAX_PRESETS || mode < 0 || mode >= Effects::NUM_MODES
+                || brightness < 0 || brightness > 255) {
+                ESP_LOGW(TAG, "Invalid preset: slot=%d, mode=%d, brightness=%d", slot, mode, brightness);
+                return false;
+            }
+            const auto effect = static_cast<Effects::Mode>(mode);
+            const Layout::Config layout = Layout::getConfig();
+            const bool withLayout = (doc["layout"] | 0) == 1;
+            return Presets::save(slot, name, effect, brightness, Effects::getParams(effect), withLayout ? &layout : nullptr);
+        }
+
+        if (strcmp(cmd, "recall_preset") == 0) {
+            if (!s_currentMode || !s_isSystemOff) return false;
+            int slot = doc["slot"] | -1;
+            const Presets::Preset *preset = Presets::get(slot);
+            if (!preset) {
+                ESP_LOGW(TAG, "Preset slot %d is empty or invalid", slot);
+                return false;
+            }
+            if (!Effects::isAvailable(static_cast<Effects::Mode>(preset->mode))) {
+                ESP_LOGW(TAG, "Preset %d uses mode %d, which has no uploaded content", slot, preset->mode);
+                return false;
+            }
+            if (preset->hasLayout && !Layout::stage(preset->layout)) {
+                ESP_LOGW(TAG, "Preset %d layout cannot be applied", slot);
+                return false;
+            }
+            // Applied to the render task atomically; persisted later by the settings write-behind
+            *s_currentMode = static_cast<Effects::Mode>(preset->mode);
+            *s_isSystemOff = false;
+            Switcher::setScene(*s_currentMode, preset->brightness, false, preset->hasParams ? &preset->params : nullptr,
+                               preset->hasLayout);
+            if (preset->hasParams) {
+                // The render task applies the parameters with the scene; persist the values it will hold
+                uint8_t values[sizeof(Effects::Params) * Effects::NUM_MODES];
+                memcpy(values, Effects::rawParams(), sizeof(values));
+                memcpy(values + preset->mode * sizeof(Effects::Params), &preset->params, sizeof(Effects::Params));
+                Settings::saveEffectParams(values, sizeof(values));
+            }
+            Settings::saveLightMode(preset->mode);
+            Settings::saveBrightness(preset->brightness);
+            Settings::saveSystemState(false);
+            WiFiManager::setPowerProfile(LOW_LATENCY);
+            ESP_LOGI(TAG, "Preset %d recalled", slot);
+            return true;
+        }
+
+        if (strcmp(cmd, "delete_preset") == 0) {
+            int slot = doc["slot"] | -1;
+            return Presets::remove(slot);
+        }
+
+        if (strcmp(cmd, "get_presets") == 0) {
+            reply.add("\"presets\":[");
+            bool first = true;
+            for (int slot = 0; slot < Presets::MAX_PRESETS; slot++) {
+                const Presets::Preset *preset = Presets::get(slot);
+                if (!preset) continue;
+                if (!first) reply.add(',');
+                reply.add("{\"slot\":").addUnsigned(slot);
+                reply.add(",\"name\":").addQuoted(preset->name);
+                reply.add(",\"mode\":").addUnsigned(preset->mode);
+                reply.add(",\"brightness\":").addUnsigned(preset->brightness);
+                if (preset->hasParams) {
+                    reply.add(",\"params\":{");
+                    appendParams(reply, static_cast<Effects::Mode>(preset->mode), preset->params);
+                    reply.add('}');
+                }
+                if (preset->hasLayout) reply.add(",\"layout\":\"").add(Layout::typeName(preset->layout.type)).add('"');
+                reply.add('}');
+                first = false;
+            }
+            reply.add(']');
+            return true;
+        }
+
+        if (strcmp(cmd, "set_param") == 0) {
+            if (!s_currentMode) return false;
+            int mode = doc["mode"] | static_cast<int>(*s_currentMode);
+            const char *name = doc["param"];
+            int value = doc["value"] | -1;
+            Effects::Param param;
+            if (mode < 0 || mode >= Effects::NUM_MODES || !Effects::parseParam(name, param)
+                || !Effects::setParam(static_cast<Effects::Mode>(mode), param, value)) {
+                ESP_LOGW(TAG, "Invalid parameter: mode=%d, param=%s, value=%d", mode, name ? name : "", value);
+                return false;
+            }
+            Settings::saveEffectParams(Effects::rawParams(), sizeof(Effects::Params) * Effects::NUM_MODES);
+            return true;
+        }
+
+        if (strcmp(cmd, "get_params") == 0) {
+            if (!s_currentMode) return false;
+            int mode = doc["mode"] | static_cast<int>(*s_currentMode);
+            if (mode < 0 || mode >= Effects::NUM_MODES) return false;
+            const auto effect = static_cast<Effects::Mode>(mode);
+            const Effects::Params &params = Effects::getParams(effect);
+            reply.add("\"mode\":").addUnsigned(mode).add(",\"params\":[");
+            bool first = true;
+            for (int i = 0; i < Effects::NUM_PARAMS; i++) {
+                const auto param = static_cast<Effects::Param>(i);
+                const Effects::ParamSpec &spec = Effects::getParamSpec(effect, param);
+                if (!spec.used) continue;
+                if (!first) reply.add(',');
+                reply.add("{\"name\":\"").add(Effects::paramName(param)).add('"');
+                reply.add(",\"value\":").addUnsigned(params.value[i]);
+                reply.add(",\"min\":").addUnsigned(spec.min);
+                reply.add(",\"max\":").addUnsigned(spec.max);
+                reply.add(",\"default\":").addUnsigned(spec.def).add('}');
+                first = false;
+            }
+            reply.add(']');
+            return true;
+        }
+
+        if (strcmp(cmd, "set_user_effect") == 0) {
+            uint8_t code[UserEffect::MAX_CODE];
+            size_t length = 0;
+            if (!decodeHex(doc["code"], code, sizeof(code), length)) {
+                ESP_LOGW(TAG, "Invalid user effect encoding");
+                return false;
+            }
+            if (!UserEffect::store(code, length)) {
+                ESP_LOGW(TAG, "User effect rejected");
+                return false;
+            }
+            if (length == 0 && *s_currentMode == Effects::USER) {
+                // The program is gone: fall back to the first built-in effect
+                *s_currentMode = Effects::RAINBOW;
+                Switcher::setMode(*s_currentMode);
+                Settings::saveLightMode(*s_currentMode);
+            }
+            reply.add("\"length\":").addUnsigned(length);
+            return true;
+        }
+
+        if (strcmp(cmd, "set_layout") == 0) {
+            const int rotation = doc["rotation"] | 0;
+            if (!doc["map"].isNull()) {
+                // Coordinate maps exceed one command line, so they arrive in chunks
+                uint8_t coords[Board::TRAITS.commandBufferSize / 4 * 2];
+                size_t bytes = 0;
+                const int offset = doc["offset"] | -1;
+                const int total = doc["count"] | -1;
+                if (!decodeHex(doc["map"], coords, sizeof(coords), bytes) || bytes % 2 != 0 || offset < 0 || total < 1) {
+                    ESP_LOGW(TAG, "Invalid layout map chunk");
+                    return false;
+                }
+                bool complete = false;
+                if (!Layout::storeMapChunk(offset, coords, bytes / 2, total, rotation, complete)) return false;
+                reply.add("\"complete\":").addUnsigned(complete ? 1 : 0);
                 return true;
             }
-            ESP_LOGW(TAG, "Missing or empty SSID");
-            return false;
+
+            const int width = doc["width"] | 0;
+            const int height = doc["height"] | 0;
+            if (width == 0 && height == 0) return Layout::setStrip();
+            const bool serpentine = (doc["serpentine"] | 0) == 1;
+            if (!Layout::setGrid(width, height, serpentine, rotation)) {
+                ESP_LOGW(TAG, "Invalid layout: %dx%d, rotation %d", width, height, rotation);
+                return false;
+            }
+            return true;
+        }
+
+        if (strcmp(cmd, "get_layout") == 0) {
+            const Layout::Config config = Layout::getConfig();
+            const Layout::View view = Layout::current(Switcher::getNumLeds());
+            reply.add("\"type\":\"").add(Layout::typeName(config.type)).add('"');
+            reply.add(",\"width\":").addUnsigned(view.width);
+            reply.add(",\"height\":").addUnsigned(view.height);
+            if (config.type == Layout::GRID) reply.add(",\"serpentine\":").addUnsigned(config.serpentine);
+            if (config.type == Layout::MAP) reply.add(",\"count\":").addUnsigned(config.mapLeds);
+            reply.add(",\"rotation\":").addUnsigned(config.rotation);
+            return true;
+        }
+
+        if (strcmp(cmd, "anim_begin") == 0) {
+            const long size = doc["size"] | -1L;
+            if (size <= 0 || !Animation::beginUpload(size)) {
+                ESP_LOGW(TAG, "Animation upload of %ld bytes rejected", size);
+                return false;
+            }
+            return true;
+        }
+
+        if (strcmp(cmd, "anim_data") == 0) {
+            uint8_t data[Board::TRAITS.commandBufferSize / 2];
+            size_t length = 0;
+            const long offset = doc["offset"] | -1L;
+            if (offset < 0 || !decodeHex(doc["data"], data, sizeof(data), length)) {
+                ESP_LOGW(TAG, "Invalid animation chunk");
+                return false;
+            }
+            return Animation::writeChunk(offset, data, length);
+        }
+
+        if (strcmp(cmd, "anim_end") == 0) {
+            if (doc["crc"].isNull() || !Animation::finishUpload(doc["crc"].as<uint32_t>())) {
+                ESP_LOGW(TAG, "Animation upload failed verification");
+                return false;
+            }
+            return true;
+        }
+
+        if (strcmp(cmd, "get_animation") == 0) {
+            const Animation::Info info = Animation::getInfo();
+            reply.add("\"ready\":").addUnsigned(info.ready ? 1 : 0);
+            if (info.ready) {
+                reply.add(",\"frames\":").addUnsigned(info.frameCount);
+                reply.add(",\"fps\":").addUnsigned(info.fps);
+                reply.add(",\"leds\":").addUnsigned(info.numLeds);
+                reply.add(",\"size\":").addUnsigned(info.size);
+            }
+            reply.add(",\"capacity\":").addUnsigned(info.capacity);
+            reply.add(",\"decode_us\":").addUnsigned(info.decodeUs);
+            return true;
+        }
+
+        if (strcmp(cmd, "get_logs") == 0) {
+            const uint32_t since = doc["since"] | 0u;
+            const int max = constrain(doc["max"] | DEFAULT_LOG_ENTRIES, 1, MAX_LOG_ENTRIES);
+            uint32_t lost = 0;
+            reply.add("\"logs\":[");
+            const uint32_t next = EventLog::format(since, max, reply, LOG_REPLY_TAIL, lost);
+            reply.add("],\"next\":").addUnsigned(next);
+            reply.add(",\"lost\":").addUnsigned(lost);
+            return true;
+        }
+
+        if (strcmp(cmd, "set_groups") == 0) {
+            JsonArrayConst groups = doc["groups"];
+            if (groups.isNull() || groups.size() > Groups::MAX_GROUPS) {
+                ESP_LOGW(TAG, "Invalid group list");
+                return false;
+            }
+            uint32_t mask = 0;
+            for (JsonVariantConst group : groups) {
+                const int value = group | -1;
+                if (value < 0 || value >= Groups::MAX_GROUPS) {
+                    ESP_LOGW(TAG, "Invalid group: %d", value);
+                    return false;
+                }
+                mask |= 1u << value;
+            }
+            Groups::setMembership(mask);
+            return true;
+        }
+
+        if (strcmp(cmd, "get_groups") == 0) {
+            reply.add("\"groups\":[");
+            bool first = true;
+            for (int group = 0; group < Groups::MAX_GROUPS; group++) {
+                if (!Groups::isMember(group)) continue;
+                if (!first) reply.add(',');
+                reply.addUnsigned(group);
+                first = false;
+            }
+            reply.add("],\"address\":\"" MULTICAST_ADDRESS "\",\"port\":").addUnsigned(MULTICAST_UDP_PORT);
+            uint64_t now = 0;
+            const bool synced = Groups::clockMs(now);
+            reply.add(",\"clock\":").addUnsigned(synced ? 1 : 0);
+            if (synced) reply.add(",\"time\":").addUnsigned64(now);
+            reply.add(",\"pending\":").addUnsigned(Groups::pendingCount());
+            return true;
+        }
+
+        if (strcmp(cmd, "set_palette") == 0) {
+            int slot = doc["slot"] | -1;
+            JsonArrayConst stops = doc["stops"];
+            if (stops.isNull() || stops.size() < 2 || stops.size() > Palettes::MAX_STOPS) {
+                ESP_LOGW(TAG, "Invalid palette: slot=%d", slot);
+                return false;
+            }
+            Palettes::Stop parsed[Palettes::MAX_STOPS];
+            size_t count = 0;
+            for (JsonVariantConst stop : stops) {
+                int position = stop[0] | -1;
+                int r = stop[1] | -1;
+                int g = stop[2] | -1;
+                int b = stop[3] | -1;
+                if (position < 0 || position > 255 || r < 0 || r > 255 || g < 0 || g > 255 || b < 0 || b > 255) {
+                    ESP_LOGW(TAG, "Invalid palette stop %u", (unsigned) count);
+                    return false;
+                }
+                parsed[count++] = {static_cast<uint8_t>(position), static_cast<uint8_t>(r),
+                                   static_cast<uint8_t>(g), static_cast<uint8_t>(b)};
+            }
+            if (!Palettes::store(slot, parsed, count)) {
+                ESP_LOGW(TAG, "Palette %d rejected", slot);
+                return false;
+            }
+            Settings::savePalette(slot);
+            return true;
+        }
+
+        if (strcmp(cmd, "select_palette") == 0) {
+            int slot = doc["slot"] | Palettes::NONE;
+            if (!Palettes::select(slot)) {
+                ESP_LOGW(TAG, "Palette slot %d is empty or invalid", slot);
+                return false;
+            }
+            Settings::savePalette(slot);
+            ESP_LOGI(TAG, "Palette %d selected", slot);
+            return true;
+        }
+
+        if (strcmp(cmd, "get_palettes") == 0) {
+            reply.add("\"selected\":").addInt(Palettes::getSelected());
+            reply.add(",\"palettes\":[");
+            bool first = true;
+            for (int slot = 0; slot < Palettes::MAX_PALETTES; slot++) {
+                const size_t stops = Palettes::getStopCount(slot);
+                if (stops == 0) continue;
+                if (!first) reply.add(',');
+                reply.add("{\"slot\":").addUnsigned(slot).add(",\"stops\":").addUnsigned(stops).add('}');
+                first = false;
+            }
+            reply.add(']');
+            return true;
         }
 
         ESP_LOGW(TAG, "ERROR: Unknown command: %s", cmd);
         return false;
     }
+
+    /**
+     * Hands a command with a future "at" time to the scheduler, which runs it again once the
+     * shared clock reaches that time. Without a synchronized clock, or once the time has come,
+     * the command is left to run right away.
+     * @return true if the command was scheduled or rejected, false if it should run now
+     */
+    static bool deferUntilDue(const JsonDocument &doc, const char *data, size_t length, ResponseWriter &reply,
+                              bool &success) {
+        if (doc["at"].isNull()) return false;
+        const uint64_t at = doc["at"].as<uint64_t>();
+        uint64_t now;
+        if (!Groups::clockMs(now) || at <= now) return false;
+
+        const uint64_t lead = at - now;
+        success = lead <= Groups::MAX_LEAD_MS && Groups::schedule(at, data, length);
+        if (success) {
+            EventLog::log(EventLog::COMMAND_SCHEDULED, length, lead);
+            reply.add("\"scheduled\":1");
+        } else {
+            ESP_LOGW(TAG, "Command for %u ms ahead not scheduled", (unsigned) min<uint64_t>(lead, UINT32_MAX));
+        }
+        return true;
+    }
+
+    bool parse(const char *data, size_t length, ResponseWriter &reply) {
+        while (length > 0 && isspace(static_cast<unsigned char>(data[0]))) {
+            data++;
+            length--;
+        }
+        while (length > 0 && isspace(static_cast<unsigned char>(data[length - 1]))) length--;
+
+        JsonDocument doc(&arena);
+        DeserializationError err = deserializeJson(doc, data, length);
+        if (err) {
+            EventLog::log(EventLog::COMMAND_INVALID, length);
+            reply.add("{\"status\":\"Failure\"}");
+            return false;
+        }
+
+        reply.add('{');
+        if (doc["id"].is<uint32_t>()) reply.add("\"id\":").addUnsigned(doc["id"].as<uint32_t>()).add(',');
+        // The outcome is patched in once the command has run
+        reply.add("\"status\":\"");
+        const size_t status = reply.length();
+        reply.add(STATUS_FAILURE).add('"');
+        const size_t payload = reply.length();
+        reply.add(',');
+
+        bool success = false;
+        if (!doc["group"].isNull() && !Groups::isMember(doc["group"] | -1)) {
+            // Addressed to a group this device is not in
+        } else if (!deferUntilDue(doc, data, length, reply, success)) {
+            success = execute(doc, reply);
+            EventLog::log(EventLog::COMMAND, length, success);
+        }
+        if (reply.overflowed() || reply.remaining() == 0) {
+            // The command has run, so its outcome stands; only the payload that did not fit is dropped
+            ESP_LOGW(TAG, "Reply does not fit in %u bytes, payload dropped",
+                     (unsigned) (reply.length() + reply.remaining()));
+            reply.truncate(payload);
+            reply.add(",\"truncated\":1");
+        } else if (reply.length() == payload + 1) {
+            reply.truncate(payload); // No payload
+        }
+        reply.add('}');
+        if (success) reply.overwrite(status, STATUS_SUCCESS);
+        return success;
+    }
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../effects/Effects.h"
+#include "ResponseWriter.h"
 
 /**
  * @brief Utility for parsing incoming data strings
@@ -14,9 +15,12 @@ namespace DataParser {
     void setContext(Effects::Mode *mode, bool *isSystemOff);
 
     /**
-     * @brief Parses a data string and executes corresponding commands
-     * @param data String to parse
-     * @return true if the string was successfully parsed
+     * @brief Parses a command and executes it; neither step allocates from the heap
+     * @param data Command text, not necessarily NUL-terminated
+     * @param length Length of the command text
+     * @param reply Appended with the JSON reply; echoes the request "id" when present. A reply
+     *              that does not fit keeps its status and drops the payload for "truncated":1.
+     * @return true if the command was successfully parsed and executed
      */
-    bool parse(const String &data);
+    bool parse(const char *data, size_t length, ResponseWriter &reply);
 }
@@ -0,0 +1,96 @@
+#include <string.h>
+#include "ResponseWriter.h"
+
+ResponseWriter::ResponseWriter(char *buffer, const size_t capacity)
+    : _buffer(buffer),
+      _capacity(capacity),
+      _length(0),
+      _overflow(false) {
+    _buffer[0] = '\0';
+}
+
+ResponseWriter &ResponseWriter::add(const char *text) {
+    return add(text, strlen(text));
+}
+
+ResponseWriter &ResponseWriter::add(const char *text, size_t length) {
+    if (length > remaining()) {
+        length = remaining();
+        _overflow = true;
+    }
+    memcpy(_buffer + _length, text, length);
+    _length += length;
+    _buffer[_length] = '\0';
+    return *this;
+}
+
+ResponseWriter &ResponseWriter::add(const char c) {
+    return add(&c, 1);
+}
+
+ResponseWriter &ResponseWriter::addUnsigned(uint32_t value) {
+    // Digits are produced backwards into the end of a scratch buffer
+    char digits[10];
+    size_t start = sizeof(digits);
+    do {
+        digits[--start] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    return add(digits + start, sizeof(digits) - start);
+}
+
+ResponseWriter &ResponseWriter::addUnsigned64(uint64_t value) {
+    if (value <= UINT32_MAX) return addUnsigned(value);
+    char digits[20];
+    size_t start = sizeof(digits);
+    do {
+        digits[--start] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    return add(digits + start, sizeof(digits) - start);
+}
+
+ResponseWriter &ResponseWriter::addInt(const int32_t value) {
+    if (value >= 0) return addUnsigned(value);
+    add('-');
+    return addUnsigned(0u - static_cast<uint32_t>(value));
+}
+
+ResponseWriter &ResponseWriter::addIp(const uint32_t address) {
+    for (int octet = 0; octet < 4; octet++) {
+        if (octet > 0) add('.');
+        addUnsigned((address >> (octet * 8)) & 0xFF);
+    }
+    return *this;
+}
+
+ResponseWriter &ResponseWriter::addQuoted(const char *text) {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    add('"');
+    for (const char *p = text; *p; p++) {
+        const uint8_t c = static_cast<uint8_t>(*p);
+        if (c == '"' || c == '\\') {
+            add('\\');
+            add(*p);
+        } else if (c < 0x20) {
+            const char escaped[] = {'\\', 'u', '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0x0F]};
+            add(escaped, sizeof(escaped));
+        } else {
+            add(*p);
+        }
+    }
+    return add('"');
+}
+
+void ResponseWriter::overwrite(const size_t offset, const char *text) {
+    const size_t length = strlen(text);
+    if (offset + length <= _length) memcpy(_buffer + offset, text, length);
+}
+
+void ResponseWriter::truncate(const size_t length) {
+    if (length < _length) {
+        _length = length;
+        _buffer[_length] = '\0';
+    }
+    _overflow = false;
+}
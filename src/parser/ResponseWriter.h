@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Builds a reply in a fixed buffer owned by the caller
+ *
+ * Text is appended from constant fragments and integers formatted in place, so building a
+ * reply never touches the heap. An append that does not fit is cut off and marks the writer
+ * as overflowed; the buffer always stays NUL-terminated.
+ */
+class ResponseWriter {
+public:
+    /**
+     * @param buffer Storage for the reply
+     * @param capacity Size of the storage including the terminating NUL
+     */
+    ResponseWriter(char *buffer, size_t capacity);
+
+    /**
+     * @brief Appends a NUL-terminated fragment as is
+     */
+    ResponseWriter &add(const char *text);
+
+    /**
+     * @brief Appends `length` bytes as is
+     */
+    ResponseWriter &add(const char *text, size_t length);
+
+    /**
+     * @brief Appends one character
+     */
+    ResponseWriter &add(char c);
+
+    /**
+     * @brief Appends an unsigned number in decimal
+     */
+    ResponseWriter &addUnsigned(uint32_t value);
+
+    /**
+     * @brief Appends a 64-bit unsigned number in decimal
+     */
+    ResponseWriter &addUnsigned64(uint64_t value);
+
+    /**
+     * @brief Appends a signed number in decimal
+     */
+    ResponseWriter &addInt(int32_t value);
+
+    /**
+     * @brief Appends an IPv4 address in dotted notation
+     * @param address Address as stored by lwIP: the first octet in the low byte
+     */
+    ResponseWriter &addIp(uint32_t address);
+
+    /**
+     * @brief Appends text as a JSON string: quoted, with quotes, backslashes and control
+     *        characters escaped
+     */
+    ResponseWriter &addQuoted(const char *text);
+
+    /**
+     * @brief Replaces bytes already written, e.g. a placeholder whose value is known only later
+     * @param offset Position of the first byte to replace
+     * @param text Replacement; must not extend past the current length
+     */
+    void overwrite(size_t offset, const char *text);
+
+    /**
+     * @brief Drops everything after `length` bytes and clears the overflow flag
+     */
+    void truncate(size_t length);
+
+    /**
+     * @brief Empties the writer
+     */
+    void clear() { truncate(0); }
+
+    const char *c_str() const { return _buffer; }
+    size_t length() const { return _length; }
+
+    /**
+     * @brief Bytes that can still be appended
+     */
+    size_t remaining() const { return _capacity - 1 - _length; }
+
+    /**
+     * @brief Whether an append since the last truncate() did not fit
+     */
+    bool overflowed() const { return _overflow; }
+
+private:
+    char *_buffer;
+    size_t _capacity;
+    size_t _length;
+    bool _overflow;
+};
@@ -0,0 +1,125 @@
+#include <Arduino.h>
+#include "Presets.h"
+#include "../settings/Settings.h"
+
+#define KEY_PRESETS "presets"
+
+namespace Presets {
+    static const char *TAG = "PRESETS";
+
+    /**
+     * Stored layout: entry size followed by MAX_PRESETS entries. Keeping the entry size lets a
+     * table written with a shorter Preset struct be read back after fields are appended.
+     */
+    struct __attribute__((packed)) StoredPreset {
+        uint8_t used;
+        uint8_t mode;
+        uint8_t brightness;
+        char name[NAME_LENGTH];
+        uint8_t params[Effects::NUM_PARAMS];
+        uint8_t hasLayout;
+        Layout::Config layout;
+    };
+
+    struct __attribute__((packed)) StoredTable {
+        uint8_t entrySize;
+        StoredPreset entries[MAX_PRESETS];
+    };
+
+    static Preset table[MAX_PRESETS] = {};
+
+    static bool persist() {
+        StoredTable stored = {};
+        stored.entrySize = sizeof(StoredPreset);
+        for (int i = 0; i < MAX_PRESETS; i++) {
+            stored.entries[i].used = table[i].used;
+            stored.entries[i].mode = table[i].mode;
+            stored.entries[i].brightness = table[i].brightness;
+            memcpy(stored.entries[i].name, table[i].name, NAME_LENGTH);
+            memcpy(stored.entries[i].params, table[i].params.value, Effects::NUM_PARAMS);
+            stored.entries[i].hasLayout = table[i].hasLayout;
+            stored.entries[i].layout = table[i].layout;
+        }
+        return Settings::saveRecord(KEY_PRESETS, &stored, sizeof(stored));
+    }
+
+    /**
+     * Whether stored values are usable as parameters of the mode.
+     */
+    static bool paramsValid(Effects::Mode mode, const uint8_t *values) {
+        for (int i = 0; i < Effects::NUM_PARAMS; i++) {
+            const Effects::ParamSpec &spec = Effects::getParamSpec(mode, static_cast<Effects::Param>(i));
+            if (spec.used && (values[i] < spec.min || values[i] > spec.max)) return false;
+        }
+        return true;
+    }
+
+    void init() {
+        uint8_t raw[sizeof(StoredTable)] = {};
+        if (!Settings::loadRecord(KEY_PRESETS, raw, sizeof(raw))) {
+            ESP_LOGI(TAG, "No stored presets");
+            return;
+        }
+
+        const size_t entrySize = raw[0];
+        if (entrySize == 0) return;
+        int loaded = 0;
+        for (int i = 0; i < MAX_PRESETS; i++) {
+            const size_t offset = 1 + i * entrySize;
+            if (offset + entrySize > sizeof(raw)) break;
+            StoredPreset entry = {};
+            memcpy(&entry, raw + offset, entrySize < sizeof(entry) ? entrySize : sizeof(entry));
+            if (!entry.used || entry.mode >= Effects::NUM_MODES) continue;
+
+            table[i].used = true;
+            table[i].mode = entry.mode;
+            table[i].brightness = entry.brightness;
+            memcpy(table[i].name, entry.name, NAME_LENGTH);
+            table[i].name[NAME_LENGTH - 1] = '\0';
+            // Entries written before parameters were appended leave them at the mode's current values
+            const auto mode = static_cast<Effects::Mode>(entry.mode);
+            table[i].hasParams = entrySize >= offsetof(StoredPreset, params) + sizeof(entry.params)
+                                 && paramsValid(mode, entry.params);
+            if (table[i].hasParams) memcpy(table[i].params.value, entry.params, Effects::NUM_PARAMS);
+            // Zero-filled when the entry predates layouts
+            table[i].hasLayout = entry.hasLayout;
+            table[i].layout = entry.layout;
+            loaded++;
+        }
+        ESP_LOGI(TAG, "Loaded %d presets", loaded);
+    }
+
+    bool save(int slot, const char *name, Effects::Mode mode, int brightness, const Effects::Params &params,
+              const Layout::Config *layout) {
+        if (slot < 0 || slot >= MAX_PRESETS) return false;
+
+        Preset &preset = table[slot];
+        preset.used = true;
+        preset.mode = mode;
+        preset.brightness = constrain(brightness, 0, 255);
+        preset.hasParams = true;
+        preset.params = params;
+        preset.hasLayout = layout != nullptr;
+        preset.layout = layout ? *layout : Layout::Config{};
+        memset(preset.name, 0, NAME_LENGTH);
+        // Names are echoed in JSON replies, so keep them to plain printable characters
+        for (size_t i = 0; name && name[i] && i < NAME_LENGTH - 1; i++) {
+            const char c = name[i];
+            preset.name[i] = (c < 0x20 || c == '"' || c == '\\') ? '_' : c;
+        }
+        ESP_LOGI(TAG, "Preset %d saved: mode=%d, brightness=%d", slot, preset.mode, preset.brightness);
+        return persist();
+    }
+
+    bool remove(int slot) {
+        if (slot < 0 || slot >= MAX_PRESETS) return false;
+        table[slot] = {};
+        ESP_LOGI(TAG, "Preset %d removed", slot);
+        return persist();
+    }
+
+    const Preset *get(int slot) {
+        if (slot < 0 || slot >= MAX_PRESETS || !table[slot].used) return nullptr;
+        return &table[slot];
+    }
+}
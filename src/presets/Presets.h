@@ -0,0 +1,62 @@
+#pragma once
+
+#include "../effects/Effects.h"
+#include "../layout/Layout.h"
+
+/**
+ * @brief Fixed-capacity table of named scenes (mode, brightness, effect parameters and
+ *        optionally a layout)
+ *
+ * The table is read from NVS once at boot and kept in RAM, so recalling a preset
+ * never touches flash. Saving or deleting a preset rewrites the whole table as one record.
+ */
+namespace Presets {
+    constexpr int MAX_PRESETS = 8;
+    constexpr size_t NAME_LENGTH = 16;
+
+    /**
+     * @brief One stored scene
+     */
+    struct Preset {
+        bool used;
+        uint8_t mode;
+        uint8_t brightness;
+        char name[NAME_LENGTH];
+        bool hasParams;          ///< false for presets saved before parameters were stored
+        Effects::Params params;  ///< Parameters of the mode
+        bool hasLayout;          ///< The scene also switches the layout
+        Layout::Config layout;
+    };
+
+    /**
+     * @brief Loads the preset table from persistent storage
+     */
+    void init();
+
+    /**
+     * @brief Stores a scene in a slot and persists the table
+     * @param slot Slot index (0..MAX_PRESETS-1)
+     * @param name Display name, truncated to NAME_LENGTH-1 characters
+     * @param mode Effect mode
+     * @param brightness Brightness (0–255)
+     * @param params Parameters of the mode
+     * @param layout Layout to switch to with the scene, or nullptr to leave the layout alone
+     * @return true if the slot index was valid and the table was written
+     */
+    bool save(int slot, const char *name, Effects::Mode mode, int brightness, const Effects::Params &params,
+              const Layout::Config *layout);
+
+    /**
+     * @brief Clears a slot and persists the table
+     * @param slot Slot index
+     * @return true if the slot index was valid and the table was written
+     */
+    bool remove(int slot);
+
+    /**
+     * @brief Returns a stored preset
+     * @param slot Slot index
+     * @return Pointer to the preset, or nullptr if the slot is invalid or empty
+     */
+    const Preset *get(int slot);
+}
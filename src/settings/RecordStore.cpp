@@ -0,0 +1,61 @@
+#include <string.h>
+#include "RecordStore.h"
+#ifdef ESP_PLATFORM
+#include <esp_rom_crc.h>
+#endif
+
+RecordStore::RecordStore(BlobStorage &storage)
+    : _storage(storage),
+      _commits(0),
+      _bytesWritten(0) {
+}
+
+RecordStore::Result RecordStore::load(const char *key, void *data, size_t size) {
+    const size_t stored = _storage.length(key);
+    if (stored < sizeof(Header)) return MISSING;
+
+    uint8_t buffer[sizeof(Header) + MAX_PAYLOAD];
+    if (stored > sizeof(buffer)) return BAD_HEADER;
+    if (_storage.read(key, buffer, stored) != stored) return MISSING;
+
+    Header header;
+    memcpy(&header, buffer, sizeof(header));
+    const uint8_t *payload = buffer + sizeof(header);
+    if (header.magic != MAGIC || header.version != VERSION || header.length != stored - sizeof(header)) {
+        return BAD_HEADER;
+    }
+    if (crc32(payload, header.length) != header.crc) return BAD_CRC;
+
+    memcpy(data, payload, header.length < size ? header.length : size);
+    return OK;
+}
+
+bool RecordStore::save(const char *key, const void *data, size_t size) {
+    if (size > MAX_PAYLOAD) return false;
+
+    uint8_t buffer[sizeof(Header) + MAX_PAYLOAD];
+    Header header = {MAGIC, VERSION, 0, static_cast<uint16_t>(size), crc32(data, size)};
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), data, size);
+
+    const size_t written = _storage.write(key, buffer, sizeof(header) + size);
+    if (written == 0) return false;
+    _commits++;
+    _bytesWritten += written;
+    return true;
+}
+
+uint32_t RecordStore::crc32(const void *data, size_t size) {
+#ifdef ESP_PLATFORM
+    return esp_rom_crc32_le(0, static_cast<const uint8_t *>(data), size);
+#else
+    // Bitwise reflected CRC-32 (polynomial 0xEDB88320), as the ROM routine computes it
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+#endif
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Key/value blob storage underneath RecordStore (NVS on the device)
+ */
+class BlobStorage {
+public:
+    virtual ~BlobStorage() = default;
+
+    /**
+     * @return Size of the blob stored under key, 0 if there is none
+     */
+    virtual size_t length(const char *key) = 0;
+
+    /**
+     * @return Number of bytes read
+     */
+    virtual size_t read(const char *key, void *data, size_t size) = 0;
+
+    /**
+     * @return Number of bytes written, 0 on failure
+     */
+    virtual size_t write(const char *key, const void *data, size_t size) = 0;
+};
+
+/**
+ * @brief Versioned, CRC-checked records on top of a BlobStorage
+ *
+ * Every record is a small header (magic, version, payload length, CRC32) followed by the
+ * payload. The payload length is kept so that records written by older firmware (shorter
+ * payload) still load, with new trailing fields left at their defaults. Has no hardware
+ * dependencies and can be run against an in-memory storage.
+ */
+class RecordStore {
+public:
+    static constexpr uint16_t MAGIC = 0x4C58; // "LX"
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t MAX_PAYLOAD = 512;
+
+    /**
+     * @brief Header stored in front of every record
+     */
+    struct __attribute__((packed)) Header {
+        uint16_t magic;
+        uint8_t version;
+        uint8_t reserved;
+        uint16_t length;
+        uint32_t crc;
+    };
+
+    /**
+     * @brief Outcome of load()
+     */
+    enum Result {
+        OK,         ///< Record loaded
+        MISSING,    ///< Nothing (usable) stored under the key
+        BAD_HEADER, ///< Foreign or truncated blob
+        BAD_CRC     ///< Payload does not match its checksum
+    };
+
+    explicit RecordStore(BlobStorage &storage);
+
+    /**
+     * @brief Loads a record; a stored payload shorter than size fills only the leading bytes
+     * @param key Storage key
+     * @param data Output buffer, left untouched unless the result is OK
+     * @param size Size of the output buffer
+     */
+    Result load(const char *key, void *data, size_t size);
+
+    /**
+     * @brief Writes data as one record
+     * @param key Storage key
+     * @param data Payload to store
+     * @param size Payload size, at most MAX_PAYLOAD
+     * @return true if the record was written
+     */
+    bool save(const char *key, const void *data, size_t size);
+
+    /**
+     * @brief Returns the number of records written
+     */
+    uint32_t commits() const { return _commits; }
+
+    /**
+     * @brief Returns the number of bytes written, headers included
+     */
+    uint32_t bytesWritten() const { return _bytesWritten; }
+
+    /**
+     * @brief CRC32 of the payload as stored in the header (same as esp_rom_crc32_le(0, ...))
+     */
+    static uint32_t crc32(const void *data, size_t size);
+
+private:
+    BlobStorage &_storage;
+    uint32_t _commits;
+    uint32_t _bytesWritten;
+};
@@ -1,5 +1,10 @@
 #include <Preferences.h>
 #include "Settings.h"
+#include "RecordStore.h"
+#include "WriteBehind.h"
+#include "../effects/Effects.h"
+#include "../events/AppEvents.h"
+#include "../event_log/EventLog.h"
 
 #define PREF_NAME "wifi-settings"
 #define KEY_SSID "ssid"
@@ -8,6 +13,7 @@
 #define KEY_PASS_DEF ""
 
 #define PREF_LIGHT "light-settings"
+#define KEY_STATE "state"
 #define KEY_MODE "mode"
 #define KEY_MODE_DEF 0
 #define KEY_OFF "systemOff"
@@ -16,105 +22,265 @@
 #define KEY_BRIGHTNESS_DEF 51
 #define KEY_NUM_LEDS "numLeds"
 #define KEY_NUM_LEDS_DEF 60
+#define KEY_PALETTE_DEF -1
+#define KEY_DITHER_DEF 1
+#define KEY_GROUPS_DEF 0
+#define KEY_CHIPSET_DEF 0     // WS2812B
+#define KEY_COLOR_ORDER_DEF 2 // GRB
+#define KEY_WHITE_DEF 0
 
 #define DEBOUNCE_MS 5000
 
 namespace Settings {
     static const char *TAG = "SETTINGS";
 
-    static Preferences preferences;
-    static int cachedMode = KEY_MODE_DEF;
-    static int cachedBrightness = KEY_BRIGHTNESS_DEF;
-    static bool modeDirty = false;
-    static unsigned long lastModeChange = 0;
-    static unsigned long brightnessChange = 0;
+    /**
+     * Device state persisted as a single NVS blob. Append new fields at the end only.
+     */
+    struct __attribute__((packed)) LightState {
+        uint8_t mode;
+        uint8_t brightness;
+        uint8_t systemOff;
+        uint8_t reserved;
+        uint16_t numLeds;
+        uint32_t commitCount;  // Lifetime number of record commits
+        uint32_t bytesWritten; // Lifetime number of bytes committed to NVS
+        uint8_t bleRelease;    // Release BLE memory once WiFi is provisioned
+        int8_t palette;        // Selected user palette, -1 for built-in colors
+        uint8_t paramsStored;  // Set once effect parameters have been saved
+        uint8_t effectParams[Effects::PARAMS_STORAGE_SIZE];
+        uint8_t dither;        // Temporal dithering in the output stage
+        uint32_t groups;       // Multicast groups the device belongs to, one bit per group
+        uint8_t chipset;       // LED driver chip, applied at boot
+        uint8_t colorOrder;    // Order the strip expects the color channels in
+        uint8_t white;         // Strip has a fourth, white channel
+    };
 
-    void saveLightModeNow() {
-        preferences.begin(PREF_LIGHT, false);
-        preferences.putInt(KEY_MODE, cachedMode);
-        preferences.end();
-        modeDirty = false;
-        lastModeChange = 0;
-        ESP_LOGI(TAG, "Light mode %d saved to NVS", cachedMode);
+    static_assert(sizeof(LightState) <= RecordStore::MAX_PAYLOAD, "LightState does not fit into a record");
+
+    static Preferences lightPrefs;
+    static bool lightPrefsOpen = false;
+    static LightState state = {KEY_MODE_DEF, KEY_BRIGHTNESS_DEF, KEY_OFF_DEF, 0, KEY_NUM_LEDS_DEF, 0, 0, 0, KEY_PALETTE_DEF, 0, {}, KEY_DITHER_DEF, KEY_GROUPS_DEF,
+                                KEY_CHIPSET_DEF, KEY_COLOR_ORDER_DEF, KEY_WHITE_DEF};
+    static WriteBehind pending(DEBOUNCE_MS);
+
+    static bool openLightPrefs() {
+        if (!lightPrefsOpen) {
+            lightPrefsOpen = lightPrefs.begin(PREF_LIGHT, false);
+            if (!lightPrefsOpen) ESP_LOGE(TAG, "Failed to open NVS namespace %s", PREF_LIGHT);
+        }
+        return lightPrefsOpen;
     }
 
-    void saveBrightnessNow() {
-        preferences.begin(PREF_LIGHT, false);
-        preferences.putInt(KEY_BRIGHTNESS, cachedBrightness);
-        preferences.end();
-        modeDirty = false;
-        lastModeChange = 0;
-        ESP_LOGI(TAG, "Brightness %d saved to NVS", cachedBrightness);
+    /**
+     * The light-settings NVS namespace, opened on first use and kept open.
+     */
+    class NvsStorage : public BlobStorage {
+    public:
+        size_t length(const char *key) override {
+            return openLightPrefs() ? lightPrefs.getBytesLength(key) : 0;
+        }
+
+        size_t read(const char *key, void *data, size_t size) override {
+            return openLightPrefs() ? lightPrefs.getBytes(key, data, size) : 0;
+        }
+
+        size_t write(const char *key, const void *data, size_t size) override {
+            return openLightPrefs() ? lightPrefs.putBytes(key, data, size) : 0;
+        }
+    };
+
+    static NvsStorage nvs;
+    static RecordStore records(nvs);
+
+    bool loadRecord(const char *key, void *data, size_t size) {
+        switch (records.load(key, data, size)) {
+            case RecordStore::OK: return true;
+            case RecordStore::BAD_HEADER: ESP_LOGW(TAG, "Record %s has invalid header", key); break;
+            case RecordStore::BAD_CRC: ESP_LOGW(TAG, "Record %s failed CRC check", key); break;
+            case RecordStore::MISSING: break;
+        }
+        return false;
     }
 
-    bool getWiFiCredentials(String &ssid, String &password) {
+    bool saveRecord(const char *key, const void *data, size_t size) {
+        if (!records.save(key, data, size)) {
+            ESP_LOGE(TAG, "Failed to write record %s", key);
+            return false;
+        }
+        return true;
+    }
+
+    static void commitLightState() {
+        state.commitCount++;
+        state.bytesWritten += sizeof(RecordStore::Header) + sizeof(LightState);
+        if (saveRecord(KEY_STATE, &state, sizeof(state))) {
+            EventLog::log(EventLog::STATE_COMMITTED, state.mode, state.brightness, state.numLeds);
+        }
+        pending.clear();
+    }
+
+    static void markDirty() {
+        pending.markDirty(millis());
+    }
+
+    bool getWiFiCredentials(char *ssid, char *password) {
+        Preferences preferences;
         preferences.begin(PREF_NAME, true);
-        ssid = preferences.getString(KEY_SSID, KEY_SSID_DEF);
-        password = preferences.getString(KEY_PASS, KEY_PASS_DEF);
+        strlcpy(ssid, KEY_SSID_DEF, SSID_SIZE);
+        strlcpy(password, KEY_PASS_DEF, PASSWORD_SIZE);
+        preferences.getString(KEY_SSID, ssid, SSID_SIZE);
+        preferences.getString(KEY_PASS, password, PASSWORD_SIZE);
         preferences.end();
-        ESP_LOGI(TAG,
-            "Get network credentials - SSID: %s, PASSWORD: %s",
-            ssid.c_str(),
-            password.c_str());
-        return !ssid.isEmpty();
+        ESP_LOGI(TAG, "Network credentials loaded - SSID: %s", ssid);
+        return ssid[0] != '\0';
     }
 
-    void setWiFiCredentials(const String &ssid, const String &password) {
+    void setWiFiCredentials(const char *ssid, const char *password) {
+        Preferences preferences;
         preferences.begin(PREF_NAME, false);
         preferences.putString(KEY_SSID, ssid);
         preferences.putString(KEY_PASS, password);
         preferences.end();
-        ESP_LOGI(TAG,
-            "Network credentials have been saved - SSID: %s, PASSWORD: %s",
-            ssid.c_str(),
-            password.c_str());
+        EventLog::log(EventLog::SAVE_WIFI, strlen(ssid));
     }
 
     void saveLightMode(const int mode) {
-        cachedMode = mode;
-        modeDirty = true;
-        lastModeChange = millis();
-        ESP_LOGD(TAG, "saveLightMode: mode=%d", mode);
+        state.mode = mode;
+        markDirty();
+        EventLog::log(EventLog::SAVE_MODE, mode);
     }
 
     void saveSystemState(const bool isOff) {
-        preferences.begin(PREF_LIGHT, false);
-        preferences.putBool(KEY_OFF, isOff);
-        preferences.end();
-        ESP_LOGD(TAG, "saveSystemState: isOff=%d", isOff);
+        state.systemOff = isOff;
+        markDirty();
+        EventLog::log(EventLog::SAVE_POWER, isOff);
 
-        if (isOff && modeDirty) {
-            saveLightModeNow();
-            saveBrightnessNow();
-        }
+        // Power may be cut right after switching off, so do not wait for the quiet period
+        if (isOff) flush();
     }
 
     void saveBrightness(const int brightness) {
-        brightnessChange = brightness;
-        modeDirty = true;
-        lastModeChange = millis();
-        ESP_LOGD(TAG, "saveBrightness: brightness=%d", brightness);
+        state.brightness = brightness;
+        markDirty();
+        EventLog::log(EventLog::SAVE_BRIGHTNESS, brightness);
     }
+
     void saveNumLeds(const int numLeds) {
-        preferences.begin(PREF_LIGHT, false);
-        preferences.putInt(KEY_NUM_LEDS, numLeds);
-        preferences.end();
-        ESP_LOGD(TAG, "saveNumLeds: numLeds=%d", numLeds);
+        state.numLeds = numLeds;
+        markDirty();
+        EventLog::log(EventLog::SAVE_LED_COUNT, numLeds);
+    }
+
+    void saveBleRelease(const bool enabled) {
+        state.bleRelease = enabled;
+        markDirty();
+        EventLog::log(EventLog::SAVE_BLE_RELEASE, enabled);
+    }
+
+    bool isBleReleaseEnabled() {
+        return state.bleRelease;
+    }
+
+    void savePalette(const int slot) {
+        state.palette = slot;
+        markDirty();
+        EventLog::log(EventLog::SAVE_PALETTE, slot);
+    }
+
+    int getPalette() {
+        return state.palette;
     }
+
+    void saveEffectParams(const uint8_t *values, size_t size) {
+        if (size > sizeof(state.effectParams)) size = sizeof(state.effectParams);
+        memcpy(state.effectParams, values, size);
+        state.paramsStored = 1;
+        markDirty();
+        EventLog::log(EventLog::SAVE_PARAMS, size);
+    }
+
+    const uint8_t *getEffectParams() {
+        return state.paramsStored ? state.effectParams : nullptr;
+    }
+
+    void saveDither(const bool enabled) {
+        state.dither = enabled;
+        markDirty();
+        EventLog::log(EventLog::SAVE_DITHER, enabled);
+    }
+
+    bool isDitherEnabled() {
+        return state.dither;
+    }
+
+    void saveGroups(const uint32_t mask) {
+        state.groups = mask;
+        markDirty();
+        EventLog::log(EventLog::SAVE_GROUPS, mask);
+    }
+
+    uint32_t getGroups() {
+        return state.groups;
+    }
+
+    void saveStrip(const uint8_t chipset, const uint8_t colorOrder, const bool white) {
+        state.chipset = chipset;
+        state.colorOrder = colorOrder;
+        state.white = white;
+        markDirty();
+        EventLog::log(EventLog::SAVE_STRIP, chipset, colorOrder, white);
+    }
+
+    uint8_t getChipset() {
+        return state.chipset;
+    }
+
+    uint8_t getColorOrder() {
+        return state.colorOrder;
+    }
+
+    bool hasWhiteChannel() {
+        return state.white;
+    }
+
     void loadLightSettings(int &mode, bool &isOff, int &brightness, int &numLeds) {
-        preferences.begin(PREF_LIGHT, true);
-        mode = preferences.getInt(KEY_MODE, KEY_MODE_DEF);
-        isOff = preferences.getBool(KEY_OFF, KEY_OFF_DEF);
-        brightness = preferences.getInt(KEY_BRIGHTNESS, KEY_BRIGHTNESS_DEF);
-        numLeds = preferences.getInt(KEY_NUM_LEDS, KEY_NUM_LEDS_DEF);
-        preferences.end();
+        if (!loadRecord(KEY_STATE, &state, sizeof(state)) && openLightPrefs()) {
+            // No packed record yet: migrate from the per-key layout of older firmware
+            state.mode = lightPrefs.getInt(KEY_MODE, KEY_MODE_DEF);
+            state.systemOff = lightPrefs.getBool(KEY_OFF, KEY_OFF_DEF);
+            state.brightness = lightPrefs.getInt(KEY_BRIGHTNESS, KEY_BRIGHTNESS_DEF);
+            state.numLeds = lightPrefs.getInt(KEY_NUM_LEDS, KEY_NUM_LEDS_DEF);
+        }
+        mode = state.mode;
+        isOff = state.systemOff;
+        brightness = state.brightness;
+        numLeds = state.numLeds;
         ESP_LOGI(TAG, "loadLightSettings: mode=%d, isOff=%d, brightness=%d, numLeds=%d", mode, isOff, brightness, numLeds);
     }
 
     void handleSettingsSync() {
-        if (modeDirty && (millis() - lastModeChange >= DEBOUNCE_MS)) {
-            saveLightModeNow();
-            saveBrightnessNow();
+        if (pending.isDue(millis())) {
+            commitLightState();
+        }
+    }
+
+    uint32_t msUntilSync() {
+        const uint32_t wait = pending.msUntilDue(millis());
+        return wait == WriteBehind::NO_DEADLINE ? AppEvents::NO_DEADLINE : wait;
+    }
+
+    void flush() {
+        if (pending.isDirty()) {
+            commitLightState();
         }
     }
+
+    Stats getStats() {
+        return {records.commits(), records.bytesWritten()};
+    }
+
+    Stats getLifetimeStats() {
+        return {state.commitCount, state.bytesWritten};
+    }
 }
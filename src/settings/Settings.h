@@ -2,22 +2,37 @@
 
 /**
  * @brief Management of persistent device settings
+ *
+ * Light settings are kept in RAM and written behind as one packed, CRC-checked NVS record
+ * once they have been quiet for a while, so bursts of changes cost a single flash write.
  */
 namespace Settings {
+    /**
+     * @brief NVS write counters used to track flash wear
+     */
+    struct Stats {
+        uint32_t commits;      ///< Number of records committed to NVS
+        uint32_t bytesWritten; ///< Number of bytes committed to NVS
+    };
+
+    /// Buffer sizes of Wi-Fi credentials, including the terminator: 32-byte SSID, 64-character key
+    constexpr size_t SSID_SIZE = 33;
+    constexpr size_t PASSWORD_SIZE = 65;
+
     /**
      * @brief Loads Wi-Fi credentials from persistent storage
-     * @param ssid Output string for SSID
-     * @param password Output string for password
+     * @param ssid Output buffer of SSID_SIZE bytes
+     * @param password Output buffer of PASSWORD_SIZE bytes
      * @return true if credentials were successfully loaded
      */
-    bool getWiFiCredentials(String &ssid, String &password);
+    bool getWiFiCredentials(char *ssid, char *password);
 
     /**
      * @brief Saves Wi-Fi credentials to persistent storage
      * @param ssid SSID to save
      * @param password Password to save
      */
-    void setWiFiCredentials(const String &ssid, const String &password);
+    void setWiFiCredentials(const char *ssid, const char *password);
 
     /**
      * @brief Saves the current lighting mode
@@ -26,7 +41,7 @@ namespace Settings {
     void saveLightMode(int mode);
 
     /**
-     * @brief Saves the device on/off state
+     * @brief Saves the device on/off state; switching off flushes pending changes immediately
      * @param isOff true if the device is turned off
      */
     void saveSystemState(bool isOff);
@@ -41,6 +56,93 @@ namespace Settings {
      * @param numLeds Number of LEDs
      */
     void saveNumLeds(int numLeds);
+    /**
+     * @brief Saves whether BLE memory is released once Wi-Fi is provisioned
+     * @param enabled true to release BLE memory after provisioning
+     */
+    void saveBleRelease(bool enabled);
+
+    /**
+     * @brief Checks whether BLE memory should be released once Wi-Fi is provisioned
+     * @return true if the provisioned mode is enabled
+     */
+    bool isBleReleaseEnabled();
+
+    /**
+     * @brief Saves the selected user palette
+     * @param slot Palette slot, or -1 for the built-in colors
+     */
+    void savePalette(int slot);
+
+    /**
+     * @brief Returns the selected user palette
+     * @return Palette slot, or -1 for the built-in colors
+     */
+    int getPalette();
+
+    /**
+     * @brief Saves the parameter values of all effects
+     * @param values Parameter block (see Effects::rawParams())
+     * @param size Size of the block in bytes
+     */
+    void saveEffectParams(const uint8_t *values, size_t size);
+
+    /**
+     * @brief Returns the saved parameter values of all effects
+     * @return Parameter block of Effects::PARAMS_STORAGE_SIZE bytes, or nullptr if never saved
+     */
+    const uint8_t *getEffectParams();
+
+    /**
+     * @brief Saves whether the output stage dithers dim levels over time
+     * @param enabled true to enable temporal dithering
+     */
+    void saveDither(bool enabled);
+
+    /**
+     * @brief Checks whether temporal dithering is enabled
+     * @return true if enabled (default)
+     */
+    bool isDitherEnabled();
+
+    /**
+     * @brief Saves the multicast groups the device belongs to
+     * @param mask One bit per group
+     */
+    void saveGroups(uint32_t mask);
+
+    /**
+     * @brief Returns the multicast groups the device belongs to
+     * @return One bit per group, 0 (no group) by default
+     */
+    uint32_t getGroups();
+
+    /**
+     * @brief Saves how the LED strip is wired
+     * @param chipset Switcher::Chipset; takes effect after a reboot
+     * @param colorOrder Switcher::ColorOrder
+     * @param white true for RGBW strips
+     */
+    void saveStrip(uint8_t chipset, uint8_t colorOrder, bool white);
+
+    /**
+     * @brief Returns the saved LED chipset
+     * @return Switcher::Chipset, WS2812B by default
+     */
+    uint8_t getChipset();
+
+    /**
+     * @brief Returns the saved color order
+     * @return Switcher::ColorOrder, GRB by default
+     */
+    uint8_t getColorOrder();
+
+    /**
+     * @brief Checks whether the strip has a white channel
+     * @return true for RGBW strips, false by default
+     */
+    bool hasWhiteChannel();
+
     /**
      * @brief Loads lighting settings from persistent storage
      * @param mode Output for light mode ID
@@ -51,7 +153,49 @@ namespace Settings {
     void loadLightSettings(int &mode, bool &isOff, int &brightness, int &numLeds);
 
     /**
-     * @brief Handles settings synchronization (e.g., commit changes to storage)
+     * @brief Commits pending light settings once they have been unchanged for the debounce period
      */
     void handleSettingsSync();
+
+    /**
+     * @brief Returns how long until handleSettingsSync() has a commit to do
+     * @return Milliseconds until the pending commit, or AppEvents::NO_DEADLINE if nothing is dirty
+     */
+    uint32_t msUntilSync();
+
+    /**
+     * @brief Commits pending light settings immediately
+     */
+    void flush();
+
+    /**
+     * @brief Loads a packed record written by saveRecord()
+     *
+     * A stored payload shorter than size fills only the leading bytes of data,
+     * so structs may grow by appending fields.
+     * @param key NVS key of the record
+     * @param data Output buffer
+     * @param size Size of the output buffer
+     * @return true if a valid record was found and its CRC matched
+     */
+    bool loadRecord(const char *key, void *data, size_t size);
+
+    /**
+     * @brief Writes data as one versioned, CRC-checked NVS record
+     * @param key NVS key of the record
+     * @param data Payload to store
+     * @param size Payload size (at most 512 bytes)
+     * @return true if the record was written
+     */
+    bool saveRecord(const char *key, const void *data, size_t size);
+
+    /**
+     * @brief Returns NVS write counters since boot
+     */
+    Stats getStats();
+
+    /**
+     * @brief Returns NVS write counters over the device lifetime (persisted with the light state)
+     */
+    Stats getLifetimeStats();
 }
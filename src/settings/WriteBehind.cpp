@@ -0,0 +1,26 @@
+#include "WriteBehind.h"
+
+WriteBehind::WriteBehind(const uint32_t quietMs)
+    : _quietMs(quietMs),
+      _lastChange(0),
+      _dirty(false) {
+}
+
+void WriteBehind::markDirty(const uint32_t nowMs) {
+    _dirty = true;
+    _lastChange = nowMs;
+}
+
+void WriteBehind::clear() {
+    _dirty = false;
+}
+
+bool WriteBehind::isDue(const uint32_t nowMs) const {
+    return _dirty && nowMs - _lastChange >= _quietMs;
+}
+
+uint32_t WriteBehind::msUntilDue(const uint32_t nowMs) const {
+    if (!_dirty) return NO_DEADLINE;
+    const uint32_t elapsed = nowMs - _lastChange;
+    return elapsed >= _quietMs ? 0 : _quietMs - elapsed;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Quiet-period timer for write-behind persistence
+ *
+ * Changes only mark the state dirty; it is due for a commit once no change has been made for
+ * the quiet period, so a burst of changes costs one flash write.
+ */
+class WriteBehind {
+public:
+    static constexpr uint32_t NO_DEADLINE = UINT32_MAX;
+
+    /**
+     * @param quietMs Time without changes before a commit is due
+     */
+    explicit WriteBehind(uint32_t quietMs);
+
+    /**
+     * @brief Records a change and restarts the quiet period
+     */
+    void markDirty(uint32_t nowMs);
+
+    /**
+     * @brief Forgets pending changes (call once they are committed)
+     */
+    void clear();
+
+    bool isDirty() const { return _dirty; }
+
+    /**
+     * @brief Checks whether pending changes are due for a commit
+     */
+    bool isDue(uint32_t nowMs) const;
+
+    /**
+     * @brief Returns milliseconds until the commit is due, or NO_DEADLINE if nothing is pending
+     */
+    uint32_t msUntilDue(uint32_t nowMs) const;
+
+private:
+    uint32_t _quietMs;
+    uint32_t _lastChange;
+    bool _dirty;
+};
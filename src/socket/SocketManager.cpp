@@ -1,5 +1,7 @@
 #include <WiFi.h>
 #include "SocketManager.h"
+#include "../board/BoardTraits.h"
+#include "../event_log/EventLog.h"
 
 namespace SocketManager {
     static const char *TAG = "TCP_SOCKET";
@@ -8,9 +10,29 @@ namespace SocketManager {
     static WiFiClient currentClient;
     static unsigned long lastHeartbeatMillis = 0;
     static constexpr unsigned long HEARTBEAT_INTERVAL = 5000;
+    static constexpr size_t MAX_LINE_LENGTH = Board::TRAITS.commandBufferSize;
+    static constexpr size_t READ_CHUNK_SIZE = 128;
+    // Command lines executed per pass; the network task holds the state lock meanwhile
+    static constexpr size_t MAX_LINES_PER_PASS = 16;
     static bool socketRunning = false;
     static SocketMessageCallback messageCallback = nullptr;
 
+    // Partial command line carried over between handle() passes
+    static char lineBuffer[MAX_LINE_LENGTH];
+    static size_t lineLength = 0;
+    static bool lineOverflow = false;
+
+    // Received bytes not yet split into lines, left over when a pass hits MAX_LINES_PER_PASS
+    static uint8_t rxChunk[READ_CHUNK_SIZE];
+    static size_t rxLength = 0;
+    static size_t rxOffset = 0;
+
+    // Replies queued during a pass and sent with a single write. Room is kept for one full-size
+    // reply plus a batch of short ones from pipelined commands.
+    static constexpr size_t TX_BATCH_SIZE = 1024;
+    static char txBuffer[Board::TRAITS.replyBufferSize + TX_BATCH_SIZE];
+    static size_t txLength = 0;
+
     void init(uint16_t port) {
         if (server) delete server;
         server = new WiFiServer(port);
@@ -33,37 +55,101 @@ namespace SocketManager {
         ESP_LOGI(TAG, "TCP Server stopped");
     }
 
+    static void flushReplies() {
+        if (txLength == 0) return;
+        currentClient.write(reinterpret_cast<const uint8_t *>(txBuffer), txLength);
+        txLength = 0;
+    }
+
+    /**
+     * Returns a writer for the next reply line, flushing queued replies first if a full-size
+     * reply might not fit behind them.
+     */
+    static ResponseWriter beginReply() {
+        if (sizeof(txBuffer) - txLength < Board::TRAITS.replyBufferSize) flushReplies();
+        return ResponseWriter(txBuffer + txLength, Board::TRAITS.replyBufferSize);
+    }
+
+    /**
+     * Queues a reply from beginReply(); the newline takes the place of its terminating NUL.
+     */
+    static void endReply(const ResponseWriter &reply) {
+        txLength += reply.length();
+        txBuffer[txLength++] = '\n';
+    }
+
+    static void dispatchLine() {
+        if (lineOverflow) {
+            EventLog::log(EventLog::TCP_LINE_DROPPED, MAX_LINE_LENGTH);
+            ResponseWriter reply = beginReply();
+            reply.add("{\"status\":\"Failure\"}");
+            endReply(reply);
+            return;
+        }
+        if (lineLength == 0 || messageCallback == nullptr) return;
+
+        lineBuffer[lineLength] = '\0';
+        EventLog::log(EventLog::TCP_COMMAND, lineLength);
+        ResponseWriter reply = beginReply();
+        messageCallback(lineBuffer, lineLength, reply);
+        endReply(reply);
+    }
+
     void handle() {
         if (!socketRunning || !server) return;
 
         if (!currentClient || !currentClient.connected()) {
             currentClient = server->accept();
             if (currentClient) {
-                ESP_LOGI(TAG, "TCP Client connected");
+                currentClient.setNoDelay(true);
+                lineLength = 0;
+                lineOverflow = false;
+                txLength = 0;
+                rxLength = 0;
+                rxOffset = 0;
+                EventLog::log(EventLog::TCP_CLIENT, static_cast<uint32_t>(currentClient.remoteIP()));
             }
         }
 
         if (currentClient && currentClient.connected()) {
-            if (currentClient.available()) {
-                String data = currentClient.readStringUntil('\n');
-                data.trim();
-                ESP_LOGD(TAG, "TCP Received: %s", data.c_str());
-                if (messageCallback != nullptr) {
-                    if (messageCallback(data) == true) {
-                        String response = "{\"status\":\"Success\"}";
-                        currentClient.println(response);
+            // Handle pipelined commands in one pass, up to MAX_LINES_PER_PASS so a client
+            // streaming commands cannot hold the state lock indefinitely, then answer them
+            // with a single write. The rest stays buffered for the next pass.
+            size_t lines = 0;
+            while (lines < MAX_LINES_PER_PASS) {
+                if (rxOffset == rxLength) {
+                    if (currentClient.available() <= 0) break;
+                    const int len = currentClient.read(rxChunk, sizeof(rxChunk));
+                    if (len <= 0) break;
+                    rxLength = len;
+                    rxOffset = 0;
+                }
+                while (rxOffset < rxLength && lines < MAX_LINES_PER_PASS) {
+                    const char c = static_cast<char>(rxChunk[rxOffset++]);
+                    if (c == '\n') {
+                        dispatchLine();
+                        lineLength = 0;
+                        lineOverflow = false;
+                        lines++;
+                    } else if (c == '\r') {
+                        // Tolerate CRLF line endings
+                    } else if (lineLength < MAX_LINE_LENGTH - 1) {
+                        lineBuffer[lineLength++] = c;
                     } else {
-                        String response = "{\"status\":\"Failure\"}";
-                        currentClient.println(response);
+                        lineOverflow = true;
                     }
                 }
             }
 
             if (millis() - lastHeartbeatMillis > HEARTBEAT_INTERVAL) {
                 lastHeartbeatMillis = millis();
-                currentClient.println(lastHeartbeatMillis);
+                ResponseWriter heartbeat = beginReply();
+                heartbeat.add("{\"type\":\"heartbeat\",\"uptime\":").addUnsigned(lastHeartbeatMillis).add('}');
+                endReply(heartbeat);
                 ESP_LOGV(TAG, "TCP Heartbeat sent: %lu", lastHeartbeatMillis);
             }
+
+            flushReplies();
         }
     }
 }
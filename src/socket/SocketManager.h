@@ -1,5 +1,7 @@
 #pragma once
 
+#include "../parser/ResponseWriter.h"
+
 /**
  * @brief Default port for TCP socket communication
  */
@@ -7,10 +9,12 @@
 
 /**
  * @brief Callback type for receiving messages via TCP socket
- * @param message Received message string
+ * @param message Received command line, NUL-terminated
+ * @param length Length of the command line
+ * @param reply Output reply line to send back to the client
  * @return true if message was processed successfully
  */
-typedef bool (*SocketMessageCallback)(const String &message);
+typedef bool (*SocketMessageCallback)(const char *message, size_t length, ResponseWriter &reply);
 
 /**
  * @brief Management of TCP socket server for command processing
@@ -0,0 +1,12 @@
+#include "FrameBlend.h"
+
+namespace FrameBlend {
+    void blend(const uint8_t *from, const uint8_t *to, uint8_t *out, size_t bytes, uint8_t amount) {
+        for (size_t i = 0; i < bytes; i++) {
+            // a * 257 keeps amount 255 exactly on `to`
+            const uint16_t a = from[i];
+            const uint16_t b = to[i];
+            out[i] = ((a << 8 | b) + b * amount - a * amount) >> 8;
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Blending between keyframes of interpolated effects
+ *
+ * Works on plain RGB byte triples, so it runs on the host as well as on the strip buffers.
+ */
+namespace FrameBlend {
+    /**
+     * @brief Blend amount of an output frame between two keyframes
+     * @param phase Output frames since the previous keyframe, below `divisor`
+     * @param divisor Output frames per keyframe
+     */
+    inline uint8_t amount(uint8_t phase, uint8_t divisor) {
+        return phase * 256 / divisor;
+    }
+
+    /**
+     * @brief Linear blend of two frames, rounded like FastLED's blend8()
+     * @param from Frame shown at amount 0
+     * @param to Frame shown at amount 255
+     * @param out Result; may be `from` or `to`
+     * @param bytes Bytes per frame, 3 per LED
+     * @param amount Weight of `to`
+     */
+    void blend(const uint8_t *from, const uint8_t *to, uint8_t *out, size_t bytes, uint8_t amount);
+}
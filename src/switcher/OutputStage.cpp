@@ -0,0 +1,77 @@
+#include "OutputStage.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace OutputStage {
+    void buildGammaTable(uint16_t *table) {
+        for (int i = 0; i < 256; i++) {
+            table[i] = lroundf(powf(i / 255.0f, GAMMA) * LUT_MAX);
+        }
+    }
+
+    void buildLut(const uint16_t *gammaTable, int level, uint16_t *lut) {
+        for (int i = 0; i < 256; i++) {
+            lut[i] = static_cast<uint32_t>(gammaTable[i]) * level / 255;
+        }
+    }
+
+    void resetResidual(uint8_t *residual, size_t bytes) {
+        for (size_t i = 0; i < bytes; i++) {
+            residual[i] = i * 167;
+        }
+    }
+
+    template <bool DITHER>
+    static inline uint8_t quantize(uint16_t value, uint8_t &carry) {
+        if (DITHER) {
+            value += carry;
+            carry = value;
+            return value >> 8;
+        }
+        return (value + 0x80) >> 8;
+    }
+
+    /**
+     * For RGBW the white LED takes over the level common to all three channels (their minimum),
+     * taken after gamma and brightness so the mix matches what the RGB path shows. The loop body
+     * is branch-free; the variant is picked once per frame.
+     */
+    template <bool DITHER, bool WHITE>
+    static void convert(const uint8_t *in, int count, const uint16_t *lut, const uint8_t *channels, uint8_t *out,
+                        uint8_t *carry) {
+        const uint8_t c0 = channels[0];
+        const uint8_t c1 = channels[1];
+        const uint8_t c2 = channels[2];
+        for (int i = 0; i < count; i++, in += 3) {
+            uint16_t v0 = lut[in[c0]];
+            uint16_t v1 = lut[in[c1]];
+            uint16_t v2 = lut[in[c2]];
+            if (WHITE) {
+                const uint16_t w = std::min(v0, std::min(v1, v2));
+                v0 -= w;
+                v1 -= w;
+                v2 -= w;
+                out[3] = quantize<DITHER>(w, carry[3]);
+            }
+            out[0] = quantize<DITHER>(v0, carry[0]);
+            out[1] = quantize<DITHER>(v1, carry[1]);
+            out[2] = quantize<DITHER>(v2, carry[2]);
+            out += WHITE ? 4 : 3;
+            carry += WHITE ? 4 : 3;
+        }
+    }
+
+    void convert(const uint8_t *source, int count, const uint16_t *lut, const uint8_t *channels, uint8_t *wire,
+                 uint8_t *residual, bool dither, bool white) {
+        if (white) {
+            if (dither) convert<true, true>(source, count, lut, channels, wire, residual);
+            else convert<false, true>(source, count, lut, channels, wire, residual);
+            // Bytes padding the stream to whole RGB pixels run past the end of the strip
+            memset(wire + count * 4, 0, wirePixels(count, true) * 3 - count * 4);
+        } else {
+            if (dither) convert<true, false>(source, count, lut, channels, wire, residual);
+            else convert<false, false>(source, count, lut, channels, wire, residual);
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Gamma, brightness and temporal dithering pass between the effect buffer and the wire
+ *
+ * Works on plain RGB byte triples and the bytes clocked out, so it runs on the host as well as
+ * on the strip buffers.
+ */
+namespace OutputStage {
+    constexpr float GAMMA = 2.2f;
+    constexpr uint16_t LUT_MAX = 255 << 8; ///< Leaves room for the carried fraction
+
+    /**
+     * @brief Gamma curve in 8.8 fixed point, computed once
+     * @param table 256 entries
+     */
+    void buildGammaTable(uint16_t *table);
+
+    /**
+     * @brief Gamma curve scaled to a brightness level, the table convert() maps through
+     * @param level Brightness, 0-255
+     */
+    void buildLut(const uint16_t *gammaTable, int level, uint16_t *lut);
+
+    /**
+     * @brief Starts every channel at a different phase so equal dim pixels do not blink in step
+     */
+    void resetResidual(uint8_t *residual, size_t bytes);
+
+    /**
+     * @brief Pixels the controller sends for `count` LEDs; an RGBW pixel takes 4/3 of an RGB one
+     */
+    inline int wirePixels(int count, bool white) {
+        return white ? (count * 4 + 2) / 3 : count;
+    }
+
+    /**
+     * @brief One pass over the frame into the bytes as they are clocked out
+     * @param source RGB triples
+     * @param count LEDs
+     * @param lut Table from buildLut()
+     * @param channels Source channel (0 red, 1 green, 2 blue) of each wire byte
+     * @param wire wirePixels() * 3 bytes; for RGBW every LED takes four, padded with zeros
+     * @param residual Fractions carried to the next frame, 4 bytes per LED
+     * @param dither Carry the fractions instead of rounding them away
+     * @param white Extract the level common to the three channels into a fourth, white byte
+     */
+    void convert(const uint8_t *source, int count, const uint16_t *lut, const uint8_t *channels, uint8_t *wire,
+                 uint8_t *residual, bool dither, bool white);
+}
@@ -1,98 +1,457 @@
 #include "Switcher.h"
 #include <Arduino.h>
+#include <atomic>
 #include "../board/BoardSelector.h"
 #include "../effects/Effects.h"
+#include "../boot/BootProfiler.h"
+#include "../tasks/Tasks.h"
+#include "../layout/Layout.h"
+#include "FrameBlend.h"
+#include "OutputStage.h"
 
 namespace Switcher {
     static int volatile numLeds = 30;       // Number of LEDs (default)
     static int volatile brightness = 51;    // Brightness: 20% of 255 (default)
-    static CRGB leds[256];                  // Maximum buffer for LEDs
+    static CRGB leds[Board::TRAITS.maxLeds]; // Maximum buffer for LEDs
     static Effects::Mode volatile g_mode = Effects::RAINBOW;
     static bool volatile g_isSystemOff = false;
     static bool volatile g_settingsChanged = false;
-    static bool volatile g_numLedsChanged = false;
-    static bool g_useTask = false;
+    static bool volatile g_wireChanged = false;
+    // Parameters handed over by setScene(), applied by the render task with the scene snapshot
+    static Effects::Params g_sceneParams;
+    static bool volatile g_sceneParamsPending = false;
+    static bool volatile g_sceneLayoutPending = false;
+    static portMUX_TYPE g_stateLock = portMUX_INITIALIZER_UNLOCKED;
+    static TaskHandle_t g_taskHandle = nullptr;
+    static constexpr TickType_t FRAME_TICKS = pdMS_TO_TICKS(1000 / Board::TRAITS.defaultFps);
+    static TickType_t frameTicks = FRAME_TICKS; // Owned by the render task, see framePeriod()
+    static CLEDController *g_strip = nullptr;
+    static std::atomic<uint32_t> g_frameSequence{0};
 
-    void handle_internal() {
-        if (g_settingsChanged) {
-            FastLED.setBrightness(brightness);
-            if (g_numLedsChanged) {
-                FastLED[0].setLeds(leds, numLeds);
-                FastLED.clear();
-                g_numLedsChanged = false;
+    /*
+     * Output stage. Effects draw into `leds` (and read it back for fades); just before transmit
+     * one fused pass maps every channel through a gamma+brightness table into `wire`, which is
+     * what the controller sends. FastLED runs at full brightness with its own dithering off.
+     *
+     * Table entries are 8.8 fixed point. With dithering the fractional part is carried over to
+     * the next frame per channel, so a dim level between two output steps is shown as its
+     * time average instead of being rounded to a flat step.
+     *
+     * `wire` holds the bytes exactly as they are clocked out: the pass writes the channels in
+     * the strip's color order, and for RGBW strips a fourth, white byte per pixel. The
+     * controller is declared as RGB over those bytes, so FastLED sends them untouched and an
+     * RGBW strip is simply a longer RGB stream.
+     */
+    static constexpr size_t WIRE_PIXELS = (Board::TRAITS.maxLeds * 4 + 2) / 3;
+    static CRGB wire[WIRE_PIXELS];
+    static uint8_t residual[Board::TRAITS.maxLeds * 4];
+    static uint16_t gammaTable[256];
+    static uint16_t outputLut[256];
+    static int lutLevel = -1;
+    static bool volatile g_dither = true;
+    static OutputStats g_outputStats = {0, 0, 0, 0};
+    static Chipset g_chipset = CHIPSET_WS2812B;
+    static ColorOrder volatile g_order = ORDER_GRB;
+    static bool volatile g_white = false;
+    static bool wireWhite = false; // Layout `wire` is currently set up for, owned by the render task
+    static bool stripDark = false; // The strip shows the blanked frame of the system-off state
+
+    static const char *const CHIPSET_NAMES[NUM_CHIPSETS] = {"ws2812b", "sk6812", "ws2811"};
+    static const char *const ORDER_NAMES[NUM_ORDERS] = {"rgb", "rbg", "grb", "gbr", "brg", "bgr"};
+    // Source channel (0 red, 1 green, 2 blue) of each wire byte, per color order
+    static constexpr uint8_t ORDER_CHANNELS[NUM_ORDERS][3] = {
+        {0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}
+    };
+
+    /*
+     * Temporal upsampling. Effects with a render divisor above 1 are drawn into `leds` only on
+     * every divisor-th frame; the frames in between are a linear blend from the previous
+     * keyframe towards the latest one. Output runs one keyframe behind the effect, which keeps
+     * the motion continuous: each keyframe is shown exactly when the blend reaches it.
+     */
+    static CRGB keyframe[Board::TRAITS.maxLeds]; // Previous keyframe
+    static CRGB blended[Board::TRAITS.maxLeds];
+    static Effects::Mode keyMode = Effects::RAINBOW;
+    static uint8_t keyPhase = 0;
+    static bool keysValid = false; // `keyframe` holds the keyframe before the one in `leds`
+
+    // On-board RGB status LED, driven as a second FastLED controller from the render task
+    static CRGB g_statusColor = CRGB(0, 0, 0);
+    static uint16_t volatile g_statusBlinkMs = 0;
+    static CRGB statusPixel[1];
+    static CLEDController *g_statusController = nullptr;
+
+    /**
+     * Wakes the effects task if it is parked while the system is off.
+     */
+    static void wake() {
+        if (g_taskHandle) xTaskNotifyGive(g_taskHandle);
+    }
+
+    /**
+     * Updates the status pixel for the current blink phase, pushing it out only when it changes.
+     * @return Ticks until the pixel changes next, or portMAX_DELAY if it is steady
+     */
+    static TickType_t renderStatusPixel() {
+        // Without a pixel there is nothing to blink, so nothing to wake up for
+        if constexpr (!Board::TRAITS.statusPixel) return portMAX_DELAY;
+
+        portENTER_CRITICAL(&g_stateLock);
+        const CRGB color = g_statusColor;
+        const uint16_t interval = g_statusBlinkMs;
+        portEXIT_CRITICAL(&g_stateLock);
+
+        const unsigned long now = millis();
+        const bool lit = interval == 0 || (now / interval) % 2 == 0;
+        const CRGB shown = lit ? color : CRGB(0, 0, 0);
+        if (g_statusController && !(shown == statusPixel[0])) {
+            statusPixel[0] = shown;
+            g_statusController->showLeds(255);
+        }
+        return interval == 0 ? portMAX_DELAY : pdMS_TO_TICKS(interval - now % interval);
+    }
+
+    /**
+     * Frame period for a strip of `pixels` wire pixels: the board period, stretched when the
+     * strip takes longer to clock out (a long RGBW strip).
+     */
+    static TickType_t framePeriod(int pixels) {
+        const uint32_t wireMs = (static_cast<uint32_t>(pixels) * Board::LED_WIRE_TIME_US + 999) / 1000;
+        return max(FRAME_TICKS, pdMS_TO_TICKS(wireMs));
+    }
+
+    static void applyOutputStage(const CRGB *source, int count, int level, ColorOrder order, bool white) {
+        if (level != lutLevel) {
+            OutputStage::buildLut(gammaTable, level, outputLut);
+            lutLevel = level;
+        }
+        OutputStage::convert(source[0].raw, count, outputLut, ORDER_CHANNELS[order], wire[0].raw, residual, g_dither,
+                             white);
+    }
+
+    /**
+     * Runs the output stage and pushes the strip out; the status pixel is not scaled by it.
+     */
+    static void showStrip(const CRGB *source, uint8_t level, ColorOrder order) {
+        if (!g_strip) return;
+        const int count = numLeds;
+        const uint32_t start = micros();
+        applyOutputStage(source, count, level, order, wireWhite);
+        const uint32_t converted = micros();
+        g_strip->showLeds(255);
+        const uint32_t shown = micros();
+
+        // Exponential average over roughly the last 16 frames
+        g_outputStats.outputUs += (static_cast<int32_t>(converted - start) - static_cast<int32_t>(g_outputStats.outputUs)) / 16;
+        g_outputStats.showUs += (static_cast<int32_t>(shown - converted) - static_cast<int32_t>(g_outputStats.showUs)) / 16;
+    }
+
+    /**
+     * Draws one frame of the effect into `leds`.
+     */
+    static void renderEffect(Effects::Mode mode) {
+        const uint32_t start = micros();
+        const Effects::Params &params = Effects::getParams(mode);
+        switch (mode) {
+        case Effects::RAINBOW: Effects::rainbow(leds, numLeds, params); break;
+        case Effects::CYLON: Effects::cylon(leds, numLeds, params); break;
+        case Effects::SPARKLE: Effects::sparkle(leds, numLeds, params); break;
+        case Effects::FIRE: Effects::fire(leds, numLeds, params); break;
+        case Effects::CONFETTI: Effects::confetti(leds, numLeds, params); break;
+        case Effects::SINELON: Effects::sinelon(leds, numLeds, params); break;
+        case Effects::JUGGLE: Effects::juggle(leds, numLeds, params); break;
+        case Effects::BPM: Effects::bpm(leds, numLeds, params); break;
+        case Effects::SNOW: Effects::snow(leds, numLeds, params); break;
+        case Effects::COMET: Effects::comet(leds, numLeds, params); break;
+        case Effects::RAINBOW_GLITTER: Effects::rainbow_glitter(leds, numLeds, params); break;
+        case Effects::COLOR_WAVES: Effects::color_waves(leds, numLeds, params); break;
+        case Effects::THEATER_CHASE: Effects::theater_chase(leds, numLeds, params); break;
+        case Effects::SOLID_GLOW: Effects::solid_glow(leds, numLeds, params); break;
+        case Effects::USER: Effects::user(leds, numLeds, params); break;
+        case Effects::AUDIO_SPECTRUM: Effects::audio_spectrum(leds, numLeds, params); break;
+        case Effects::AUDIO_PULSE: Effects::audio_pulse(leds, numLeds, params); break;
+        case Effects::AUDIO_VU: Effects::audio_vu(leds, numLeds, params); break;
+        case Effects::PLASMA: Effects::plasma(leds, numLeds, params); break;
+        case Effects::ROWS: Effects::rows(leds, numLeds, params); break;
+        case Effects::ANIMATION: Effects::animation(leds, numLeds, params); break;
+        default: break;
+        }
+        g_outputStats.renderUs += (static_cast<int32_t>(micros() - start) - static_cast<int32_t>(g_outputStats.renderUs)) / 16;
+    }
+
+    /**
+     * Advances an interpolated effect by one output frame.
+     * @return The frame to show: the previous keyframe on keyframe frames, a blend otherwise
+     */
+    static const CRGB *advanceKeyframes(Effects::Mode mode, uint8_t divisor) {
+        if (mode != keyMode || !keysValid) {
+            // A new effect starts with a keyframe; the blend from the old one acts as a crossfade
+            keyMode = mode;
+            keyPhase = 0;
+        }
+        const int count = numLeds;
+        if (keyPhase == 0) {
+            if (keysValid) memcpy(keyframe, leds, count * sizeof(CRGB));
+            renderEffect(mode);
+            if (!keysValid) {
+                // Nothing to blend from yet: start with a still keyframe
+                memcpy(keyframe, leds, count * sizeof(CRGB));
+                keysValid = true;
             }
-            g_settingsChanged = false;
         }
+        const uint8_t phase = keyPhase;
+        keyPhase = (keyPhase + 1) % divisor;
+        if (phase == 0) return keyframe;
+
+        const uint32_t start = micros();
+        FrameBlend::blend(keyframe[0].raw, leds[0].raw, blended[0].raw, count * 3, FrameBlend::amount(phase, divisor));
+        g_outputStats.blendUs += (static_cast<int32_t>(micros() - start) - static_cast<int32_t>(g_outputStats.blendUs)) / 16;
+        return blended;
+    }
+
+    void handle_internal() {
+        g_frameSequence.fetch_add(1);
+
+        // Snapshot the state once per frame so a scene change is applied as a whole
+        portENTER_CRITICAL(&g_stateLock);
+        const Effects::Mode mode = g_mode;
+        const bool isSystemOff = g_isSystemOff;
+        const bool settingsChanged = g_settingsChanged;
+        const int level = brightness;
+        const ColorOrder order = g_order;
+        const bool white = g_white;
+        const bool sceneParamsPending = g_sceneParamsPending;
+        const Effects::Params sceneParams = g_sceneParams;
+        const bool sceneLayoutPending = g_sceneLayoutPending;
+        g_sceneParamsPending = false;
+        g_sceneLayoutPending = false;
+        g_settingsChanged = false;
+        portEXIT_CRITICAL(&g_stateLock);
 
-        if (!g_isSystemOff) {
-            switch (g_mode) {
-            case Effects::RAINBOW: Effects::rainbow(leds, numLeds); break;
-            case Effects::CYLON: Effects::cylon(leds, numLeds); break;
-            case Effects::SPARKLE: Effects::sparkle(leds, numLeds); break;
-            case Effects::FIRE: Effects::fire(leds, numLeds); break;
-            case Effects::CONFETTI: Effects::confetti(leds, numLeds); break;
-            case Effects::SINELON: Effects::sinelon(leds, numLeds); break;
-            case Effects::JUGGLE: Effects::juggle(leds, numLeds); break;
-            case Effects::BPM: Effects::bpm(leds, numLeds); break;
-            case Effects::SNOW: Effects::snow(leds, numLeds); break;
-            case Effects::COMET: Effects::comet(leds, numLeds); break;
-            case Effects::RAINBOW_GLITTER: Effects::rainbow_glitter(leds, numLeds); break;
-            case Effects::COLOR_WAVES: Effects::color_waves(leds, numLeds); break;
-            case Effects::THEATER_CHASE: Effects::theater_chase(leds, numLeds); break;
-            case Effects::SOLID_GLOW: Effects::solid_glow(leds, numLeds); break;
-            default: break;
+        if (sceneParamsPending) Effects::setParams(mode, sceneParams);
+        if (sceneLayoutPending) Layout::commitStaged();
+
+        if (settingsChanged && g_wireChanged) {
+            wireWhite = white;
+            g_strip->setLeds(wire, OutputStage::wirePixels(numLeds, wireWhite));
+            frameTicks = framePeriod(OutputStage::wirePixels(numLeds, wireWhite));
+            fill_solid(leds, numLeds, CRGB::Black);
+            OutputStage::resetResidual(residual, sizeof(residual));
+            keysValid = false;
+            g_wireChanged = false;
+        }
+
+        if (!isSystemOff) {
+            const uint8_t divisor = Effects::renderDivisor(mode);
+            if (divisor > 1) {
+                showStrip(advanceKeyframes(mode, divisor), level, order);
+            } else {
+                renderEffect(mode);
+                keysValid = false;
+                showStrip(leds, level, order);
             }
-            FastLED.show();
-        } else {
+            stripDark = false;
+        } else if (!stripDark || settingsChanged) {
+            // Blanked once; wake-ups for the status pixel leave the dark strip alone
             fill_solid(leds, numLeds, CRGB::Black);
-            FastLED.show();
+            keysValid = false;
+            showStrip(leds, level, order);
+            stripDark = true;
         }
+
+        g_frameSequence.fetch_add(1);
     }
 
     void effectsTask(void *pvParameters) {
+        TickType_t frameStart = xTaskGetTickCount();
         for (;;) {
             handle_internal();
-            vTaskDelay(pdMS_TO_TICKS(10));
+            const TickType_t statusWait = renderStatusPixel();
+            if (g_isSystemOff) {
+                // Nothing changes on a dark strip: park until a setter wakes the task
+                // or the status pixel is due to blink
+                ulTaskNotifyTake(pdTRUE, statusWait);
+                frameStart = xTaskGetTickCount();
+            } else if (Effects::isAudioReactive(g_mode)) {
+                // A feature packet wakes the task at once, so it shows within the current frame
+                ulTaskNotifyTake(pdTRUE, frameTicks);
+                frameStart = xTaskGetTickCount();
+            } else if (xTaskGetTickCount() - frameStart >= frameTicks) {
+                // The frame overran its period: start the next one now instead of bursting to catch up
+                frameStart = xTaskGetTickCount();
+                taskYIELD();
+            } else {
+                // Periods are counted from frame start, so render time does not stretch them
+                vTaskDelayUntil(&frameStart, frameTicks);
+            }
         }
     }
 
-    void init(int count) {
-        numLeds = constrain(count, 1, 256);
-        FastLED.addLeds<WS2812B, Pins::STRIP, GRB>(leds, numLeds);
-        FastLED.setBrightness(brightness);
+    /**
+     * Instantiates the controller for the chipset. Colors are ordered by the output stage, so
+     * every chipset is declared as RGB.
+     */
+    static CLEDController *addStrip(Chipset chipset, int pixels) {
+        switch (chipset) {
+        case CHIPSET_SK6812: return &FastLED.addLeds<SK6812, Pins::STRIP, RGB>(wire, pixels);
+        case CHIPSET_WS2811: return &FastLED.addLeds<WS2811, Pins::STRIP, RGB>(wire, pixels);
+        case CHIPSET_WS2812B:
+        default: return &FastLED.addLeds<WS2812B, Pins::STRIP, RGB>(wire, pixels);
+        }
+    }
 
-        xTaskCreatePinnedToCore(
-            effectsTask,
-            "EffectsTask",
-            4096,
-            NULL,
-            1,
-            NULL,
-            0 // Pin to Core 0
-        );
-        g_useTask = true;
+    void init(int count, Chipset chipset) {
+        numLeds = constrain(count, 1, Board::TRAITS.maxLeds);
+        g_chipset = chipset < NUM_CHIPSETS ? chipset : CHIPSET_WS2812B;
+        wireWhite = g_white;
+        OutputStage::buildGammaTable(gammaTable);
+        OutputStage::resetResidual(residual, sizeof(residual));
+        g_strip = addStrip(g_chipset, OutputStage::wirePixels(numLeds, wireWhite));
+        frameTicks = framePeriod(OutputStage::wirePixels(numLeds, wireWhite));
+        g_strip->setDither(DISABLE_DITHER);
+        if constexpr (Board::TRAITS.statusPixel) {
+            g_statusController = &FastLED.addLeds<WS2812, Pins::LED, GRB>(statusPixel, 1);
+        }
+    }
+
+    void start() {
+        // Show the restored effect right away instead of waiting for the task's first tick
+        g_settingsChanged = true;
+        handle_internal();
+        BootProfiler::mark(BootProfiler::FIRST_LIGHT);
+
+        Tasks::spawn(effectsTask, "EffectsTask", Board::TASKS.render, &g_taskHandle);
     }
     void setBrightness(int value) {
         brightness = constrain(value, 0, 255);
         g_settingsChanged = true;
+        wake();
+    }
+    int getBrightness() {
+        return brightness;
+    }
+    int getNumLeds() {
+        return numLeds;
     }
     void setNumLeds(int value) {
-        numLeds = constrain(value, 1, 256);
-        g_numLedsChanged = true;
+        numLeds = constrain(value, 1, Board::TRAITS.maxLeds);
+        g_wireChanged = true;
         g_settingsChanged = true;
+        wake();
+    }
+
+    void setDithering(bool enabled) {
+        g_dither = enabled;
+        wake();
+    }
+
+    bool isDithering() {
+        return g_dither;
+    }
+
+    OutputStats getOutputStats() {
+        return g_outputStats;
+    }
+
+    void setColorOrder(ColorOrder order, bool white) {
+        portENTER_CRITICAL(&g_stateLock);
+        g_order = order < NUM_ORDERS ? order : ORDER_GRB;
+        if (white != g_white) {
+            // A different number of bytes per pixel: the controller's length changes too
+            g_white = white;
+            g_wireChanged = true;
+        }
+        g_settingsChanged = true;
+        portEXIT_CRITICAL(&g_stateLock);
+        wake();
+    }
+
+    ColorOrder getColorOrder() {
+        return g_order;
+    }
+
+    bool hasWhiteChannel() {
+        return g_white;
+    }
+
+    Chipset getChipset() {
+        return g_chipset;
+    }
+
+    uint32_t frameSequence() {
+        return g_frameSequence.load();
+    }
+
+    void waitForFrame(uint32_t sequence) {
+        if ((sequence & 1) == 0) return;
+        while (g_frameSequence.load() == sequence) vTaskDelay(1);
+    }
+
+    const char *chipsetName(uint8_t chipset) {
+        return chipset < NUM_CHIPSETS ? CHIPSET_NAMES[chipset] : "unknown";
+    }
+
+    const char *orderName(uint8_t order) {
+        return order < NUM_ORDERS ? ORDER_NAMES[order] : "unknown";
+    }
+
+    bool parseChipset(const char *name, Chipset &chipset) {
+        if (name == nullptr) return false;
+        for (int i = 0; i < NUM_CHIPSETS; i++) {
+            if (strcmp(name, CHIPSET_NAMES[i]) == 0) {
+                chipset = static_cast<Chipset>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool parseOrder(const char *name, ColorOrder &order) {
+        if (name == nullptr) return false;
+        for (int i = 0; i < NUM_ORDERS; i++) {
+            if (strcmp(name, ORDER_NAMES[i]) == 0) {
+                order = static_cast<ColorOrder>(i);
+                return true;
+            }
+        }
+        return false;
     }
 
     void setMode(Effects::Mode mode) {
         g_mode = mode;
-        if (!g_useTask) {
-            handle_internal();
-        }
+        wake();
     }
 
     void setSystemOff(bool isSystemOff) {
         g_isSystemOff = isSystemOff;
-        if (!g_useTask) {
-            handle_internal();
+        wake();
+    }
+
+    void onAudioFrame() {
+        if (Effects::isAudioReactive(g_mode)) wake();
+    }
+
+    void setStatusPixel(const CRGB &color, uint16_t blinkIntervalMs) {
+        portENTER_CRITICAL(&g_stateLock);
+        g_statusColor = color;
+        g_statusBlinkMs = blinkIntervalMs;
+        portEXIT_CRITICAL(&g_stateLock);
+        wake();
+    }
+
+    void setScene(Effects::Mode mode, int value, bool isSystemOff, const Effects::Params *params,
+                  bool layoutStaged) {
+        portENTER_CRITICAL(&g_stateLock);
+        if (layoutStaged) g_sceneLayoutPending = true;
+        if (params != nullptr) {
+            g_sceneParams = *params;
+            g_sceneParamsPending = true;
         }
+        g_mode = mode;
+        g_isSystemOff = isSystemOff;
+        brightness = constrain(value, 0, 255);
+        g_settingsChanged = true;
+        portEXIT_CRITICAL(&g_stateLock);
+        wake();
     }
 }
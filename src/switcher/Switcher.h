@@ -3,10 +3,118 @@
 #include "../effects/Effects.h"
 
 namespace Switcher {
+    /**
+     * @brief Render timings, averaged over the last frames
+     */
+    struct OutputStats {
+        uint32_t outputUs; ///< Gamma, brightness and dithering pass
+        uint32_t showUs;   ///< Transmitting the strip
+        uint32_t renderUs; ///< Drawing one frame of the effect (a keyframe for interpolated effects)
+        uint32_t blendUs;  ///< Interpolating one frame between keyframes
+    };
 
-    void init(int count);
+    /**
+     * @brief LED chipsets the strip output can drive; the timing is fixed at boot
+     */
+    enum Chipset : uint8_t {
+        CHIPSET_WS2812B,
+        CHIPSET_SK6812,
+        CHIPSET_WS2811,
+        NUM_CHIPSETS
+    };
+
+    /**
+     * @brief Order of the color channels on the wire; a white channel, if any, follows them
+     */
+    enum ColorOrder : uint8_t {
+        ORDER_RGB,
+        ORDER_RBG,
+        ORDER_GRB,
+        ORDER_GBR,
+        ORDER_BRG,
+        ORDER_BGR,
+        NUM_ORDERS
+    };
+
+    /**
+     * @brief Starts the strip output
+     * @param count Number of LEDs
+     * @param chipset Chipset of the strip
+     */
+    void init(int count, Chipset chipset);
+    void start();
     void setMode(Effects::Mode mode);
     void setSystemOff(bool isSystemOff);
     void setBrightness(int value);
+    int getBrightness();
+    /**
+     * @brief Changes mode, brightness, power and optionally the mode's parameters and the layout
+     *        together, so the render task shows them from the same frame
+     * @param params Parameters to apply to the mode, or nullptr to keep the current ones
+     * @param layoutStaged A layout was staged with Layout::stage() and is published with the scene
+     */
+    void setScene(Effects::Mode mode, int value, bool isSystemOff, const Effects::Params *params = nullptr,
+                  bool layoutStaged = false);
     void setNumLeds(int value);
+    int getNumLeds();
+    void setStatusPixel(const CRGB &color, uint16_t blinkIntervalMs);
+    void onAudioFrame();
+
+    /**
+     * @brief Enables temporal dithering of the output stage
+     */
+    void setDithering(bool enabled);
+    bool isDithering();
+    OutputStats getOutputStats();
+
+    /**
+     * @brief Sets how pixels are laid out on the wire; takes effect with the next frame
+     * @param order Order of the color channels
+     * @param white The strip has a fourth, white channel (RGBW)
+     */
+    void setColorOrder(ColorOrder order, bool white);
+    ColorOrder getColorOrder();
+    bool hasWhiteChannel();
+
+    /**
+     * @brief Returns the chipset the strip output was started with
+     */
+    Chipset getChipset();
+
+    /**
+     * @brief Frame counter of the render task: odd while a frame is being drawn, even between frames
+     *
+     * Modules that double-buffer data read by effects (user program, palette, layout) take the
+     * sequence right after publishing a new buffer, and pass it to waitForFrame() before writing
+     * into the retired one again.
+     */
+    uint32_t frameSequence();
+
+    /**
+     * @brief Blocks until the frame in progress at `sequence` has been drawn; returns at once if
+     *        none was. Must not be called from the render task.
+     */
+    void waitForFrame(uint32_t sequence);
+
+    /**
+     * @brief Returns the name of a chipset ("ws2812b", "sk6812", "ws2811")
+     */
+    const char *chipsetName(uint8_t chipset);
+
+    /**
+     * @brief Returns the name of a color order ("rgb", "grb", ...)
+     */
+    const char *orderName(uint8_t order);
+
+    /**
+     * @brief Looks up a chipset by name
+     * @return false if the name is unknown
+     */
+    bool parseChipset(const char *name, Chipset &chipset);
+
+    /**
+     * @brief Looks up a color order by name
+     * @return false if the name is unknown
+     */
+    bool parseOrder(const char *name, ColorOrder &order);
 }
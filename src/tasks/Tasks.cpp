@@ -0,0 +1,78 @@
+#include <Arduino.h>
+#include <freertos/semphr.h>
+#include "Tasks.h"
+
+namespace Tasks {
+    static const char *TAG = "TASKS";
+
+    static SemaphoreHandle_t stateLock = nullptr;
+
+    void init() {
+        if (stateLock == nullptr) {
+            stateLock = xSemaphoreCreateMutex();
+        }
+    }
+
+    bool spawn(TaskFunction_t function, const char *name, const TaskPlacement &placement, TaskHandle_t *handle) {
+        const BaseType_t core = placement.core == Board::ANY_CORE ? tskNO_AFFINITY : placement.core;
+        const BaseType_t result = xTaskCreatePinnedToCore(
+            function, name, placement.stack, nullptr, placement.priority, handle, core);
+        if (result != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create task %s", name);
+            return false;
+        }
+        ESP_LOGI(TAG, "Task %s: core %d, priority %d", name, placement.core, placement.priority);
+        return true;
+    }
+
+    void lock() {
+        if (stateLock) xSemaphoreTake(stateLock, portMAX_DELAY);
+    }
+
+    void unlock() {
+        if (stateLock) xSemaphoreGive(stateLock);
+    }
+
+    bool hasRuntimeStats() {
+#if configGENERATE_RUN_TIME_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    size_t getStats(TaskStats *out, size_t max) {
+#if configUSE_TRACE_FACILITY
+        static TaskStatus_t statuses[MAX_TASKS];
+        uint32_t totalRunTime = 0;
+        const UBaseType_t count = uxTaskGetSystemState(statuses, MAX_TASKS, &totalRunTime);
+        // Counters are in run time ticks; scale to a percentage of one core
+        const uint32_t onePercent = totalRunTime / 100;
+
+        size_t written = 0;
+        for (UBaseType_t i = 0; i < count && written < max; i++) {
+            const TaskStatus_t &status = statuses[i];
+            const BaseType_t affinity = xTaskGetAffinity(status.xHandle);
+            TaskStats &stats = out[written++];
+            stats.name = status.pcTaskName;
+            stats.core = affinity == tskNO_AFFINITY ? Board::ANY_CORE : affinity;
+            stats.priority = status.uxCurrentPriority;
+            stats.cpuPercent = 0;
+#if configGENERATE_RUN_TIME_STATS
+            if (onePercent > 0) {
+                const uint32_t percent = status.ulRunTimeCounter / onePercent;
+                stats.cpuPercent = percent > 100 ? 100 : percent;
+            }
+#else
+            (void) onePercent;
+#endif
+            stats.stackFree = status.usStackHighWaterMark;
+        }
+        return written;
+#else
+        (void) out;
+        (void) max;
+        return 0;
+#endif
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "../board/BoardTraits.h"
+
+/**
+ * @brief Application task placement and the lock that serializes state changes
+ *
+ * loop(), the network task and the persistence task all change application state (settings,
+ * presets, Wi-Fi, servers). Each of them holds the state lock while it does so; the render task
+ * only reads Switcher's snapshot and never takes it.
+ */
+namespace Tasks {
+    /// Upper bound of tasks reported by getStats()
+    constexpr size_t MAX_TASKS = 32;
+
+    /**
+     * @brief Per-task runtime figures
+     */
+    struct TaskStats {
+        const char *name;       ///< FreeRTOS task name
+        int8_t core;            ///< Core affinity, Board::ANY_CORE if unpinned
+        uint8_t priority;       ///< Current priority
+        uint8_t cpuPercent;     ///< Share of one core since boot (0 without runtime stats)
+        uint32_t stackFree;     ///< Lowest free stack seen, in bytes
+    };
+
+    /**
+     * @brief Creates the state lock (call in setup() before any task is spawned)
+     */
+    void init();
+
+    /**
+     * @brief Creates a task with the given placement
+     * @param function Task entry point
+     * @param name Task name
+     * @param placement Core, priority and stack size
+     * @param handle Receives the task handle (optional)
+     * @return true if the task was created
+     */
+    bool spawn(TaskFunction_t function, const char *name, const TaskPlacement &placement,
+               TaskHandle_t *handle = nullptr);
+
+    /**
+     * @brief Acquires the state lock, blocking until it is free
+     */
+    void lock();
+
+    /**
+     * @brief Releases the state lock
+     */
+    void unlock();
+
+    /**
+     * @brief Holds the state lock for the lifetime of the object
+     */
+    class StateLock {
+    public:
+        StateLock() { lock(); }
+        ~StateLock() { unlock(); }
+        StateLock(const StateLock &) = delete;
+        StateLock &operator=(const StateLock &) = delete;
+    };
+
+    /**
+     * @brief Whether CPU usage per task is available (CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS)
+     */
+    bool hasRuntimeStats();
+
+    /**
+     * @brief Collects figures for every task
+     * @param out Destination array
+     * @param max Capacity of out
+     * @return Number of tasks written, 0 if the trace facility is disabled
+     */
+    size_t getStats(TaskStats *out, size_t max);
+}
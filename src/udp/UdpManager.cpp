@@ -1,15 +1,26 @@
 #include <WiFiUdp.h>
 #include "UdpManager.h"
 #include <WiFi.h>
+#include "../board/BoardTraits.h"
+#include "../audio/AudioFeatures.h"
+#include "../switcher/Switcher.h"
+#include "../event_log/EventLog.h"
 
 namespace UdpManager {
     static const char *TAG = "UDP";
-    static const String COMMAND_MARK = "Cmd";
+    static constexpr const char *COMMAND_MARK = "Cmd";
+    static constexpr int COMMAND_MARK_LENGTH = 3;
     static WiFiUDP udp;
+    static WiFiUDP multicastUdp;
     static bool udpRunning = false;
+    static bool multicastRunning = false;
     static UdpMessageCallback messageCallback = nullptr;
+    static char packetBuffer[Board::TRAITS.commandBufferSize];
+    static char replyBuffer[Board::TRAITS.replyBufferSize];
+    // Feature packets can arrive faster than the poll interval; drain a few per pass
+    static constexpr int MAX_PACKETS_PER_PASS = 8;
 
-    static String prepareResponse() {
+    static void prepareResponse(ResponseWriter &response) {
         uint64_t chipId = ESP.getEfuseMac();
         uint32_t chipIdLower = (uint32_t) (chipId & 0xFFFFFFFF);
 
@@ -22,19 +33,12 @@ namespace UdpManager {
                  (uint8_t) (chipId >> 32),
                  (uint8_t) (chipId >> 40));
 
-        String ip = WiFi.localIP().toString();
-        String version = APP_VERSION;
-        String type = DEVICE_TYPE;
-        String deviceName = "Device-" + String(chipIdLower % 10000, 10);
-
-        String response = "{";
-        response += "\"ip\":\"" + ip + "\",";
-        response += "\"type\":\"" + type + "\",";
-        response += "\"name\":\"" + deviceName + "\",";
-        response += "\"device_id\":\"" + String(macStr) + "\",";
-        response += "\"app_version\":\"" + version + "\"";
-        response += "}";
-        return response;
+        response.add("{\"ip\":\"").addIp(static_cast<uint32_t>(WiFi.localIP())).add("\",");
+        response.add("\"type\":\"" DEVICE_TYPE "\",");
+        response.add("\"name\":\"Device-").addUnsigned(chipIdLower % 10000).add("\",");
+        response.add("\"device_id\":\"").add(macStr).add("\",");
+        response.add("\"app_version\":\"" APP_VERSION "\"");
+        response.add('}');
     }
 
     void init(uint16_t port) {
@@ -44,52 +48,81 @@ namespace UdpManager {
         } else {
             ESP_LOGW(TAG, "Failed to start UDP");
         }
+        // Every device joins the one fleet address; groups are filtered by the parser
+        IPAddress group;
+        group.fromString(MULTICAST_ADDRESS);
+        if (multicastUdp.beginMulticast(group, MULTICAST_UDP_PORT)) {
+            multicastRunning = true;
+            ESP_LOGI(TAG, "Joined multicast " MULTICAST_ADDRESS ":%d", MULTICAST_UDP_PORT);
+        } else {
+            ESP_LOGW(TAG, "Failed to join multicast group");
+        }
     }
 
     void stop() {
         udp.stop();
+        multicastUdp.stop();
         udpRunning = false;
+        multicastRunning = false;
         ESP_LOGI(TAG, "UDP stopped");
     }
 
-    void handle() {
-        if (!udpRunning) return;
-
-        int packetSize = udp.parsePacket();
-        if (packetSize > 0) {
-            char packetBuffer[256];
-            int len = udp.read(packetBuffer, sizeof(packetBuffer) - 1);
+    /**
+     * Handles the datagrams waiting on one socket. Commands sent to the multicast address are
+     * never answered, so one datagram to the whole fleet does not draw a storm of replies.
+     */
+    static void receive(WiFiUDP &socket, bool multicast) {
+        for (int i = 0; i < MAX_PACKETS_PER_PASS && socket.parsePacket() > 0; i++) {
+            int len = socket.read(packetBuffer, sizeof(packetBuffer) - 1);
             if (len <= 0) return;
-            packetBuffer[len] = 0;
-            String message = String(packetBuffer);
-            message.trim();
-            String remoteIP = udp.remoteIP().toString();
-            ESP_LOGD(TAG, "UDP Received: %s from %s", message.c_str(), remoteIP.c_str());
+            const uint8_t *bytes = reinterpret_cast<const uint8_t *>(packetBuffer);
+            if (AudioFeatures::isPacket(bytes, len)) {
+                // Binary and unacknowledged: a lost packet is superseded by the next one
+                if (AudioFeatures::publish(bytes, len)) Switcher::onAudioFrame();
+                continue;
+            }
+            // Trim surrounding whitespace in place
+            char *message = packetBuffer;
+            while (len > 0 && isspace(static_cast<unsigned char>(message[len - 1]))) len--;
+            message[len] = '\0';
+            while (len > 0 && isspace(static_cast<unsigned char>(message[0]))) {
+                message++;
+                len--;
+            }
+            const uint32_t remoteIP = static_cast<uint32_t>(socket.remoteIP());
+            ResponseWriter response(replyBuffer, sizeof(replyBuffer));
 
-            if (message == HANDSHAKE_MESSAGE) {
-                udp.beginPacket(udp.remoteIP(), udp.remotePort());
-                String response = prepareResponse();
-                udp.print(response);
-                udp.endPacket();
-                ESP_LOGD(TAG, "UDP Sent response to %s", remoteIP.c_str());
-            } else if (message.startsWith(COMMAND_MARK)) {
+            if (!multicast && strcmp(message, HANDSHAKE_MESSAGE) == 0) {
+                prepareResponse(response);
+                socket.beginPacket(socket.remoteIP(), socket.remotePort());
+                socket.write(reinterpret_cast<const uint8_t *>(response.c_str()), response.length());
+                socket.endPacket();
+                EventLog::log(EventLog::UDP_DISCOVERY, remoteIP, socket.remotePort());
+            } else if (strncmp(message, COMMAND_MARK, COMMAND_MARK_LENGTH) == 0) {
+                if (multicast) {
+                    EventLog::log(EventLog::UDP_MULTICAST, len, remoteIP);
+                } else {
+                    EventLog::log(EventLog::UDP_COMMAND, len, remoteIP, socket.remotePort());
+                }
                 // Notify listener if registered
                 if (messageCallback != nullptr) {
-                    udp.beginPacket(udp.remoteIP(), udp.remotePort());
-                    String request = message.substring(COMMAND_MARK.length(), message.length() - 1);
-                    if (messageCallback(request) == true) {
-                        String response = "{\"status\":\"Success\"}";
-                        udp.print(response);
-                    } else {
-                        String response = "{\"status\":\"Failure\"}";
-                        udp.print(response);
-                    }
-                    udp.endPacket();
+                    // The mark is followed by the command and one terminating character
+                    const size_t requestLength = len > COMMAND_MARK_LENGTH ? len - COMMAND_MARK_LENGTH - 1 : 0;
+                    messageCallback(message + COMMAND_MARK_LENGTH, requestLength, response);
+                    if (multicast) continue;
+                    socket.beginPacket(socket.remoteIP(), socket.remotePort());
+                    socket.write(reinterpret_cast<const uint8_t *>(response.c_str()), response.length());
+                    socket.endPacket();
                 }
             }
         }
     }
 
+    void handle() {
+        if (udpRunning) receive(udp, false);
+        if (multicastRunning) receive(multicastUdp, true);
+    }
+
     void setMessageListener(UdpMessageCallback callback) {
         messageCallback = callback;
         ESP_LOGD(TAG, "Message listener %s", callback != nullptr ? "registered" : "unregistered");
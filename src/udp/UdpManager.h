@@ -1,10 +1,18 @@
 #pragma once
 
+#include "../parser/ResponseWriter.h"
+
 /**
  * @brief Default UDP port for discovery and handshake
  */
 #define LOCAL_UDP_PORT 4210
 
+/**
+ * @brief Multicast address and port every device listens on for group commands
+ */
+#define MULTICAST_ADDRESS "239.255.76.88"
+#define MULTICAST_UDP_PORT 4211
+
 /**
  * @brief Discovery response message
  */
@@ -12,13 +20,15 @@
 
 /**
  * @brief Callback type for receiving UDP messages
- * @param message Received message content
+ * @param message Received message content, not necessarily NUL-terminated
+ * @param length Length of the message
+ * @param reply Output reply datagram to send back to the sender
  * @return true if message was processed successfully
  */
-typedef bool (*UdpMessageCallback)(const String &message);
+typedef bool (*UdpMessageCallback)(const char *message, size_t length, ResponseWriter &reply);
 
 /**
- * @brief Management of UDP communication for device discovery
+ * @brief Management of UDP communication for device discovery, commands and group commands
  */
 namespace UdpManager {
     /**
@@ -0,0 +1,137 @@
+#include <Arduino.h>
+#include <FastLED.h>
+#include "Bytecode.h"
+
+namespace UserEffect {
+    static const char *TAG = "USER_FX";
+
+    /**
+     * Stack effect of one instruction: immediate bytes, values popped, values pushed.
+     */
+    struct OpInfo {
+        int8_t immediate;
+        int8_t pops;
+        int8_t pushes;
+    };
+
+    static bool opInfo(uint8_t opcode, OpInfo &info) {
+        switch (opcode) {
+            case OP_PUSH: info = {1, 0, 1}; return true;
+            case OP_PUSH16: info = {2, 0, 1}; return true;
+            case OP_TIME: case OP_INDEX: case OP_COUNT:
+            case OP_SPEED: case OP_INTENSITY: case OP_HUE:
+                info = {0, 0, 1}; return true;
+            case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+            case OP_AND: case OP_OR: case OP_XOR: case OP_SHL: case OP_SHR:
+            case OP_MIN: case OP_MAX: case OP_LT: case OP_GT: case OP_EQ:
+            case OP_NOISE: case OP_SCALE8:
+                info = {0, 2, 1}; return true;
+            case OP_SEL: info = {0, 3, 1}; return true;
+            case OP_DUP: info = {0, 1, 2}; return true;
+            case OP_SWAP: info = {0, 2, 2}; return true;
+            case OP_DROP: info = {0, 1, 0}; return true;
+            case OP_SIN8: case OP_COS8: info = {0, 1, 1}; return true;
+            case OP_RGB: case OP_HSV: info = {0, 3, 0}; return true;
+            case OP_PAL: info = {0, 2, 0}; return true;
+            default: return false;
+        }
+    }
+
+    static bool isOutput(uint8_t opcode) {
+        return opcode == OP_RGB || opcode == OP_HSV || opcode == OP_PAL;
+    }
+
+    bool validate(const uint8_t *code, size_t length) {
+        if (code == nullptr || length == 0 || length > MAX_CODE) return false;
+
+        size_t depth = 0;
+        size_t pc = 0;
+        while (pc < length) {
+            const uint8_t opcode = code[pc];
+            OpInfo info;
+            if (!opInfo(opcode, info)) {
+                ESP_LOGW(TAG, "Unknown opcode 0x%02X at %u", opcode, (unsigned) pc);
+                return false;
+            }
+            if (pc + 1 + info.immediate > length) {
+                ESP_LOGW(TAG, "Truncated immediate at %u", (unsigned) pc);
+                return false;
+            }
+            if (depth < static_cast<size_t>(info.pops)) {
+                ESP_LOGW(TAG, "Stack underflow at %u", (unsigned) pc);
+                return false;
+            }
+            depth = depth - info.pops + info.pushes;
+            if (depth > MAX_STACK) {
+                ESP_LOGW(TAG, "Stack overflow at %u", (unsigned) pc);
+                return false;
+            }
+            const size_t next = pc + 1 + info.immediate;
+            if (isOutput(opcode) != (next == length)) {
+                ESP_LOGW(TAG, "Program must end with exactly one output instruction");
+                return false;
+            }
+            pc = next;
+        }
+        return true;
+    }
+
+    Output evaluate(const uint8_t *code, size_t length, const Inputs &inputs, uint32_t index) {
+        // validate() guarantees the stack stays within bounds, and the caller never rewrites a
+        // program a frame may still run, so no checks are needed here.
+        // Unsigned arithmetic wraps instead of overflowing, whatever the program computes.
+        uint32_t stack[MAX_STACK];
+        int sp = 0;
+        const uint8_t *end = code + length;
+
+        while (code < end) {
+            switch (*code++) {
+                case OP_PUSH: stack[sp++] = *code++; break;
+                case OP_PUSH16: stack[sp++] = code[0] | (code[1] << 8); code += 2; break;
+                case OP_TIME: stack[sp++] = inputs.time; break;
+                case OP_INDEX: stack[sp++] = index; break;
+                case OP_COUNT: stack[sp++] = inputs.count; break;
+                case OP_SPEED: stack[sp++] = inputs.speed; break;
+                case OP_INTENSITY: stack[sp++] = inputs.intensity; break;
+                case OP_HUE: stack[sp++] = inputs.hue; break;
+
+                case OP_ADD: sp--; stack[sp - 1] += stack[sp]; break;
+                case OP_SUB: sp--; stack[sp - 1] -= stack[sp]; break;
+                case OP_MUL: sp--; stack[sp - 1] *= stack[sp]; break;
+                case OP_DIV: sp--; stack[sp - 1] = stack[sp] ? stack[sp - 1] / stack[sp] : 0; break;
+                case OP_MOD: sp--; stack[sp - 1] = stack[sp] ? stack[sp - 1] % stack[sp] : 0; break;
+                case OP_AND: sp--; stack[sp - 1] &= stack[sp]; break;
+                case OP_OR: sp--; stack[sp - 1] |= stack[sp]; break;
+                case OP_XOR: sp--; stack[sp - 1] ^= stack[sp]; break;
+                case OP_SHL: sp--; stack[sp - 1] <<= (stack[sp] & 31); break;
+                case OP_SHR: sp--; stack[sp - 1] >>= (stack[sp] & 31); break;
+                case OP_MIN: sp--; if (stack[sp] < stack[sp - 1]) stack[sp - 1] = stack[sp]; break;
+                case OP_MAX: sp--; if (stack[sp] > stack[sp - 1]) stack[sp - 1] = stack[sp]; break;
+                case OP_LT: sp--; stack[sp - 1] = stack[sp - 1] < stack[sp]; break;
+                case OP_GT: sp--; stack[sp - 1] = stack[sp - 1] > stack[sp]; break;
+                case OP_EQ: sp--; stack[sp - 1] = stack[sp - 1] == stack[sp]; break;
+
+                case OP_SEL: sp -= 2; stack[sp - 1] = stack[sp - 1] ? stack[sp] : stack[sp + 1]; break;
+                case OP_DUP: stack[sp] = stack[sp - 1]; sp++; break;
+                case OP_SWAP: {
+                    const uint32_t top = stack[sp - 1];
+                    stack[sp - 1] = stack[sp - 2];
+                    stack[sp - 2] = top;
+                    break;
+                }
+                case OP_DROP: sp--; break;
+
+                case OP_SIN8: stack[sp - 1] = sin8(stack[sp - 1]); break;
+                case OP_COS8: stack[sp - 1] = cos8(stack[sp - 1]); break;
+                case OP_NOISE: sp--; stack[sp - 1] = inoise8(stack[sp - 1], stack[sp]); break;
+                case OP_SCALE8: sp--; stack[sp - 1] = scale8(stack[sp - 1], stack[sp]); break;
+
+                case OP_RGB: return {OP_RGB, stack[sp - 3], stack[sp - 2], stack[sp - 1]};
+                case OP_HSV: return {OP_HSV, stack[sp - 3], stack[sp - 2], stack[sp - 1]};
+                case OP_PAL: return {OP_PAL, stack[sp - 2], stack[sp - 1], 0};
+                default: break;
+            }
+        }
+        return {OP_RGB, 0, 0, 0};
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Bytecode of uploadable per-pixel effect programs: validation and interpreter
+ *
+ * A program is straight-line stack bytecode evaluated once per pixel. There are no jumps, so
+ * the instruction count per pixel is bounded by the program length, and the stack depth of every
+ * instruction is known in advance: validate() proves once, at upload, that the program can neither
+ * underflow nor overflow the stack, and the interpreter runs without any runtime checks.
+ *
+ * The last instruction writes the pixel (RGB, HSV or PAL). Values are unsigned 32-bit integers
+ * with wrapping arithmetic, and color components are taken modulo 256. The output instruction's
+ * operands are handed back instead of a color, which keeps FastLED's color types out of this
+ * module and lets it run on the host.
+ */
+namespace UserEffect {
+    constexpr size_t MAX_CODE = 128; ///< Program size limit in bytes (also the per-pixel instruction bound)
+    constexpr size_t MAX_STACK = 16; ///< Evaluation stack depth
+
+    /**
+     * @brief Instruction set. Operands are popped right to left: "a b SUB" pushes a - b.
+     */
+    enum Opcode : uint8_t {
+        OP_PUSH = 0x01,      ///< Push an 8-bit immediate
+        OP_PUSH16 = 0x02,    ///< Push a 16-bit little-endian immediate
+
+        OP_TIME = 0x10,      ///< Push milliseconds since boot
+        OP_INDEX = 0x11,     ///< Push the pixel index
+        OP_COUNT = 0x12,     ///< Push the number of LEDs
+        OP_SPEED = 0x13,     ///< Push the "speed" parameter
+        OP_INTENSITY = 0x14, ///< Push the "intensity" parameter
+        OP_HUE = 0x15,       ///< Push the "hue" parameter
+
+        OP_ADD = 0x20,
+        OP_SUB = 0x21,
+        OP_MUL = 0x22,
+        OP_DIV = 0x23,       ///< Division by zero yields 0
+        OP_MOD = 0x24,       ///< Modulo by zero yields 0
+        OP_AND = 0x25,
+        OP_OR = 0x26,
+        OP_XOR = 0x27,
+        OP_SHL = 0x28,       ///< Shift count taken modulo 32
+        OP_SHR = 0x29,       ///< Shift count taken modulo 32
+        OP_MIN = 0x2A,
+        OP_MAX = 0x2B,
+        OP_LT = 0x2C,        ///< 1 if a < b, else 0
+        OP_GT = 0x2D,
+        OP_EQ = 0x2E,
+
+        OP_SEL = 0x30,       ///< "cond a b SEL" pushes a if cond is non-zero, else b
+        OP_DUP = 0x31,
+        OP_SWAP = 0x32,
+        OP_DROP = 0x33,
+
+        OP_SIN8 = 0x40,      ///< FastLED sin8 of the low byte
+        OP_COS8 = 0x41,
+        OP_NOISE = 0x42,     ///< "x y NOISE" pushes inoise8(x, y)
+        OP_SCALE8 = 0x43,    ///< "a b SCALE8" pushes a * b / 256
+
+        OP_RGB = 0x50,       ///< "r g b RGB" writes the pixel; must be last
+        OP_HSV = 0x51,       ///< "h s v HSV" writes the pixel; must be last
+        OP_PAL = 0x52,       ///< "index value PAL" writes a palette color; must be last
+    };
+
+    /**
+     * @brief Checks that a program is well formed
+     * @param code Bytecode
+     * @param length Length in bytes
+     * @return true if every opcode is known, immediates are complete, the stack stays within
+     *         MAX_STACK and the program ends with exactly one output instruction
+     */
+    bool validate(const uint8_t *code, size_t length);
+
+    /**
+     * @brief Per-frame inputs shared by every pixel
+     */
+    struct Inputs {
+        uint32_t time;
+        uint32_t count;
+        uint32_t speed;
+        uint32_t intensity;
+        uint32_t hue;
+    };
+
+    /**
+     * @brief What the output instruction of a program wrote for one pixel
+     *
+     * The operands are left for the caller to turn into a color: r g b for OP_RGB, h s v for
+     * OP_HSV, index value (in `a` and `b`) for OP_PAL.
+     */
+    struct Output {
+        uint8_t opcode;
+        uint32_t a;
+        uint32_t b;
+        uint32_t c;
+    };
+
+    /**
+     * @brief Runs a validated program for one pixel
+     *
+     * Does no checks at all: the program must have passed validate() and must not change
+     * while it runs.
+     * @param code Bytecode
+     * @param length Length in bytes
+     * @param inputs Per-frame inputs
+     * @param index Pixel index
+     */
+    Output evaluate(const uint8_t *code, size_t length, const Inputs &inputs, uint32_t index);
+}
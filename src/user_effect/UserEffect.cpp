@@ -0,0 +1,100 @@
+#include <Arduino.h>
+#include "UserEffect.h"
+#include "../settings/Settings.h"
+#include "../palettes/Palettes.h"
+#include "../switcher/Switcher.h"
+
+#define KEY_USER_EFFECT "usrfx"
+
+namespace UserEffect {
+    static const char *TAG = "USER_FX";
+
+    struct __attribute__((packed)) Program {
+        uint8_t length;
+        uint8_t code[MAX_CODE];
+    };
+
+    static_assert(MAX_CODE <= UINT8_MAX, "Program length must fit into one byte");
+
+    // Two buffers so a new upload never changes the program under the render task. The spare
+    // one is written again only after the frame that may still run it has finished.
+    static Program programs[2] = {};
+    static const Program *volatile active = nullptr;
+    static int nextProgram = 0;
+    static uint32_t retiredAt = 0; // Switcher::frameSequence() when the spare program was retired
+
+    static void activate(const uint8_t *code, size_t length) {
+        if (length == 0) {
+            active = nullptr;
+            retiredAt = Switcher::frameSequence();
+            return;
+        }
+        Switcher::waitForFrame(retiredAt);
+        Program &program = programs[nextProgram];
+        program.length = length;
+        memcpy(program.code, code, length);
+        active = &program;
+        nextProgram ^= 1;
+        retiredAt = Switcher::frameSequence();
+    }
+
+    void init() {
+        Program stored = {};
+        if (Settings::loadRecord(KEY_USER_EFFECT, &stored, sizeof(stored)) && validate(stored.code, stored.length)) {
+            activate(stored.code, stored.length);
+            ESP_LOGI(TAG, "Loaded user effect: %u bytes", stored.length);
+        }
+    }
+
+    bool store(const uint8_t *code, size_t length) {
+        if (length != 0 && !validate(code, length)) return false;
+
+        Program program = {};
+        program.length = length;
+        if (length > 0) memcpy(program.code, code, length);
+        // Only the used part of the program is written
+        if (!Settings::saveRecord(KEY_USER_EFFECT, &program, 1 + length)) return false;
+        activate(program.code, length);
+        ESP_LOGI(TAG, "User effect %s: %u bytes", length ? "saved" : "removed", (unsigned) length);
+        return true;
+    }
+
+    bool isLoaded() {
+        return active != nullptr;
+    }
+
+    size_t getLength() {
+        const Program *program = active;
+        return program ? program->length : 0;
+    }
+
+    void render(CRGB *leds, int numLeds, const Effects::Params &p) {
+        const Program *program = active;
+        if (program == nullptr) {
+            fill_solid(leds, numLeds, CRGB::Black);
+            return;
+        }
+
+        const CRGBPalette256 *palette = Palettes::active();
+        if (palette == nullptr) palette = &Palettes::party();
+        const Inputs inputs = {
+            static_cast<uint32_t>(millis()),
+            static_cast<uint32_t>(numLeds),
+            p.value[Effects::SPEED],
+            p.value[Effects::INTENSITY],
+            p.value[Effects::HUE],
+        };
+        for (int i = 0; i < numLeds; i++) {
+            const Output out = evaluate(program->code, program->length, inputs, i);
+            switch (out.opcode) {
+                case OP_RGB: leds[i] = CRGB(out.a, out.b, out.c); break;
+                case OP_HSV: leds[i] = CHSV(out.a, out.b, out.c); break;
+                case OP_PAL:
+                    leds[i] = (*palette)[static_cast<uint8_t>(out.a)];
+                    leds[i].nscale8_video(out.b);
+                    break;
+                default: leds[i] = CRGB(0, 0, 0); break;
+            }
+        }
+    }
+}
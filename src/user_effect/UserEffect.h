@@ -0,0 +1,43 @@
+#pragma once
+
+#include <FastLED.h>
+#include "../effects/Effects.h"
+#include "Bytecode.h"
+
+/**
+ * @brief The stored user effect program and its rendering
+ *
+ * See Bytecode.h for the instruction set.
+ */
+namespace UserEffect {
+    /**
+     * @brief Loads the stored program
+     */
+    void init();
+
+    /**
+     * @brief Validates, persists and activates a program
+     * @param code Bytecode, or nullptr with length 0 to remove the program
+     * @param length Length in bytes
+     * @return true if the program was valid and written
+     */
+    bool store(const uint8_t *code, size_t length);
+
+    /**
+     * @brief Whether a program is loaded
+     */
+    bool isLoaded();
+
+    /**
+     * @brief Returns the length of the loaded program in bytes (0 if none)
+     */
+    size_t getLength();
+
+    /**
+     * @brief Renders one frame of the loaded program (black if none)
+     * @param leds LED buffer
+     * @param numLeds Number of LEDs
+     * @param p Parameters of the USER mode
+     */
+    void render(CRGB *leds, int numLeds, const Effects::Params &p);
+}
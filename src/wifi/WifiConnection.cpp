@@ -0,0 +1,141 @@
+#include "WifiConnection.h"
+
+static const char *const STATE_NAMES[] = {"idle", "connecting", "connected", "wait_retry"};
+
+WifiConnection::WifiConnection(WifiDriver &driver)
+    : _driver(driver),
+      _state(IDLE),
+      _stateSince(0),
+      _retryAt(0),
+      _retryInterval(RETRY_INTERVAL_MIN_MS),
+      _outageStart(0),
+      _hasCredentials(false),
+      _apKnown(false),
+      _fastAttempt(false),
+      _skipFastAttempt(false),
+      _stats{} {
+}
+
+void WifiConnection::start(const uint32_t nowMs, const bool hasCredentials) {
+    _outageStart = nowMs;
+    _hasCredentials = hasCredentials;
+    if (hasCredentials) beginAttempt(nowMs);
+}
+
+void WifiConnection::onCredentials(const uint32_t nowMs) {
+    _hasCredentials = true;
+    _retryInterval = RETRY_INTERVAL_MIN_MS;
+    _stats.outageAttempts = 0;
+
+    if (_state == CONNECTED) {
+        // The disconnect event starts the new attempt
+        _driver.disconnect();
+    } else {
+        if (_state == CONNECTING) _driver.disconnect();
+        _outageStart = nowMs;
+        scheduleRetry(nowMs, RESTART_SETTLE_MS);
+    }
+}
+
+void WifiConnection::setApKnown(const bool known) {
+    _apKnown = known;
+}
+
+void WifiConnection::onGotIp(const uint32_t nowMs) {
+    _stats.connects++;
+    if (_fastAttempt) _stats.fastConnects++;
+    _stats.lastReconnectMs = nowMs - _outageStart;
+    _stats.outageAttempts = 0;
+    _retryInterval = RETRY_INTERVAL_MIN_MS;
+    enterState(CONNECTED, nowMs);
+}
+
+bool WifiConnection::onDisconnected(const uint32_t nowMs) {
+    switch (_state) {
+        case CONNECTED:
+            _outageStart = nowMs;
+            // Reconnect immediately; backoff only applies to repeated failures
+            scheduleRetry(nowMs, 0);
+            return true;
+        case CONNECTING:
+            failAttempt(nowMs);
+            break;
+        case IDLE:
+        case WAIT_RETRY:
+            break;
+    }
+    return false;
+}
+
+void WifiConnection::poll(const uint32_t nowMs) {
+    switch (_state) {
+        case CONNECTING: {
+            const uint32_t timeout = _fastAttempt ? FAST_CONNECT_TIMEOUT_MS : CONNECT_TIMEOUT_MS;
+            if (nowMs - _stateSince >= timeout) {
+                _driver.disconnect();
+                failAttempt(nowMs);
+            }
+            break;
+        }
+        case WAIT_RETRY:
+            if (_hasCredentials && static_cast<int32_t>(nowMs - _retryAt) >= 0) {
+                beginAttempt(nowMs);
+            }
+            break;
+        case IDLE:
+        case CONNECTED:
+            break;
+    }
+}
+
+uint32_t WifiConnection::msUntilNextAction(const uint32_t nowMs) const {
+    uint32_t due;
+    switch (_state) {
+        case CONNECTING:
+            due = _stateSince + (_fastAttempt ? FAST_CONNECT_TIMEOUT_MS : CONNECT_TIMEOUT_MS);
+            break;
+        case WAIT_RETRY:
+            if (!_hasCredentials) return NO_DEADLINE;
+            due = _retryAt;
+            break;
+        default:
+            return NO_DEADLINE;
+    }
+    const int32_t remaining = static_cast<int32_t>(due - nowMs);
+    return remaining > 0 ? static_cast<uint32_t>(remaining) : 0;
+}
+
+const char *WifiConnection::stateName(const State state) {
+    return STATE_NAMES[state];
+}
+
+void WifiConnection::enterState(const State next, const uint32_t timeMs) {
+    _state = next;
+    _stateSince = timeMs;
+}
+
+void WifiConnection::scheduleRetry(const uint32_t timeMs, const uint32_t delayMs) {
+    _retryAt = timeMs + delayMs;
+    enterState(WAIT_RETRY, timeMs);
+}
+
+void WifiConnection::beginAttempt(const uint32_t timeMs) {
+    _fastAttempt = _apKnown && !_skipFastAttempt;
+    _skipFastAttempt = false;
+    _stats.attempts++;
+    _stats.outageAttempts++;
+    _driver.begin(_fastAttempt);
+    enterState(CONNECTING, timeMs);
+}
+
+void WifiConnection::failAttempt(const uint32_t timeMs) {
+    if (_fastAttempt) {
+        // The AP may have moved to another channel: retry right away with a scan
+        _skipFastAttempt = true;
+        scheduleRetry(timeMs, RESTART_SETTLE_MS);
+        return;
+    }
+    scheduleRetry(timeMs, _retryInterval);
+    _retryInterval *= 2;
+    if (_retryInterval > RETRY_INTERVAL_MAX_MS) _retryInterval = RETRY_INTERVAL_MAX_MS;
+}
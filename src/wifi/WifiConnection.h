@@ -0,0 +1,147 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Radio operations issued by WifiConnection
+ *
+ * Completion is reported back through WifiConnection::onGotIp() and onDisconnected().
+ */
+class WifiDriver {
+public:
+    virtual ~WifiDriver() = default;
+
+    /**
+     * @brief Starts an association with the stored credentials
+     * @param fast true to use the cached BSSID and channel, false for a full channel scan
+     */
+    virtual void begin(bool fast) = 0;
+
+    /**
+     * @brief Aborts the association in flight or drops the link
+     */
+    virtual void disconnect() = 0;
+};
+
+/**
+ * @brief Wi-Fi connection state machine (idle, connecting, connected, wait_retry)
+ *
+ * Works purely on timestamps and drives the radio through a WifiDriver, so it never blocks
+ * and can be run against a simulated driver. WiFi.begin() is never re-issued while an
+ * association is in flight; a lost link is retried at once and only repeated failures back off.
+ */
+class WifiConnection {
+public:
+    enum State {
+        IDLE,       ///< No credentials, radio idle
+        CONNECTING, ///< begin() issued, waiting for an IP or a timeout
+        CONNECTED,  ///< IP obtained
+        WAIT_RETRY  ///< Waiting for the backoff interval before the next attempt
+    };
+
+    /**
+     * @brief Connection statistics
+     */
+    struct Stats {
+        uint32_t attempts;        ///< Connection attempts since boot
+        uint32_t outageAttempts;  ///< Attempts since the connection was lost
+        uint32_t connects;        ///< Successful connections since boot
+        uint32_t fastConnects;    ///< Connections made with the cached BSSID/channel
+        uint32_t lastReconnectMs; ///< Time from losing the connection (or radio start) to obtaining an IP
+    };
+
+    static constexpr uint32_t CONNECT_TIMEOUT_MS = 10000;
+    static constexpr uint32_t FAST_CONNECT_TIMEOUT_MS = 3000;
+    static constexpr uint32_t RETRY_INTERVAL_MIN_MS = 1000;
+    static constexpr uint32_t RETRY_INTERVAL_MAX_MS = 30000;
+    static constexpr uint32_t RESTART_SETTLE_MS = 100;
+    static constexpr uint32_t NO_DEADLINE = UINT32_MAX;
+
+    explicit WifiConnection(WifiDriver &driver);
+
+    /**
+     * @brief Starts connecting if credentials are stored
+     * @param nowMs Current time; the first time-to-connect is measured from here
+     * @param hasCredentials true if credentials are available
+     */
+    void start(uint32_t nowMs, bool hasCredentials);
+
+    /**
+     * @brief Takes new credentials: drops the current link or attempt and connects with them
+     * @param nowMs Current time
+     */
+    void onCredentials(uint32_t nowMs);
+
+    /**
+     * @brief Records whether a cached BSSID/channel is available for fast attempts
+     */
+    void setApKnown(bool known);
+
+    /**
+     * @brief Reports that the station obtained an IP
+     * @param nowMs Current time
+     */
+    void onGotIp(uint32_t nowMs);
+
+    /**
+     * @brief Reports a station disconnect (failed association or lost link)
+     * @param nowMs Current time
+     * @return true if an established connection was lost
+     */
+    bool onDisconnected(uint32_t nowMs);
+
+    /**
+     * @brief Advances timeouts and retries
+     * @param nowMs Current time
+     */
+    void poll(uint32_t nowMs);
+
+    /**
+     * @brief Returns how long the caller may sleep before poll() has something to do
+     * @param nowMs Current time
+     * @return Milliseconds until the next timeout or retry, or NO_DEADLINE
+     */
+    uint32_t msUntilNextAction(uint32_t nowMs) const;
+
+    State state() const { return _state; }
+
+    /**
+     * @brief Returns the name of the current state
+     */
+    const char *stateName() const { return stateName(_state); }
+
+    /**
+     * @brief Returns the name of a state
+     */
+    static const char *stateName(State state);
+
+    /**
+     * @brief Checks whether the current or last attempt used the cached BSSID/channel
+     */
+    bool isFastAttempt() const { return _fastAttempt; }
+
+    /**
+     * @brief Returns the retry delay a failed full-scan attempt waits next
+     */
+    uint32_t retryInterval() const { return _retryInterval; }
+
+    const Stats &stats() const { return _stats; }
+
+private:
+    void enterState(State next, uint32_t timeMs);
+    void scheduleRetry(uint32_t timeMs, uint32_t delayMs);
+    void beginAttempt(uint32_t timeMs);
+    void failAttempt(uint32_t timeMs);
+
+    WifiDriver &_driver;
+    State _state;
+    uint32_t _stateSince;
+    uint32_t _retryAt;
+    uint32_t _retryInterval;
+    uint32_t _outageStart;
+    bool _hasCredentials;
+    bool _apKnown;
+    bool _fastAttempt;
+    bool _skipFastAttempt;
+    Stats _stats;
+};
@@ -1,83 +1,240 @@
 #include <WiFi.h>
+#include <esp_wifi.h>
 #include "WifiManager.h"
 #include "../settings/Settings.h"
+#include "../boot/BootProfiler.h"
+#include "../events/AppEvents.h"
+#include "../parser/ResponseWriter.h"
+
+#define KEY_AP_CACHE "wifi-ap"
 
 namespace WiFiManager {
     static const char *TAG = "WIFI";
 
-    static String g_ssid;
-    static String g_password;
-    static bool hasCredentials = false;
-    static unsigned long lastWiFiReconnectAttempt = 0;
-    static unsigned long wifiReconnectInterval = 5000;
-    static int failedReconnectAttempts = 0;
+    /**
+     * Access point the device last associated with. Connecting with a known BSSID and
+     * channel skips the full channel scan.
+     */
+    struct __attribute__((packed)) ApCache {
+        uint8_t bssid[6];
+        uint8_t channel;
+    };
+
+    static char g_ssid[Settings::SSID_SIZE] = "";
+    static char g_password[Settings::PASSWORD_SIZE] = "";
+    static bool radioStarted = false;
     static WifiStatusCallback statusCallback = nullptr;
 
+    static PowerProfile powerProfile = LOW_LATENCY;
+    static bool modemSleep = true;
+
+    static ApCache apCache = {};
+    static bool apCacheValid = false;
+
+    // Raised from the Wi-Fi event task, consumed in handleReconnect()
+    static volatile bool gotIpEvent = false;
+    static volatile bool disconnectEvent = false;
+    static volatile uint8_t disconnectReason = 0;
+
+    /**
+     * Arduino WiFi behind the connection state machine.
+     */
+    class ArduinoWifiDriver : public WifiDriver {
+    public:
+        void begin(bool fast) override {
+            // A disconnect raised by aborting the previous attempt must not fail this one
+            disconnectEvent = false;
+            if (fast) {
+                ESP_LOGI(TAG, "Connecting to %s (channel %d, cached BSSID)...", g_ssid, apCache.channel);
+                WiFi.begin(g_ssid, g_password, apCache.channel, apCache.bssid);
+            } else {
+                ESP_LOGI(TAG, "Connecting to %s (full scan)...", g_ssid);
+                WiFi.begin(g_ssid, g_password);
+            }
+        }
+
+        void disconnect() override {
+            WiFi.disconnect();
+        }
+    };
+
+    static ArduinoWifiDriver driver;
+    static WifiConnection connection(driver);
+
     static void WiFiGotIP(WiFiEvent_t event, WiFiEventInfo_t info) {
-        ESP_LOGI(TAG, "WiFi connected, IP: %s", WiFi.localIP().toString().c_str());
-        String response = "{\"status\":\"Success\",\"ip\":\"" + WiFi.localIP().toString() + "\"}";
-        if (statusCallback) statusCallback(true, response);
+        gotIpEvent = true;
+        AppEvents::notify(AppEvents::WIFI);
     }
 
     static void WiFiStationDisconnected(WiFiEvent_t event, WiFiEventInfo_t info) {
-        ESP_LOGW(TAG, "Disconnected from WiFi. Reason: %d", info.wifi_sta_disconnected.reason);
-        String response = "{\"status\":\"Failure\"}";
-        if (statusCallback) statusCallback(false, response);
+        disconnectReason = info.wifi_sta_disconnected.reason;
+        disconnectEvent = true;
+        AppEvents::notify(AppEvents::WIFI);
     }
 
-    void init(WifiStatusCallback callback) {
-        statusCallback = callback;
-        WiFi.mode(WIFI_STA);
-        WiFi.disconnect(true);
-        delay(100);
+    /**
+     * Logs the transition the state machine made from `before`, with the retry delay it chose.
+     */
+    static void logTransition(WifiConnection::State before, unsigned long now) {
+        const WifiConnection::State after = connection.state();
+        if (after == before) return;
+        if (after == WifiConnection::WAIT_RETRY && before == WifiConnection::CONNECTING) {
+            ESP_LOGI(TAG, "Connection attempt failed, retry in %lu ms%s",
+                     (unsigned long) connection.msUntilNextAction(now), connection.isFastAttempt() ? " with a scan" : "");
+        } else {
+            ESP_LOGD(TAG, "State %s -> %s", WifiConnection::stateName(before), connection.stateName());
+        }
+    }
+
+    static void updateApCache() {
+        const uint8_t *bssid = WiFi.BSSID();
+        const int32_t channel = WiFi.channel();
+        if (bssid == nullptr || channel <= 0) return;
+
+        if (apCacheValid && apCache.channel == channel && memcmp(apCache.bssid, bssid, sizeof(apCache.bssid)) == 0) {
+            return;
+        }
+        memcpy(apCache.bssid, bssid, sizeof(apCache.bssid));
+        apCache.channel = channel;
+        apCacheValid = true;
+        connection.setApKnown(true);
+        Settings::saveRecord(KEY_AP_CACHE, &apCache, sizeof(apCache));
+        ESP_LOGI(TAG, "Cached AP %02X:%02X:%02X:%02X:%02X:%02X on channel %d",
+                 bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5], apCache.channel);
+    }
+
+    static void onGotIp(unsigned long now) {
+        BootProfiler::mark(BootProfiler::WIFI_CONNECTED);
+        const IPAddress ip = WiFi.localIP();
+        ESP_LOGI(TAG, "WiFi connected, IP: %u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+
+        connection.onGotIp(now);
+        updateApCache();
+
+        char buffer[48];
+        ResponseWriter response(buffer, sizeof(buffer));
+        response.add("{\"status\":\"Success\",\"ip\":\"").addIp(static_cast<uint32_t>(ip)).add("\"}");
+        if (statusCallback) statusCallback(true, response.c_str());
+    }
+
+    static void onDisconnected(unsigned long now) {
+        const WifiConnection::State before = connection.state();
+        if (connection.onDisconnected(now)) {
+            ESP_LOGW(TAG, "Disconnected from WiFi. Reason: %d", disconnectReason);
+            if (statusCallback) statusCallback(false, "{\"status\":\"Failure\"}");
+        } else {
+            ESP_LOGD(TAG, "Association failed. Reason: %d", disconnectReason);
+            logTransition(before, now);
+        }
+    }
+
+    static void applyPowerProfile() {
+        // LOW_LATENCY keeps the receiver on so commands are not held back until the next DTIM beacon
+        wifi_ps_type_t ps = powerProfile == LOW_LATENCY ? WIFI_PS_NONE : WIFI_PS_MAX_MODEM;
+        const esp_err_t err = esp_wifi_set_ps(ps);
+        if (err != ESP_OK) {
+            // Modem sleep is mandatory while BLE shares the radio
+            ESP_LOGW(TAG, "Failed to set power save mode %d: %d", ps, err);
+            esp_wifi_get_ps(&ps);
+        }
+        modemSleep = ps != WIFI_PS_NONE;
+        ESP_LOGI(TAG, "Power profile: %s (modem sleep %s)",
+                 powerProfile == LOW_LATENCY ? "low_latency" : "power_save", modemSleep ? "on" : "off");
+    }
+
+    /**
+     * Brings the radio up. Deferred out of setup() so the strip lights up before any radio work.
+     */
+    static void startRadio() {
+        radioStarted = true;
+        // Credentials and reconnects are managed here; keep the driver from doing either on its own
+        WiFi.persistent(false);
+        WiFi.setAutoReconnect(false);
         WiFi.onEvent(WiFiGotIP, WiFiEvent_t::ARDUINO_EVENT_WIFI_STA_GOT_IP);
         WiFi.onEvent(WiFiStationDisconnected, WiFiEvent_t::ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+        WiFi.mode(WIFI_STA);
+        applyPowerProfile();
 
-        if (Settings::getWiFiCredentials(g_ssid, g_password)) {
-            ESP_LOGI(TAG, "Stored credentials found, connecting...");
-            WiFi.begin(g_ssid.c_str(), g_password.c_str());
-            hasCredentials = true;
-        }
+        apCacheValid = Settings::loadRecord(KEY_AP_CACHE, &apCache, sizeof(apCache)) && apCache.channel > 0;
+
+        connection.setApKnown(apCacheValid);
+
+        const bool hasCredentials = Settings::getWiFiCredentials(g_ssid, g_password);
+        if (hasCredentials) ESP_LOGI(TAG, "Stored credentials found, connecting...");
+        connection.start(millis(), hasCredentials);
+        BootProfiler::mark(BootProfiler::WIFI_STARTED);
     }
 
-    void connect(const String &ssid, const String &password) {
-        ESP_LOGI(TAG, "Connecting to %s...", ssid.c_str());
-        g_ssid = ssid;
-        g_password = password;
+    void init(WifiStatusCallback callback) {
+        statusCallback = callback;
+    }
 
-        WiFi.disconnect(true);
-        delay(500);
-        WiFi.begin(ssid.c_str(), password.c_str());
-        hasCredentials = true;
-        failedReconnectAttempts = 0;
-        wifiReconnectInterval = 5000;
+    void connect(const char *ssid, const char *password) {
+        if (!radioStarted) startRadio();
+        ESP_LOGI(TAG, "New credentials for %s", ssid);
+
+        if (strcmp(ssid, g_ssid) != 0) {
+            apCacheValid = false;
+            connection.setApKnown(false);
+        }
+        strlcpy(g_ssid, ssid, sizeof(g_ssid));
+        strlcpy(g_password, password, sizeof(g_password));
+        // When connected, the disconnect event stops the servers and starts the new attempt
+        connection.onCredentials(millis());
     }
 
     void handleReconnect() {
-        if (hasCredentials && WiFi.status() != WL_CONNECTED) {
-            unsigned long currentMillis = millis();
-            if (currentMillis - lastWiFiReconnectAttempt >= wifiReconnectInterval) {
-                lastWiFiReconnectAttempt = currentMillis;
-
-                ESP_LOGI(TAG, "Attempting to reconnect...");
-                WiFi.begin(g_ssid.c_str(), g_password.c_str());
-
-                failedReconnectAttempts++;
-                if (wifiReconnectInterval < 60000) {
-                    wifiReconnectInterval *= 2;
-                    if (wifiReconnectInterval > 60000) wifiReconnectInterval = 60000;
-                }
-            }
-        } else if (WiFi.status() == WL_CONNECTED) {
-            if (failedReconnectAttempts > 0) {
-                ESP_LOGI(TAG, "WiFi Reconnected!");
-                failedReconnectAttempts = 0;
-                wifiReconnectInterval = 5000;
-            }
+        if (!radioStarted) {
+            startRadio();
+            return;
+        }
+
+        const unsigned long now = millis();
+        if (disconnectEvent) {
+            disconnectEvent = false;
+            onDisconnected(now);
+        }
+        if (gotIpEvent) {
+            gotIpEvent = false;
+            onGotIp(now);
         }
+
+        const WifiConnection::State before = connection.state();
+        connection.poll(now);
+        logTransition(before, now);
+    }
+
+    uint32_t msUntilNextAction() {
+        if (!radioStarted) return 0;
+
+        const uint32_t wait = connection.msUntilNextAction(millis());
+        return wait == WifiConnection::NO_DEADLINE ? AppEvents::NO_DEADLINE : wait;
     }
 
     bool isConnected() {
-        return WiFi.status() == WL_CONNECTED;
+        return connection.state() == WifiConnection::CONNECTED;
+    }
+
+    void setPowerProfile(PowerProfile profile) {
+        // Re-applying the same profile retries WIFI_PS_NONE once BLE has released the radio
+        if (profile == powerProfile && modemSleep == (profile == POWER_SAVE)) return;
+        powerProfile = profile;
+        if (radioStarted) applyPowerProfile();
+    }
+
+    PowerProfile getPowerProfile() {
+        return powerProfile;
+    }
+
+    bool isModemSleepEnabled() {
+        return modemSleep;
+    }
+
+    const char *getStateName() {
+        return connection.stateName();
+    }
+
+    Stats getStats() {
+        return connection.stats();
     }
 }
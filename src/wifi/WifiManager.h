@@ -1,37 +1,90 @@
 #pragma once
 
+#include "WifiConnection.h"
+
 /**
  * @brief Callback type for Wi-Fi connection status changes
  * @param connected true if connected to Wi-Fi
  * @param message Status message or assigned IP address
  */
-typedef void (*WifiStatusCallback)(bool connected, const String &message);
+typedef void (*WifiStatusCallback)(bool connected, const char *message);
+
+/**
+ * @brief Radio power profiles
+ */
+enum PowerProfile {
+    LOW_LATENCY, ///< Modem sleep off: commands are received immediately (system on)
+    POWER_SAVE   ///< Maximum modem sleep: radio wakes only for DTIM beacons (system off)
+};
 
 /**
  * @brief Management of Wi-Fi connection and reconnection logic
+ *
+ * Runs a WifiConnection state machine (idle, connecting, connected, wait_retry) from
+ * handleReconnect() on top of the Arduino WiFi driver. The BSSID and channel of the last
+ * access point are cached so that reconnects skip the channel scan.
  */
 namespace WiFiManager {
+    /// Connection statistics, see WifiConnection::Stats
+    using Stats = WifiConnection::Stats;
+
     /**
      * @brief Initializes the Wi-Fi manager with a status callback
+     *
+     * The radio itself is brought up on the first handleReconnect() call, so that
+     * setup() can light the strip without waiting for Wi-Fi.
      * @param callback Callback function for connection updates
      */
     void init(WifiStatusCallback callback);
 
     /**
-     * @brief Connects to a Wi-Fi network with given credentials
-     * @param ssid Network SSID
-     * @param password Network password
+     * @brief Connects to a Wi-Fi network with given credentials (does not block)
+     * @param ssid Network SSID, shorter than Settings::SSID_SIZE
+     * @param password Network password, shorter than Settings::PASSWORD_SIZE
      */
-    void connect(const String &ssid, const String &password);
+    void connect(const char *ssid, const char *password);
 
     /**
-     * @brief Handles automatic reconnection if the connection is lost
+     * @brief Starts the radio on first call, then advances the connection state machine
      */
     void handleReconnect();
 
+    /**
+     * @brief Returns how long until handleReconnect() has a timer to act on
+     * @return Milliseconds until the next timeout or retry, or AppEvents::NO_DEADLINE
+     */
+    uint32_t msUntilNextAction();
+
     /**
      * @brief Checks if device is currently connected to Wi-Fi
      * @return true if connected
      */
     bool isConnected();
+
+    /**
+     * @brief Selects the radio power profile; applied immediately or when the radio starts
+     * @param profile Power profile
+     */
+    void setPowerProfile(PowerProfile profile);
+
+    /**
+     * @brief Returns the selected power profile
+     */
+    PowerProfile getPowerProfile();
+
+    /**
+     * @brief Checks whether modem sleep is actually active (BLE coexistence may force it on)
+     * @return true if the radio is allowed to sleep between beacons
+     */
+    bool isModemSleepEnabled();
+
+    /**
+     * @brief Returns the name of the current connection state
+     */
+    const char *getStateName();
+
+    /**
+     * @brief Returns connection statistics
+     */
+    Stats getStats();
 }
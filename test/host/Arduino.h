@@ -0,0 +1,49 @@
+#pragma once
+
+/*
+ * Host stand-in for the parts of the Arduino core that firmware headers and the modules
+ * built under env:native use. Time is simulated: tests set hostMillis.
+ */
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+using std::max;
+using std::min;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+class String;
+
+inline uint32_t hostMillis = 0;
+
+inline unsigned long millis() {
+    return hostMillis;
+}
+
+inline unsigned long micros() {
+    return hostMillis * 1000UL;
+}
+
+/// Heap figures of the device; a test that reads them defines the members
+struct EspClass {
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+};
+
+extern EspClass ESP;
+
+/// Log output is dropped; the arguments are still evaluated, as with a raised log level
+inline void hostLog(const char *, const char *, ...) {
+}
+
+#define ESP_LOGE(tag, ...) hostLog(tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) hostLog(tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) hostLog(tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) hostLog(tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) hostLog(tag, __VA_ARGS__)
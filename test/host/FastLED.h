@@ -0,0 +1,66 @@
+#pragma once
+
+/*
+ * Host stand-in for the FastLED types that firmware headers name. Rendering code is not built
+ * on the host; kernels that tests exercise work on plain RGB bytes, and the few 8-bit math
+ * helpers they call are below.
+ */
+
+#include <Arduino.h>
+
+struct CRGB {
+    union {
+        struct {
+            uint8_t r;
+            uint8_t g;
+            uint8_t b;
+        };
+        uint8_t raw[3];
+    };
+
+    CRGB() = default;
+    constexpr CRGB(uint8_t red, uint8_t green, uint8_t blue) : r(red), g(green), b(blue) {}
+};
+
+class CRGBPalette256;
+
+/// FastLED's scale8 with FASTLED_SCALE8_FIXED: 255 scales to the value itself
+inline uint8_t scale8(uint8_t i, uint8_t scale) {
+    return (static_cast<uint16_t>(i) * (1 + scale)) >> 8;
+}
+
+/// FastLED's sin8_C: four linear sections per quarter wave
+inline uint8_t sin8(uint8_t theta) {
+    static const uint8_t B_M16[] = {0, 49, 49, 41, 90, 27, 117, 10};
+    uint8_t offset = theta;
+    if (theta & 0x40) offset = 255 - offset;
+    offset &= 0x3F;
+    uint8_t secoffset = offset & 0x0F;
+    if (theta & 0x40) secoffset++;
+    const uint8_t section = offset >> 4;
+    const uint8_t mx = (B_M16[section * 2 + 1] * secoffset) >> 4;
+    int8_t y = mx + B_M16[section * 2];
+    if (theta & 0x80) y = -y;
+    return y + 128;
+}
+
+inline uint8_t cos8(uint8_t theta) {
+    return sin8(theta + 64);
+}
+
+/// Smooth 2D value noise in place of FastLED's Perlin noise: same range and scale (one lattice
+/// cell per 256 units), different values
+inline uint8_t inoise8(uint16_t x, uint16_t y) {
+    auto lattice = [](uint32_t cx, uint32_t cy) -> uint32_t {
+        uint32_t h = cx * 0x9E3779B1u ^ cy * 0x85EBCA77u;
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        return (h >> 24) & 0xFF;
+    };
+    auto ease = [](uint32_t t) -> uint32_t { return (t * t * (768 - 2 * t)) >> 16; };
+    const uint32_t fx = ease(x & 0xFF);
+    const uint32_t fy = ease(y & 0xFF);
+    const uint32_t top = lattice(x >> 8, y >> 8) * (256 - fx) + lattice((x >> 8) + 1, y >> 8) * fx;
+    const uint32_t bottom = lattice(x >> 8, (y >> 8) + 1) * (256 - fx) + lattice((x >> 8) + 1, (y >> 8) + 1) * fx;
+    return (top * (256 - fy) + bottom * fy) >> 16;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+/*
+ * Host stand-in for the FreeRTOS types that firmware headers name.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef uint32_t EventBits_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
@@ -0,0 +1,265 @@
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <vector>
+#include "animation/AnimationCodec.h"
+
+/*
+ * Animation container validation and frame decoding. The container is written to a file and
+ * mapped read-only, standing in for the memory-mapped "anim" partition the firmware plays from.
+ */
+
+using namespace Animation;
+
+static constexpr int NUM_LEDS = 256;
+static constexpr uint32_t FRAME_COUNT = 600;
+static constexpr uint32_t KEY_FRAME_INTERVAL = 60;
+
+using Frame = std::vector<uint8_t>;
+
+/**
+ * Frame n of the test animation: a comet over a two-colour background that flips every
+ * 100 frames, so there are long runs (RLE), small changes (DELTA) and key frames (RAW).
+ */
+static Frame sourceFrame(uint32_t n) {
+    Frame rgb(NUM_LEDS * 3);
+    const uint8_t background = (n / 100) % 2 ? 0x20 : 0x00;
+    for (int i = 0; i < NUM_LEDS; i++) {
+        rgb[i * 3] = background;
+        rgb[i * 3 + 1] = i < NUM_LEDS / 2 ? 0x10 : 0x00;
+        rgb[i * 3 + 2] = background;
+    }
+    const int head = (n * 3) % NUM_LEDS;
+    for (int t = 0; t < 12 && head - t >= 0; t++) {
+        rgb[(head - t) * 3] = 255 - t * 20;
+        rgb[(head - t) * 3 + 1] = 128 - t * 10;
+    }
+    return rgb;
+}
+
+static void appendFrame(std::vector<uint8_t> &out, FrameType type, const std::vector<uint8_t> &payload) {
+    out.push_back(type);
+    out.push_back(payload.size() & 0xFF);
+    out.push_back(payload.size() >> 8);
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+static std::vector<uint8_t> encodeRle(const Frame &rgb) {
+    std::vector<uint8_t> payload;
+    for (int i = 0; i < NUM_LEDS;) {
+        int run = 1;
+        while (i + run < NUM_LEDS && run < 255 && memcmp(&rgb[i * 3], &rgb[(i + run) * 3], 3) == 0) run++;
+        payload.push_back(run);
+        payload.insert(payload.end(), &rgb[i * 3], &rgb[i * 3] + 3);
+        i += run;
+    }
+    return payload;
+}
+
+static std::vector<uint8_t> encodeDelta(const Frame &previous, const Frame &rgb) {
+    std::vector<uint8_t> payload;
+    int pixel = 0;
+    int i = 0;
+    while (i < NUM_LEDS) {
+        if (memcmp(&previous[i * 3], &rgb[i * 3], 3) == 0) {
+            i++;
+            continue;
+        }
+        int skip = i - pixel;
+        while (skip > 255) {
+            payload.push_back(255);
+            payload.push_back(0);
+            skip -= 255;
+        }
+        int count = 0;
+        while (i + count < NUM_LEDS && count < 255 && memcmp(&previous[(i + count) * 3], &rgb[(i + count) * 3], 3) != 0) {
+            count++;
+        }
+        payload.push_back(skip);
+        payload.push_back(count);
+        payload.insert(payload.end(), &rgb[i * 3], &rgb[(i + count) * 3]);
+        i += count;
+        pixel = i;
+    }
+    return payload;
+}
+
+/**
+ * Encodes the test animation the way an uploader would: a key frame every KEY_FRAME_INTERVAL
+ * frames, otherwise whichever of RLE and DELTA is smaller.
+ */
+static std::vector<uint8_t> buildContainer(uint32_t frameCount) {
+    std::vector<uint8_t> data;
+    Frame previous;
+    for (uint32_t n = 0; n < frameCount; n++) {
+        const Frame rgb = sourceFrame(n);
+        if (n % KEY_FRAME_INTERVAL == 0) {
+            appendFrame(data, FRAME_RAW, rgb);
+        } else {
+            const std::vector<uint8_t> rle = encodeRle(rgb);
+            const std::vector<uint8_t> delta = encodeDelta(previous, rgb);
+            if (delta.size() < rle.size()) {
+                appendFrame(data, FRAME_DELTA, delta);
+            } else {
+                appendFrame(data, FRAME_RLE, rle);
+            }
+        }
+        previous = rgb;
+    }
+
+    const Header header = {MAGIC, VERSION, 30, NUM_LEDS, frameCount, static_cast<uint32_t>(data.size())};
+    std::vector<uint8_t> container(sizeof(header) + data.size());
+    memcpy(container.data(), &header, sizeof(header));
+    memcpy(container.data() + sizeof(header), data.data(), data.size());
+    return container;
+}
+
+/**
+ * Read-only file mapping of a container, like the partition mapping on the device.
+ */
+struct MappedFile {
+    explicit MappedFile(const std::vector<uint8_t> &bytes) : size(bytes.size()) {
+        FILE *file = tmpfile();
+        fwrite(bytes.data(), 1, bytes.size(), file);
+        fflush(file);
+        void *memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        fclose(file);
+        data = memory == MAP_FAILED ? nullptr : static_cast<const uint8_t *>(memory);
+    }
+
+    ~MappedFile() {
+        if (data != nullptr) munmap(const_cast<uint8_t *>(data), size);
+    }
+
+    const uint8_t *data;
+    size_t size;
+};
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+static void test_decoded_frames_match_source() {
+    const MappedFile file(buildContainer(FRAME_COUNT));
+    TEST_ASSERT_TRUE(file.data != nullptr);
+    uint32_t badFrame = 0;
+    TEST_ASSERT_TRUE(validateContainer(file.data, file.size, badFrame));
+
+    const uint8_t *data = file.data + sizeof(Header);
+    const size_t dataLength = file.size - sizeof(Header);
+    uint8_t rgb[NUM_LEDS * 3] = {};
+    size_t cursor = 0;
+    for (uint32_t n = 0; n < FRAME_COUNT; n++) {
+        cursor += decodeFrame(data + cursor, dataLength - cursor, rgb, NUM_LEDS);
+        TEST_ASSERT_EQUAL_MEMORY(sourceFrame(n).data(), rgb, sizeof(rgb));
+    }
+    TEST_ASSERT_EQUAL_UINT32(dataLength, cursor);
+}
+
+static void test_shorter_strip_drops_extra_pixels() {
+    const std::vector<uint8_t> container = buildContainer(KEY_FRAME_INTERVAL);
+    const uint8_t *data = container.data() + sizeof(Header);
+    const size_t dataLength = container.size() - sizeof(Header);
+    constexpr int SHORT_STRIP = 100;
+    uint8_t rgb[SHORT_STRIP * 3 + 3];
+    memset(rgb, 0xA5, sizeof(rgb));
+
+    size_t cursor = 0;
+    for (uint32_t n = 0; n < KEY_FRAME_INTERVAL; n++) {
+        cursor += decodeFrame(data + cursor, dataLength - cursor, rgb, SHORT_STRIP);
+        TEST_ASSERT_EQUAL_MEMORY(sourceFrame(n).data(), rgb, SHORT_STRIP * 3);
+    }
+    const uint8_t guard[3] = {0xA5, 0xA5, 0xA5};
+    TEST_ASSERT_EQUAL_MEMORY(guard, rgb + SHORT_STRIP * 3, 3);
+}
+
+static void test_malformed_containers_are_rejected() {
+    const std::vector<uint8_t> good = buildContainer(10);
+    uint32_t badFrame = 0;
+    TEST_ASSERT_TRUE(validateContainer(good.data(), good.size(), badFrame));
+
+    // Truncated: the length in the header no longer matches
+    TEST_ASSERT_FALSE(validateContainer(good.data(), good.size() - 1, badFrame));
+    TEST_ASSERT_FALSE(validateContainer(good.data(), sizeof(Header) - 1, badFrame));
+
+    std::vector<uint8_t> wrongMagic = good;
+    wrongMagic[0] ^= 0xFF;
+    TEST_ASSERT_FALSE(validateContainer(wrongMagic.data(), wrongMagic.size(), badFrame));
+
+    // An RLE run of zero pixels: the background flip at frame 100 is stored as RLE
+    const std::vector<uint8_t> flip = buildContainer(101);
+    size_t offset = sizeof(Header);
+    for (uint32_t n = 0; n < 100; n++) offset += FRAME_HEADER_SIZE + (flip[offset + 1] | (flip[offset + 2] << 8));
+    std::vector<uint8_t> zeroRun = flip;
+    TEST_ASSERT_EQUAL_INT(FRAME_RLE, zeroRun[offset]);
+    zeroRun[offset + FRAME_HEADER_SIZE] = 0;
+    TEST_ASSERT_FALSE(validateContainer(zeroRun.data(), zeroRun.size(), badFrame));
+    TEST_ASSERT_EQUAL_UINT32(100, badFrame);
+
+    // A delta frame needs a previous frame
+    std::vector<uint8_t> deltaFirst = good;
+    deltaFirst[sizeof(Header)] = FRAME_DELTA;
+    TEST_ASSERT_FALSE(validateContainer(deltaFirst.data(), deltaFirst.size(), badFrame));
+    TEST_ASSERT_EQUAL_UINT32(0, badFrame);
+}
+
+static void test_decoder_stays_in_bounds_on_garbage() {
+    // The decoder trusts no length: random frames must neither read past `available` nor
+    // write past the strip
+    uint32_t seed = 12345;
+    auto next = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<uint8_t>(seed >> 24);
+    };
+    constexpr int LEDS = 20;
+    for (int round = 0; round < 20000; round++) {
+        std::vector<uint8_t> frame(1 + next() % 64);
+        for (uint8_t &byte : frame) byte = next();
+        frame[0] %= 3;
+        uint8_t rgb[LEDS * 3 + 3];
+        memset(rgb, 0xA5, sizeof(rgb));
+
+        const size_t size = decodeFrame(frame.data(), frame.size(), rgb, LEDS);
+        TEST_ASSERT_TRUE(size <= frame.size());
+        TEST_ASSERT_EQUAL_UINT8(0xA5, rgb[LEDS * 3]);
+        TEST_ASSERT_EQUAL_UINT8(0xA5, rgb[LEDS * 3 + 2]);
+    }
+}
+
+static void test_decode_throughput() {
+    const std::vector<uint8_t> container = buildContainer(FRAME_COUNT);
+    const MappedFile file(container);
+    const uint8_t *data = file.data + sizeof(Header);
+    const size_t dataLength = file.size - sizeof(Header);
+    uint8_t rgb[NUM_LEDS * 3] = {};
+
+    constexpr int LOOPS = 50;
+    const auto start = std::chrono::steady_clock::now();
+    for (int loop = 0; loop < LOOPS; loop++) {
+        size_t cursor = 0;
+        for (uint32_t n = 0; n < FRAME_COUNT; n++) cursor += decodeFrame(data + cursor, dataLength - cursor, rgb, NUM_LEDS);
+    }
+    const double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    char message[160];
+    snprintf(message, sizeof(message), "%d LEDs: %.3f us/frame, %.1f MB/s of frame data, %.1f%% of raw size",
+             NUM_LEDS, elapsedUs / (LOOPS * FRAME_COUNT), dataLength * LOOPS / elapsedUs,
+             100.0 * dataLength / (FRAME_COUNT * (FRAME_HEADER_SIZE + NUM_LEDS * 3)));
+    TEST_MESSAGE(message);
+    // The last frame decoded must still be right after all the loops
+    TEST_ASSERT_EQUAL_MEMORY(sourceFrame(FRAME_COUNT - 1).data(), rgb, sizeof(rgb));
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_decoded_frames_match_source);
+    RUN_TEST(test_shorter_strip_drops_extra_pixels);
+    RUN_TEST(test_malformed_containers_are_rejected);
+    RUN_TEST(test_decoder_stays_in_bounds_on_garbage);
+    RUN_TEST(test_decode_throughput);
+    return UNITY_END();
+}
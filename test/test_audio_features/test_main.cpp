@@ -0,0 +1,269 @@
+#include <unity.h>
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+#include "audio/AudioFeatures.h"
+
+/*
+ * Feature packets replayed with network jitter against a renderer reading at 60 fps, and the
+ * sequence lock hammered from two threads.
+ *
+ * The stream is what a client analysing 120 bpm music sends: one packet per 23 ms analysis
+ * frame, a beat every 500 ms. Every packet carries its own sequence number in its bands, so a
+ * frame read back can be matched to the packet it came from and checked for tearing.
+ */
+
+using namespace AudioFeatures;
+
+static constexpr uint32_t PACKET_INTERVAL_MS = 23;
+static constexpr uint32_t BEAT_INTERVAL_MS = 500;
+static constexpr uint32_t RENDER_INTERVAL_US = 16667;
+
+struct Packet {
+    uint8_t bytes[PACKET_SIZE];
+    uint32_t sentAt;
+    uint32_t arrivesAt;
+    bool beat;
+};
+
+static uint32_t randomState = 1;
+
+static uint32_t random32() {
+    randomState = randomState * 1664525u + 1013904223u;
+    return randomState >> 8;
+}
+
+static void encode(uint8_t *bytes, uint16_t seq, bool beat, uint8_t peak) {
+    bytes[0] = 'A';
+    bytes[1] = 'F';
+    bytes[2] = PACKET_VERSION;
+    bytes[3] = seq & 0xFF;
+    bytes[4] = seq >> 8;
+    bytes[5] = beat ? FLAG_BEAT : 0;
+    bytes[6] = peak;
+    bytes[7] = 0;
+    bytes[8] = seq & 0xFF;
+    bytes[9] = seq >> 8;
+    for (size_t band = 2; band < NUM_BANDS; band++) bytes[8 + band] = (seq * 7 + band * 31) & 0xFF;
+}
+
+/**
+ * Sequence number of the packet a frame came from, or -1 if the bands mix several packets.
+ */
+static int32_t frameSeq(const Frame &frame) {
+    const uint16_t seq = frame.bands[0] | (frame.bands[1] << 8);
+    for (size_t band = 2; band < NUM_BANDS; band++) {
+        if (frame.bands[band] != ((seq * 7 + band * 31) & 0xFF)) return -1;
+    }
+    return seq;
+}
+
+/**
+ * Sends `durationMs` of stream starting at `startMs`, each packet delayed by 2 ms plus up to
+ * `jitterMs`; `lossPercent` of the packets are lost and as many are delivered twice.
+ * @return Packets in arrival order
+ */
+static std::vector<Packet> capture(uint32_t startMs, uint32_t durationMs, uint16_t firstSeq, uint32_t jitterMs,
+                                   uint32_t lossPercent) {
+    std::vector<Packet> packets;
+    uint16_t seq = firstSeq;
+    uint32_t nextBeat = startMs;
+    for (uint32_t sent = startMs; sent < startMs + durationMs; sent += PACKET_INTERVAL_MS, seq++) {
+        Packet packet;
+        packet.sentAt = sent;
+        packet.beat = sent >= nextBeat;
+        if (packet.beat) nextBeat += BEAT_INTERVAL_MS;
+        encode(packet.bytes, seq, packet.beat, packet.beat ? 255 : 96);
+        packet.arrivesAt = sent + 2 + random32() % (jitterMs + 1);
+        const uint32_t fate = random32() % 100;
+        if (fate < lossPercent) continue;
+        packets.push_back(packet);
+        if (fate >= 100 - lossPercent) {
+            packet.arrivesAt += random32() % 20;
+            packets.push_back(packet);
+        }
+    }
+    std::stable_sort(packets.begin(), packets.end(),
+                     [](const Packet &a, const Packet &b) { return a.arrivesAt < b.arrivesAt; });
+    return packets;
+}
+
+/**
+ * What the renderer saw over a replay.
+ */
+struct Replay {
+    uint32_t frames;
+    uint32_t freshFrames;
+    uint32_t torn;        ///< Frames mixing two packets
+    uint32_t backwards;   ///< Frames older than the one before
+    uint32_t beatEdges;   ///< Changes of the beat counter, as audio_pulse counts them
+    uint32_t beatsArrived; ///< Beat packets that made it, duplicates counted once
+    uint32_t beatsCounted; ///< Growth of the beat counter
+    uint32_t maxAgeMs;    ///< Time from sending a packet to rendering it, worst case
+    uint64_t totalAgeMs;
+};
+
+/**
+ * Delivers the packets at their arrival times and reads at 60 fps like the audio effects do,
+ * from `startMs` until `endMs`. `streamStartMs` and `firstSeq` date the packets by sequence.
+ */
+static Replay replay(const std::vector<Packet> &packets, uint32_t startMs, uint32_t endMs, uint32_t streamStartMs,
+                     uint16_t firstSeq) {
+    Replay result = {};
+    std::set<uint16_t> beatSeqs;
+    size_t next = 0;
+    int32_t lastSeq = -1;
+    Frame frame;
+    hostMillis = startMs;
+    read(frame);
+    const uint32_t firstBeats = frame.beats;
+    uint32_t lastBeats = frame.beats;
+
+    for (uint64_t renderUs = static_cast<uint64_t>(startMs) * 1000; renderUs < static_cast<uint64_t>(endMs) * 1000;
+         renderUs += RENDER_INTERVAL_US) {
+        const uint32_t now = renderUs / 1000;
+        while (next < packets.size() && packets[next].arrivesAt <= now) {
+            hostMillis = packets[next].arrivesAt;
+            if (packets[next].beat) beatSeqs.insert(packets[next].bytes[3] | (packets[next].bytes[4] << 8));
+            publish(packets[next].bytes, PACKET_SIZE);
+            next++;
+        }
+        hostMillis = now;
+        result.frames++;
+        const bool fresh = read(frame);
+        if (frame.beats != lastBeats) result.beatEdges++;
+        lastBeats = frame.beats;
+        if (!fresh) continue;
+
+        result.freshFrames++;
+        const int32_t seq = frameSeq(frame);
+        if (seq < 0) {
+            result.torn++;
+            continue;
+        }
+        if (seq < lastSeq) result.backwards++;
+        lastSeq = seq;
+        const uint32_t sentAt = streamStartMs + static_cast<uint16_t>(seq - firstSeq) * PACKET_INTERVAL_MS;
+        const uint32_t age = now - sentAt;
+        result.totalAgeMs += age;
+        if (age > result.maxAgeMs) result.maxAgeMs = age;
+    }
+    result.beatsArrived = beatSeqs.size();
+    result.beatsCounted = lastBeats - firstBeats;
+    return result;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+static void test_rejects_malformed_packets() {
+    const Stats before = getStats();
+    uint8_t bytes[PACKET_SIZE + 1];
+    encode(bytes, 1, false, 0);
+    TEST_ASSERT_TRUE(isPacket(bytes, PACKET_SIZE));
+    TEST_ASSERT_FALSE(isPacket(bytes, 1));
+    TEST_ASSERT_FALSE(publish(bytes, PACKET_SIZE - 1));
+    TEST_ASSERT_FALSE(publish(bytes, PACKET_SIZE + 1));
+    bytes[2] = PACKET_VERSION + 1;
+    TEST_ASSERT_FALSE(publish(bytes, PACKET_SIZE));
+    TEST_ASSERT_EQUAL_UINT32(before.malformed + 3, getStats().malformed);
+    TEST_ASSERT_EQUAL_UINT32(before.packets, getStats().packets);
+}
+
+static void test_jittered_stream() {
+    constexpr uint32_t START = 10000;
+    constexpr uint32_t DURATION = 30000;
+    constexpr uint32_t JITTER_MS = 40;
+    const Stats before = getStats();
+    const std::vector<Packet> packets = capture(START, DURATION, 100, JITTER_MS, 2);
+    const Replay result = replay(packets, START + 100, START + DURATION, START, 100);
+
+    char message[160];
+    snprintf(message, sizeof(message), "jitter 0-%u ms: frame age %.1f ms mean, %u ms max; %u beats, %u packets dropped",
+             (unsigned) JITTER_MS, static_cast<double>(result.totalAgeMs) / result.freshFrames,
+             (unsigned) result.maxAgeMs, (unsigned) result.beatsCounted, (unsigned) (getStats().dropped - before.dropped));
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_EQUAL_UINT32(result.frames, result.freshFrames);
+    TEST_ASSERT_EQUAL_UINT32(0, result.torn);
+    TEST_ASSERT_EQUAL_UINT32(0, result.backwards);
+    // Reordered and duplicated packets are dropped, never shown
+    TEST_ASSERT_TRUE(getStats().dropped > before.dropped);
+    // Every beat that arrived flashes exactly once, even when its packet was overtaken
+    TEST_ASSERT_EQUAL_UINT32(result.beatsArrived, result.beatsCounted);
+    TEST_ASSERT_EQUAL_UINT32(result.beatsCounted, result.beatEdges);
+    // Jitter delays the picture by no more than a few analysis frames
+    TEST_ASSERT_TRUE(result.maxAgeMs <= 2 + JITTER_MS + 3 * PACKET_INTERVAL_MS);
+}
+
+static void test_pause_reads_silence_and_resumes() {
+    constexpr uint32_t START = 60000;
+    const std::vector<Packet> first = capture(START, 2000, 5000, 0, 0);
+    replay(first, START, START + 2000, START, 5000);
+
+    Frame frame;
+    hostMillis = START + 2000 + STALE_MS - 100;
+    TEST_ASSERT_TRUE(read(frame));
+    const uint32_t beats = frame.beats;
+
+    // The client stopped: silence after STALE_MS, with the beat counter kept
+    hostMillis = START + 2000 + STALE_MS + 20;
+    TEST_ASSERT_FALSE(read(frame));
+    TEST_ASSERT_EQUAL_UINT8(0, frame.peak);
+    TEST_ASSERT_EQUAL_UINT8(0, frame.bands[3]);
+    TEST_ASSERT_EQUAL_UINT32(beats, frame.beats);
+
+    // A restarted client counts from 0 again; its packets are not taken for late ones
+    const uint32_t resume = START + 5000;
+    const std::vector<Packet> second = capture(resume, 2000, 0, 10, 0);
+    const Replay result = replay(second, resume, resume + 2000, resume, 0);
+    TEST_ASSERT_EQUAL_UINT32(0, result.backwards);
+    TEST_ASSERT_EQUAL_UINT32(result.beatsArrived, result.beatsCounted);
+    TEST_ASSERT_TRUE(result.freshFrames + 2 >= result.frames);
+}
+
+static void test_seqlock_under_concurrent_writes() {
+    // The renderer must never see half of one packet and half of the next
+    constexpr uint32_t PACKETS = 200000;
+    hostMillis = 200000;
+    std::atomic<bool> done{false};
+    std::thread writer([&done]() {
+        uint8_t bytes[PACKET_SIZE];
+        for (uint32_t i = 1; i <= PACKETS; i++) {
+            encode(bytes, static_cast<uint16_t>(i), false, i & 0xFF);
+            publish(bytes, PACKET_SIZE);
+        }
+        done = true;
+    });
+
+    uint32_t reads = 0;
+    uint32_t torn = 0;
+    Frame frame;
+    while (!done) {
+        if (read(frame) && (frameSeq(frame) < 0 || (frameSeq(frame) & 0xFF) != frame.peak)) torn++;
+        reads++;
+    }
+    writer.join();
+
+    char message[96];
+    snprintf(message, sizeof(message), "%u reads during %u writes", (unsigned) reads, (unsigned) PACKETS);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_TRUE(read(frame));
+    TEST_ASSERT_EQUAL_INT(PACKETS & 0xFFFF, frameSeq(frame));
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_rejects_malformed_packets);
+    RUN_TEST(test_jittered_stream);
+    RUN_TEST(test_pause_reads_silence_and_resumes);
+    RUN_TEST(test_seqlock_under_concurrent_writes);
+    return UNITY_END();
+}
@@ -0,0 +1,153 @@
+#include <unity.h>
+#include "button/ButtonClassifier.h"
+
+/*
+ * Table-driven tests of ButtonClassifier: each case feeds a synthetic (bouncing) edge stream
+ * and lists the actions it must produce, with the time poll() reports each one at.
+ */
+
+struct Edge {
+    uint32_t timeMs;
+    bool pressed;
+};
+
+struct Expected {
+    ButtonAction action;
+    uint32_t atMs;
+};
+
+struct Case {
+    const char *name;
+    Edge edges[12];
+    uint8_t edgeCount;
+    Expected actions[8];
+    uint8_t actionCount;
+};
+
+static constexpr uint32_t RUN_MS = 8000;
+
+static const Case CASES[] = {
+    {"bounce_only",
+     {{100, true}, {110, false}, {120, true}, {130, false}}, 4,
+     {}, 0},
+    {"short",
+     {{100, true}, {300, false}}, 2,
+     {{SHORT_PRESS, 600}}, 1},
+    {"short_bouncing",
+     {{100, true}, {103, false}, {106, true}, {300, false}, {304, true}, {308, false}}, 6,
+     {{SHORT_PRESS, 608}}, 1},
+    {"medium",
+     {{100, true}, {1600, false}}, 2,
+     {{MEDIUM_PRESS, 1650}}, 1},
+    {"medium_boundary",
+     {{100, true}, {1100, false}}, 2,
+     {{MEDIUM_PRESS, 1150}}, 1},
+    {"long_while_held",
+     {{100, true}, {7000, false}}, 2,
+     {{LONG_PRESS, 5100}}, 1},
+    {"long_bouncing_release",
+     {{100, true}, {5100, false}, {5102, true}, {5104, false}}, 4,
+     {{LONG_PRESS, 5100}}, 1},
+    {"double_click",
+     {{100, true}, {200, false}, {350, true}, {450, false}}, 4,
+     {{DOUBLE_CLICK, 500}}, 1},
+    {"double_click_bouncing",
+     {{100, true}, {102, false}, {104, true}, {200, false}, {350, true}, {351, false}, {353, true}, {450, false}}, 8,
+     {{DOUBLE_CLICK, 500}}, 1},
+    {"two_shorts_too_far_apart",
+     {{100, true}, {200, false}, {600, true}, {700, false}}, 4,
+     {{SHORT_PRESS, 500}, {SHORT_PRESS, 1000}}, 2},
+    {"hold_repeat",
+     {{100, true}, {200, false}, {350, true}, {1200, false}}, 4,
+     {{HOLD_REPEAT, 750}, {HOLD_REPEAT, 900}, {HOLD_REPEAT, 1050}, {HOLD_REPEAT, 1200}}, 4},
+    {"hold_repeat_stops_at_release_edge",
+     {{100, true}, {200, false}, {350, true}, {1000, false}}, 4,
+     {{HOLD_REPEAT, 750}, {HOLD_REPEAT, 900}}, 2},
+};
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+/**
+ * Feeds the edges of a case and polls every `pollEveryMs` until RUN_MS.
+ * @return Number of actions written to `actions`
+ */
+static uint8_t run(const Case &c, uint32_t pollEveryMs, Expected *actions, uint8_t capacity) {
+    ButtonClassifier classifier;
+    uint8_t next = 0;
+    uint8_t count = 0;
+    for (uint32_t now = 0; now <= RUN_MS; now += pollEveryMs) {
+        while (next < c.edgeCount && c.edges[next].timeMs <= now) {
+            classifier.onEdge(c.edges[next].pressed, c.edges[next].timeMs);
+            next++;
+        }
+        for (ButtonAction action = classifier.poll(now); action != NO_ACTION; action = classifier.poll(now)) {
+            if (count < capacity) actions[count] = {action, now};
+            count++;
+        }
+    }
+    return count;
+}
+
+static void test_edge_sequences() {
+    for (const Case &c : CASES) {
+        Expected actions[8];
+        const uint8_t count = run(c, 1, actions, 8);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(c.actionCount, count, c.name);
+        for (uint8_t i = 0; i < count; i++) {
+            TEST_ASSERT_EQUAL_INT_MESSAGE(c.actions[i].action, actions[i].action, c.name);
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(c.actions[i].atMs, actions[i].atMs, c.name);
+        }
+    }
+}
+
+static void test_poll_rate_does_not_change_gestures() {
+    // Durations come from the edge timestamps, so a slow poller sees the same gestures
+    for (const Case &c : CASES) {
+        Expected actions[8];
+        const uint8_t count = run(c, 37, actions, 8);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(c.actionCount, count, c.name);
+        for (uint8_t i = 0; i < count; i++) {
+            TEST_ASSERT_EQUAL_INT_MESSAGE(c.actions[i].action, actions[i].action, c.name);
+        }
+    }
+}
+
+static void test_deadline_matches_next_action() {
+    // Sleeping exactly msUntilDeadline() between polls must not miss or delay any action
+    for (const Case &c : CASES) {
+        ButtonClassifier classifier;
+        uint8_t next = 0;
+        uint8_t count = 0;
+        uint32_t now = 0;
+        while (now <= RUN_MS) {
+            while (next < c.edgeCount && c.edges[next].timeMs <= now) {
+                classifier.onEdge(c.edges[next].pressed, c.edges[next].timeMs);
+                next++;
+            }
+            for (ButtonAction action = classifier.poll(now); action != NO_ACTION; action = classifier.poll(now)) {
+                TEST_ASSERT_TRUE_MESSAGE(count < c.actionCount, c.name);
+                TEST_ASSERT_EQUAL_INT_MESSAGE(c.actions[count].action, action, c.name);
+                TEST_ASSERT_EQUAL_UINT32_MESSAGE(c.actions[count].atMs, now, c.name);
+                count++;
+            }
+            // The next edge is an interrupt: it wakes the caller early
+            uint32_t wake = classifier.msUntilDeadline(now);
+            wake = wake == ButtonClassifier::NO_DEADLINE ? RUN_MS + 1 : now + (wake > 0 ? wake : 1);
+            if (next < c.edgeCount && c.edges[next].timeMs < wake) wake = c.edges[next].timeMs;
+            now = wake;
+        }
+        TEST_ASSERT_EQUAL_INT_MESSAGE(c.actionCount, count, c.name);
+    }
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_edge_sequences);
+    RUN_TEST(test_poll_rate_does_not_change_gestures);
+    RUN_TEST(test_deadline_matches_next_action);
+    return UNITY_END();
+}
@@ -0,0 +1,150 @@
+#include <Arduino.h>
+#include <wifi/WifiManager.h>
+#include "settings/Settings.h"
+#include "switcher/Switcher.h"
+#include "effects/Effects.h"
+#include "boot/BootProfiler.h"
+#include "presets/Presets.h"
+#include "palettes/Palettes.h"
+#include "user_effect/UserEffect.h"
+#include "layout/Layout.h"
+#include "animation/Animation.h"
+#include "groups/Groups.h"
+#include "bluetooth/Bluetooth.h"
+#include "events/AppEvents.h"
+#include "tasks/Tasks.h"
+#include "fakes.h"
+
+/*
+ * Stand-ins for the modules DataParser drives. They keep just enough state for the commands
+ * to succeed and for the tests to see what was applied; none of them allocates.
+ */
+
+FakeState fake = {};
+
+namespace Effects {
+    bool isAvailable(Mode mode) { return mode >= 0 && mode < NUM_MODES && mode != ANIMATION; }
+    uint8_t renderDivisor(Mode) { return 1; }
+}
+
+namespace Settings {
+    void setWiFiCredentials(const char *ssid, const char *) { snprintf(fake.ssid, sizeof(fake.ssid), "%s", ssid); }
+    void saveLightMode(int) { fake.saves++; }
+    void saveSystemState(bool) { fake.saves++; }
+    void saveBrightness(int) { fake.saves++; }
+    void saveNumLeds(int) { fake.saves++; }
+    void saveBleRelease(bool) { fake.saves++; }
+    void saveDither(bool) { fake.saves++; }
+    void savePalette(int) { fake.saves++; }
+    void saveEffectParams(const uint8_t *, size_t) { fake.saves++; }
+    void saveStrip(uint8_t, uint8_t, bool) { fake.saves++; }
+    bool isBleReleaseEnabled() { return false; }
+    uint8_t getChipset() { return 0; }
+    Stats getStats() { return {fake.saves, fake.saves * 24}; }
+    Stats getLifetimeStats() { return {fake.saves, fake.saves * 24}; }
+}
+
+namespace Switcher {
+    void setMode(Effects::Mode) {}
+    void setSystemOff(bool) {}
+    void setBrightness(int value) { fake.brightness = value; }
+    int getBrightness() { return fake.brightness; }
+    void setNumLeds(int) {}
+    int getNumLeds() { return 60; }
+    void setDithering(bool) {}
+    bool isDithering() { return true; }
+    void setScene(Effects::Mode, int, bool, const Effects::Params *, bool) {}
+    void setColorOrder(ColorOrder, bool) {}
+    bool parseOrder(const char *, ColorOrder &) { return false; }
+    bool parseChipset(const char *, Chipset &) { return false; }
+    const char *chipsetName(uint8_t) { return "ws2812b"; }
+    const char *orderName(uint8_t) { return "grb"; }
+    Chipset getChipset() { return CHIPSET_WS2812B; }
+    ColorOrder getColorOrder() { return ORDER_GRB; }
+    bool hasWhiteChannel() { return false; }
+    OutputStats getOutputStats() { return {}; }
+}
+
+namespace WiFiManager {
+    void connect(const char *, const char *) { fake.connects++; }
+    bool isConnected() { return true; }
+    const char *getStateName() { return "connected"; }
+    PowerProfile getPowerProfile() { return LOW_LATENCY; }
+    void setPowerProfile(PowerProfile) {}
+    bool isModemSleepEnabled() { return true; }
+    Stats getStats() { return {}; }
+}
+
+namespace Palettes {
+    bool store(int, const Stop *, size_t) { return true; }
+    bool select(int) { return true; }
+    int getSelected() { return NONE; }
+    size_t getStopCount(int) { return 0; }
+}
+
+namespace Groups {
+    static uint32_t membership = 0;
+
+    bool isMember(int group) { return group >= 0 && group < MAX_GROUPS && (membership & (1u << group)); }
+    void setMembership(uint32_t mask) { membership = mask; }
+    bool clockMs(uint64_t &) { return false; }
+    bool schedule(uint64_t, const char *, size_t) { return false; }
+    size_t pendingCount() { return 0; }
+}
+
+namespace Tasks {
+    size_t getStats(TaskStats *out, size_t max) {
+        static const char *const NAMES[] = {"loopTask", "effects", "udp", "tcp", "IDLE0", "IDLE1", "Tmr Svc", "ipc0"};
+        size_t count = 0;
+        for (; count < max && count < sizeof(NAMES) / sizeof(NAMES[0]); count++) {
+            out[count] = {};
+            out[count].name = NAMES[count];
+            out[count].stackFree = 1024;
+        }
+        return count;
+    }
+
+    bool hasRuntimeStats() { return true; }
+}
+
+namespace Presets {
+    const Preset *get(int) { return nullptr; }
+    bool save(int, const char *, Effects::Mode, int, const Effects::Params &, const Layout::Config *) { return false; }
+    bool remove(int) { return false; }
+}
+
+namespace Layout {
+    bool setStrip() { return true; }
+    bool setGrid(int, int, bool, int) { return true; }
+    bool stage(const Config &) { return true; }
+    bool storeMapChunk(size_t, const uint8_t *, size_t, size_t, int, bool &) { return false; }
+    View current(int numLeds) { return {static_cast<uint16_t>(numLeds), 1, nullptr, static_cast<uint16_t>(numLeds)}; }
+    Config getConfig() { return {}; }
+    const char *typeName(uint8_t) { return "strip"; }
+}
+
+namespace UserEffect {
+    bool store(const uint8_t *, size_t) { return false; }
+    size_t getLength() { return 0; }
+}
+
+namespace Animation {
+    bool beginUpload(size_t) { return false; }
+    bool writeChunk(size_t, const uint8_t *, size_t) { return false; }
+    bool finishUpload(uint32_t) { return false; }
+    Info getInfo() { return {}; }
+}
+
+namespace BootProfiler {
+    uint32_t elapsedUs(Phase phase) { return 1000 * (phase + 1); }
+    const char *name(Phase) { return "phase"; }
+}
+
+namespace AppEvents {
+    Stats getStats() { return {}; }
+}
+
+namespace Bluetooth {
+    void releaseMemory() {}
+    MemoryStats getMemoryStats() { return {}; }
+}
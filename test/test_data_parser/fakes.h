@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * What the fake modules were asked to do.
+ */
+struct FakeState {
+    int brightness;
+    uint32_t saves;
+    uint32_t connects;
+    char ssid[33];
+};
+
+extern FakeState fake;
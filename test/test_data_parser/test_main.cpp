@@ -0,0 +1,193 @@
+#include <unity.h>
+#include <chrono>
+#include <cstddef>
+#include <new>
+#include <stdio.h>
+#include <string.h>
+#include "fakes.h"
+
+/*
+ * DataParser::parse against fake modules, counting every heap allocation of the process: the
+ * parser and the command handlers must run on the bump arena and the reply buffer alone.
+ * The parser is compiled into this test only, so the other host tests need no fakes.
+ */
+#include "parser/DataParser.cpp"
+
+static uint64_t allocations = 0;
+static size_t liveBytes = 0;
+static size_t peakBytes = 0;
+
+// Each block carries its size in front, so frees can be accounted
+static constexpr size_t BLOCK_HEADER = alignof(std::max_align_t);
+
+void *operator new(size_t size) {
+    uint8_t *block = static_cast<uint8_t *>(malloc(size + BLOCK_HEADER));
+    if (block == nullptr) throw std::bad_alloc();
+    *reinterpret_cast<size_t *>(block) = size;
+    allocations++;
+    liveBytes += size;
+    if (liveBytes > peakBytes) peakBytes = liveBytes;
+    return block + BLOCK_HEADER;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    if (ptr == nullptr) return;
+    uint8_t *block = static_cast<uint8_t *>(ptr) - BLOCK_HEADER;
+    liveBytes -= *reinterpret_cast<size_t *>(block);
+    free(block);
+}
+
+void operator delete[](void *ptr) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+// The heap figures get_status reports, over a nominal 200 KB heap
+static constexpr uint32_t HEAP_SIZE = 200 * 1024;
+EspClass ESP;
+
+uint32_t EspClass::getFreeHeap() {
+    return HEAP_SIZE - liveBytes;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    return HEAP_SIZE - peakBytes;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+    return HEAP_SIZE - liveBytes;
+}
+
+static Effects::Mode currentMode = Effects::RAINBOW;
+static bool systemOff = false;
+static char buffer[Board::TRAITS.replyBufferSize];
+
+struct Command {
+    const char *text;
+    bool success;
+};
+
+/// The mix the soak cycles through: every reply-building command, rejects and parse errors
+static const Command COMMANDS[] = {
+    {"{\"cmd\":\"set_mode\",\"mode\":3,\"id\":1}", true},
+    {"{\"cmd\":\"set_brightness\",\"value\":128}", true},
+    {"{\"cmd\":\"get_status\"}", true},
+    {"{\"cmd\":\"get_status\",\"tasks\":1,\"id\":4294967295}", true},
+    {"{\"cmd\":\"set_param\",\"param\":\"speed\",\"value\":20}", true},
+    {"{\"cmd\":\"get_params\",\"mode\":2}", true},
+    {"{\"cmd\":\"set_wifi\",\"ssid\":\"HomeNetwork\",\"pass\":\"correct horse battery staple\"}", true},
+    {"{\"cmd\":\"set_palette\",\"slot\":1,\"stops\":[[0,255,0,0],[128,0,255,0],[255,0,0,255]]}", true},
+    {"{\"cmd\":\"set_groups\",\"groups\":[1,3,5]}", true},
+    {"{\"cmd\":\"get_groups\"}", true},
+    {"{\"cmd\":\"get_logs\",\"max\":32}", true},
+    {"{\"cmd\":\"set_power\",\"state\":1}", true},
+    {"  {\"cmd\":\"set_brightness\",\"value\":51}\r\n", true},
+    {"{\"cmd\":\"set_brightness\",\"value\":300}", false},
+    {"{\"cmd\":\"set_mode\",\"mode\":\"fast\"}", false},
+    {"{\"cmd\":\"no_such_command\"}", false},
+    {"{\"cmd\":\"set_mode\",", false},
+    {"[1,2,3]", false},
+    {"{\"cmd\":\"set_brightness\",\"value\":10,\"group\":7}", false},
+};
+static constexpr size_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+static bool run(const char *text, ResponseWriter &reply) {
+    reply.clear();
+    return DataParser::parse(text, strlen(text), reply);
+}
+
+void setUp() {
+    DataParser::setContext(&currentMode, &systemOff);
+    fake = {};
+    hostMillis = 0;
+}
+
+void tearDown() {
+}
+
+static void test_replies() {
+    ResponseWriter reply(buffer, sizeof(buffer));
+    TEST_ASSERT_TRUE(run("{\"cmd\":\"set_brightness\",\"value\":77,\"id\":9}", reply));
+    TEST_ASSERT_EQUAL_STRING("{\"id\":9,\"status\":\"Success\"}", reply.c_str());
+    TEST_ASSERT_EQUAL_INT(77, fake.brightness);
+
+    TEST_ASSERT_FALSE(run("{\"cmd\":\"set_brightness\",\"value\":256}", reply));
+    TEST_ASSERT_EQUAL_STRING("{\"status\":\"Failure\"}", reply.c_str());
+
+    TEST_ASSERT_FALSE(run("{\"cmd\":", reply));
+    TEST_ASSERT_EQUAL_STRING("{\"status\":\"Failure\"}", reply.c_str());
+
+    TEST_ASSERT_TRUE(run("{\"cmd\":\"get_params\",\"mode\":0}", reply));
+    TEST_ASSERT_TRUE(strncmp("{\"status\":\"Success\",\"mode\":0,\"params\":[{\"name\":\"speed\"", reply.c_str(), 50) == 0);
+}
+
+static void test_set_wifi_checks_lengths() {
+    ResponseWriter reply(buffer, sizeof(buffer));
+    TEST_ASSERT_TRUE(run("{\"cmd\":\"set_wifi\",\"ssid\":\"abcdefghijklmnopqrstuvwxyz012345\"}", reply));
+    TEST_ASSERT_EQUAL_STRING("abcdefghijklmnopqrstuvwxyz012345", fake.ssid);
+    TEST_ASSERT_EQUAL_UINT32(1, fake.connects);
+
+    // 33-byte SSID, empty SSID, 65-character password
+    TEST_ASSERT_FALSE(run("{\"cmd\":\"set_wifi\",\"ssid\":\"abcdefghijklmnopqrstuvwxyz0123456\"}", reply));
+    TEST_ASSERT_FALSE(run("{\"cmd\":\"set_wifi\",\"ssid\":\"\"}", reply));
+    TEST_ASSERT_FALSE(run("{\"cmd\":\"set_wifi\",\"ssid\":\"Home\",\"pass\":"
+                          "\"0123456789012345678901234567890123456789012345678901234567890123X\"}", reply));
+    TEST_ASSERT_EQUAL_UINT32(1, fake.connects);
+}
+
+static void test_truncated_reply_keeps_status() {
+    char small[96];
+    ResponseWriter reply(small, sizeof(small));
+    TEST_ASSERT_TRUE(run("{\"cmd\":\"get_status\",\"id\":5}", reply));
+    TEST_ASSERT_EQUAL_STRING("{\"id\":5,\"status\":\"Success\",\"truncated\":1}", reply.c_str());
+}
+
+static void test_soak_does_not_allocate() {
+    // One million commands; the first round warms up anything that is set up lazily
+    constexpr uint32_t TOTAL = 1000000;
+    ResponseWriter reply(buffer, sizeof(buffer));
+    for (const Command &command : COMMANDS) run(command.text, reply);
+
+    const uint64_t allocationsBefore = allocations;
+    const uint32_t freeBefore = ESP.getFreeHeap();
+    const uint32_t largestBefore = ESP.getMaxAllocHeap();
+    uint32_t failures = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < TOTAL; i++) {
+        const Command &command = COMMANDS[i % COMMAND_COUNT];
+        hostMillis = i / 10;
+        // A leak in the arena would show up as parse errors once it runs full
+        if (run(command.text, reply) != command.success) failures++;
+        TEST_ASSERT_TRUE(!reply.overflowed());
+    }
+    const double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    char message[128];
+    snprintf(message, sizeof(message), "%u commands: %.2f us/command, %llu allocations", (unsigned) TOTAL,
+             elapsedUs / TOTAL, (unsigned long long) (allocations - allocationsBefore));
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_UINT32(0, failures);
+    TEST_ASSERT_EQUAL_UINT32(0, allocations - allocationsBefore);
+    TEST_ASSERT_EQUAL_UINT32(freeBefore, ESP.getFreeHeap());
+    TEST_ASSERT_EQUAL_UINT32(largestBefore, ESP.getMaxAllocHeap());
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_replies);
+    RUN_TEST(test_set_wifi_checks_lengths);
+    RUN_TEST(test_truncated_reply_keeps_status);
+    RUN_TEST(test_soak_does_not_allocate);
+    return UNITY_END();
+}
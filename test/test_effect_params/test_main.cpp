@@ -0,0 +1,176 @@
+#include <unity.h>
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include "effects/Effects.h"
+
+/*
+ * The effect parameter table, and whether reading a parameter in a render loop costs anything
+ * over the literal it replaced. The loops are host copies of the inner loops of fire and rows,
+ * once with the former constants and once reading the mode's Params.
+ *
+ * Params are bytes, so every byte written to the LEDs may alias them: read inside the loop, a
+ * parameter is loaded again for every pixel, and the loop is not vectorised. The effects copy
+ * their parameters into locals first; the third loop shows what that saves.
+ */
+
+using namespace Effects;
+
+static constexpr int NUM_LEDS = 256;
+
+template <bool FIXED>
+static void fireLoop(uint8_t *out, uint32_t ms, const Params &p) {
+    const uint32_t time = static_cast<uint64_t>(ms) * (FIXED ? 4 : p.value[SPEED]) / 16;
+    const uint8_t hue = FIXED ? 10 : p.value[HUE];
+    for (int i = 0; i < NUM_LEDS; i++) {
+        const uint8_t level = inoise8(i * 60, time);
+        const uint8_t noise = level > 16 ? level - 16 : 0;
+        out[i * 3] = hue + noise / 8;
+        out[i * 3 + 1] = 255;
+        out[i * 3 + 2] = noise;
+    }
+}
+
+// rows on a 16 x 16 matrix: one palette color per row, written through the layout's cell map
+static constexpr int GRID_ROWS = 16;
+static uint8_t palette[256 * 3];
+static uint16_t cells[NUM_LEDS];
+
+template <bool FIXED>
+static void rowsLoop(uint8_t *out, uint32_t ms, const Params &p) {
+    const uint8_t offset = static_cast<uint64_t>(ms) * (FIXED ? 16 : p.value[SPEED]) / 256;
+    const uint8_t hue = FIXED ? 0 : p.value[HUE];
+    const uint8_t spread = FIXED ? 24 : p.value[INTENSITY];
+    for (int y = 0; y < GRID_ROWS; y++) {
+        const uint8_t *color = palette + static_cast<uint8_t>(hue + y * spread - offset) * 3;
+        for (int x = 0; x < NUM_LEDS / GRID_ROWS; x++) {
+            uint8_t *led = out + cells[y * GRID_ROWS + x] * 3;
+            led[0] = color[0];
+            led[1] = color[1];
+            led[2] = color[2];
+        }
+    }
+}
+
+/// rows as first written, reading the parameters inside the loops
+static void rowsLoopUncached(uint8_t *out, uint32_t ms, const Params &p) {
+    const uint8_t offset = static_cast<uint64_t>(ms) * p.value[SPEED] / 256;
+    for (int y = 0; y < GRID_ROWS; y++) {
+        const uint8_t *color = palette + static_cast<uint8_t>(p.value[HUE] + y * p.value[INTENSITY] - offset) * 3;
+        for (int x = 0; x < NUM_LEDS / GRID_ROWS; x++) {
+            uint8_t *led = out + cells[y * GRID_ROWS + x] * 3;
+            led[0] = color[0];
+            led[1] = color[1];
+            led[2] = color[2];
+        }
+    }
+}
+
+using Loop = void (*)(uint8_t *, uint32_t, const Params &);
+
+/**
+ * One timed run, in ns per pixel.
+ */
+static double timeLoop(Loop loop, const Params &p) {
+    constexpr int FRAMES = 2000;
+    uint8_t out[NUM_LEDS * 3];
+    const auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++) loop(out, frame * 16, p);
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / (static_cast<double>(FRAMES) * NUM_LEDS);
+}
+
+/**
+ * Best of interleaved runs of each loop, so a busy host slows both alike.
+ */
+static void timeLoops(const Loop *loops, double *bestNs, size_t count, const Params &p) {
+    for (size_t i = 0; i < count; i++) bestNs[i] = 1e9;
+    for (int run = 0; run < 15; run++) {
+        for (size_t i = 0; i < count; i++) bestNs[i] = std::min(bestNs[i], timeLoop(loops[i], p));
+    }
+}
+
+void setUp() {
+    initParams(nullptr, 0);
+}
+
+void tearDown() {
+}
+
+static void test_table_is_consistent() {
+    for (int mode = 0; mode < NUM_MODES; mode++) {
+        for (int param = 0; param < NUM_PARAMS; param++) {
+            const ParamSpec &spec = getParamSpec(static_cast<Mode>(mode), static_cast<Param>(param));
+            if (!spec.used) continue;
+            TEST_ASSERT_TRUE(spec.min <= spec.def && spec.def <= spec.max);
+            TEST_ASSERT_EQUAL_UINT8(spec.def, getParams(static_cast<Mode>(mode)).value[param]);
+        }
+    }
+    // The former constants of the loops below
+    TEST_ASSERT_EQUAL_UINT8(4, getParams(FIRE).value[SPEED]);
+    TEST_ASSERT_EQUAL_UINT8(10, getParams(FIRE).value[HUE]);
+    TEST_ASSERT_EQUAL_UINT8(24, getParams(Effects::ROWS).value[INTENSITY]);
+}
+
+static void test_set_and_restore() {
+    TEST_ASSERT_TRUE(setParam(FIRE, SPEED, 64));
+    TEST_ASSERT_FALSE(setParam(FIRE, SPEED, 65));
+    TEST_ASSERT_FALSE(setParam(FIRE, SPEED, 0));
+    TEST_ASSERT_FALSE(setParam(FIRE, INTENSITY, 10));
+    TEST_ASSERT_FALSE(setParam(NUM_MODES, SPEED, 10));
+    TEST_ASSERT_EQUAL_UINT8(64, getParams(FIRE).value[SPEED]);
+
+    Param param;
+    TEST_ASSERT_TRUE(parseParam("intensity", param));
+    TEST_ASSERT_EQUAL_STRING("intensity", paramName(param));
+    TEST_ASSERT_FALSE(parseParam("brightness", param));
+    TEST_ASSERT_FALSE(parseParam(nullptr, param));
+
+    // Stored values come back; one out of range falls back to its default
+    uint8_t stored[PARAMS_STORAGE_SIZE];
+    memcpy(stored, rawParams(), NUM_MODES * NUM_PARAMS);
+    stored[FIRE * NUM_PARAMS + HUE] = 99;
+    stored[RAINBOW * NUM_PARAMS + SPEED] = 200;
+    initParams(stored, sizeof(stored));
+    TEST_ASSERT_EQUAL_UINT8(64, getParams(FIRE).value[SPEED]);
+    TEST_ASSERT_EQUAL_UINT8(99, getParams(FIRE).value[HUE]);
+    TEST_ASSERT_EQUAL_UINT8(getParamSpec(RAINBOW, SPEED).def, getParams(RAINBOW).value[SPEED]);
+
+    // A block from a build with fewer modes is not trusted
+    initParams(stored, NUM_MODES * NUM_PARAMS - 1);
+    TEST_ASSERT_EQUAL_UINT8(4, getParams(FIRE).value[SPEED]);
+}
+
+static void test_parameters_cost_nothing() {
+    // A serpentine matrix
+    for (int i = 0; i < NUM_LEDS * 3; i++) palette[i % (256 * 3)] = i * 7;
+    for (int y = 0; y < GRID_ROWS; y++) {
+        for (int x = 0; x < NUM_LEDS / GRID_ROWS; x++) cells[y * GRID_ROWS + x] = y * GRID_ROWS + (y % 2 ? GRID_ROWS - 1 - x : x);
+    }
+
+    const Loop fire[] = {fireLoop<true>, fireLoop<false>};
+    double fireNs[2];
+    timeLoops(fire, fireNs, 2, getParams(FIRE));
+    const Loop rows[] = {rowsLoop<true>, rowsLoop<false>, rowsLoopUncached};
+    double rowsNs[3];
+    timeLoops(rows, rowsNs, 3, getParams(Effects::ROWS));
+
+    char message[200];
+    snprintf(message, sizeof(message),
+             "ns/pixel with constants, parameters: fire %.2f, %.2f (%+.0f%%); rows %.2f, %.2f (%+.0f%%), "
+             "%.2f reading Params in the loop",
+             fireNs[0], fireNs[1], 100 * (fireNs[1] / fireNs[0] - 1), rowsNs[0], rowsNs[1],
+             100 * (rowsNs[1] / rowsNs[0] - 1), rowsNs[2]);
+    TEST_MESSAGE(message);
+    // Timer noise on a shared host is a few percent
+    TEST_ASSERT_TRUE(fireNs[1] < fireNs[0] * 1.15);
+    TEST_ASSERT_TRUE(rowsNs[1] < rowsNs[0] * 1.15);
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_table_is_consistent);
+    RUN_TEST(test_set_and_restore);
+    RUN_TEST(test_parameters_cost_nothing);
+    return UNITY_END();
+}
@@ -0,0 +1,173 @@
+#include <unity.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include "event_log/EventLog.h"
+
+/*
+ * The event ring, and what recording an event costs against the ESP_LOGD line it replaced on
+ * the UDP path. ESP_LOG formats the line, prefix included, and hands it to the console; the
+ * stand-in below does the same into a discarded stream. Both run on the host, so the ratio is
+ * what carries over. The console itself is not modelled: at 115200 baud the line also takes
+ * its bytes times 87 us on the UART once the TX FIFO is full, which the ring never pays.
+ */
+
+using namespace EventLog;
+
+static constexpr uint32_t UART_BAUD = 115200;
+static constexpr uint32_t REMOTE_IP = 192 | 168 << 8 | 1 << 16 | 23 << 24; // 192.168.1.23, as IPAddress stores it
+static constexpr uint32_t REMOTE_PORT = 4210;
+static const char *const MESSAGE = "{\"cmd\":\"set_mode\",\"mode\":3}";
+
+static FILE *console;
+
+/**
+ * ESP_LOGD as esp_log_write() runs it: the "D (time) tag: " prefix, the message, a newline.
+ * @return Bytes written to the console
+ */
+static int espLog(const char *tag, const char *format, ...) {
+    char line[256];
+    int length = snprintf(line, sizeof(line), "D (%u) %s: ", static_cast<unsigned>(millis()), tag);
+    va_list args;
+    va_start(args, format);
+    length += vsnprintf(line + length, sizeof(line) - length, format, args);
+    va_end(args);
+    line[length++] = '\n';
+    fwrite(line, 1, length, console);
+    return length;
+}
+
+/**
+ * The removed UDP log: the remote address turned into text, then the formatted line.
+ */
+static int udpReceivedLog(const char *message, uint32_t ip) {
+    char remote[16];
+    snprintf(remote, sizeof(remote), "%u.%u.%u.%u", ip & 0xFF, (ip >> 8) & 0xFF, (ip >> 16) & 0xFF, ip >> 24);
+    return espLog("UDP", "UDP Received: %s from %s", message, remote);
+}
+
+static size_t formatAll(uint32_t since, char *buffer, size_t capacity, uint32_t &lost, uint32_t &next) {
+    ResponseWriter out(buffer, capacity);
+    next = format(since, CAPACITY, out, 0, lost);
+    return out.length();
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+static void test_events_are_formatted_on_read() {
+    hostMillis = 1234;
+    const uint32_t since = head();
+    log(UDP_COMMAND, strlen(MESSAGE), REMOTE_IP, REMOTE_PORT);
+    log(SAVE_STRIP, 1, 2, 1);
+
+    char buffer[512];
+    uint32_t lost;
+    uint32_t next;
+    formatAll(since, buffer, sizeof(buffer), lost, next);
+    TEST_ASSERT_EQUAL_UINT32(0, lost);
+    TEST_ASSERT_EQUAL_UINT32(since + 2, next);
+    char expected[200];
+    snprintf(expected, sizeof(expected),
+             "{\"seq\":%u,\"t\":1234,\"tag\":\"UDP\",\"msg\":\"Command of 27 bytes from 192.168.1.23:4210\"},"
+             "{\"seq\":%u,\"t\":1234,\"tag\":\"SETTINGS\",\"msg\":\"Strip chipset 1, color order 2, white 1\"}",
+             (unsigned) since, (unsigned) since + 1);
+    TEST_ASSERT_EQUAL_STRING(expected, buffer);
+}
+
+static void test_overwritten_events_are_reported_lost() {
+    const uint32_t since = head();
+    for (uint32_t i = 0; i < CAPACITY + 10; i++) log(SAVE_MODE, i);
+
+    char buffer[CAPACITY * 96];
+    uint32_t lost;
+    uint32_t next;
+    formatAll(since, buffer, sizeof(buffer), lost, next);
+    TEST_ASSERT_EQUAL_UINT32(10, lost);
+    TEST_ASSERT_EQUAL_UINT32(head(), next);
+    TEST_ASSERT_TRUE(strstr(buffer, "\"msg\":\"Mode 10\"") != nullptr);
+    TEST_ASSERT_TRUE(strstr(buffer, "\"msg\":\"Mode 9\"") == nullptr);
+}
+
+static void test_reader_never_sees_a_torn_event() {
+    // Every event carries its value three times; a formatted event mixing two writes shows it
+    constexpr uint32_t READS = 2000;
+    std::atomic<bool> done{false};
+    std::atomic<uint32_t> writes{0};
+    std::thread writer([&done, &writes]() {
+        for (uint32_t i = 0; !done; i++) {
+            log(SAVE_STRIP, i, i, i);
+            writes.store(i + 1, std::memory_order_relaxed);
+        }
+    });
+
+    static char buffer[CAPACITY * 96];
+    uint32_t events = 0;
+    uint32_t torn = 0;
+    for (uint32_t read = 0; read < READS; read++) {
+        uint32_t lost;
+        uint32_t next;
+        formatAll(head() - CAPACITY / 2, buffer, sizeof(buffer), lost, next);
+        for (const char *p = strstr(buffer, "chipset "); p; p = strstr(p + 1, "chipset ")) {
+            unsigned a;
+            unsigned b;
+            unsigned c;
+            if (sscanf(p, "chipset %u, color order %u, white %u", &a, &b, &c) != 3 || a != b || b != c) torn++;
+            events++;
+        }
+    }
+    done = true;
+    writer.join();
+
+    char message[96];
+    snprintf(message, sizeof(message), "%u events read during %u writes", (unsigned) events, (unsigned) writes.load());
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(events > 0);
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+}
+
+static void test_cost_against_esp_log() {
+    console = fopen("/dev/null", "w");
+    TEST_ASSERT_TRUE(console != nullptr);
+    constexpr int CALLS = 200000;
+    int lineBytes = 0;
+    double logNs = 1e9;
+    double espLogNs = 1e9;
+    // Best of interleaved runs
+    for (int run = 0; run < 9; run++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < CALLS; i++) log(UDP_COMMAND, strlen(MESSAGE), REMOTE_IP + i, REMOTE_PORT);
+        logNs = std::min(logNs, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+                                    / CALLS);
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < CALLS; i++) lineBytes = udpReceivedLog(MESSAGE, REMOTE_IP + i);
+        espLogNs = std::min(espLogNs, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+                                          / CALLS);
+    }
+    fclose(console);
+
+    const double uartUs = lineBytes * 10 * 1e6 / UART_BAUD;
+    char message[200];
+    snprintf(message, sizeof(message),
+             "EventLog::log %.1f ns, ESP_LOG line %.1f ns (%.0fx); the %d-byte line takes %.0f us on a "
+             "%u baud console",
+             logNs, espLogNs, espLogNs / logNs, lineBytes, uartUs, (unsigned) UART_BAUD);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(logNs * 4 < espLogNs);
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_events_are_formatted_on_read);
+    RUN_TEST(test_overwritten_events_are_reported_lost);
+    RUN_TEST(test_reader_never_sees_a_torn_event);
+    RUN_TEST(test_cost_against_esp_log);
+    return UNITY_END();
+}
@@ -0,0 +1,208 @@
+#include <unity.h>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "switcher/FrameBlend.h"
+
+/*
+ * Keyframe interpolation against rendering every frame. The effects are host versions of the
+ * interpolated modes: like plasma and color_waves they are drawn from millis() alone, so a
+ * frame can be rendered for any point in time and the interpolated output compared with it.
+ */
+
+static constexpr int NUM_LEDS = 256;
+static constexpr size_t BYTES = NUM_LEDS * 3;
+static constexpr uint32_t FPS = 60;
+static constexpr uint32_t SECONDS = 10;
+static constexpr uint8_t DIVISOR = 2;
+
+using Frame = std::vector<uint8_t>;
+using Effect = void (*)(uint8_t *rgb, uint32_t ms);
+
+static uint8_t wave(float x) {
+    return static_cast<uint8_t>(127.5f + 127.5f * sinf(x));
+}
+
+/// Overlapping sine fields, a few seconds per cycle
+static void plasma(uint8_t *rgb, uint32_t ms) {
+    const float t = ms / 1000.0f;
+    for (int i = 0; i < NUM_LEDS; i++) {
+        const float v = sinf(i * 0.11f + t * 1.3f) + sinf(i * 0.043f - t * 0.7f) + sinf((i + t * 9.0f) * 0.025f);
+        rgb[i * 3] = wave(v * 2.1f);
+        rgb[i * 3 + 1] = wave(v * 2.1f + 2.1f);
+        rgb[i * 3 + 2] = wave(v * 2.1f + 4.2f);
+    }
+}
+
+/// Bands of colour sweeping along the strip with a breathing brightness, like bpm
+static void bpm(uint8_t *rgb, uint32_t ms) {
+    const float t = ms / 1000.0f;
+    const float beat = 0.55f + 0.45f * sinf(t * 2.0f * static_cast<float>(M_PI) * 62 / 60);
+    for (int i = 0; i < NUM_LEDS; i++) {
+        const float hue = i * 0.09f + t * 4.0f;
+        rgb[i * 3] = wave(hue) * beat;
+        rgb[i * 3 + 1] = wave(hue + 2.1f) * beat;
+        rgb[i * 3 + 2] = wave(hue + 4.2f) * beat;
+    }
+}
+
+/**
+ * Output the render task produces for each frame, the way Switcher::advanceKeyframes() does it:
+ * a keyframe every DIVISOR frames and blends in between, one keyframe behind the effect.
+ * @param renders Set to the number of keyframes drawn
+ */
+static std::vector<Frame> interpolated(Effect effect, uint32_t frames, uint32_t &renders) {
+    std::vector<Frame> out;
+    Frame keyframe(BYTES);
+    Frame latest(BYTES);
+    Frame blended(BYTES);
+    renders = 0;
+    for (uint32_t n = 0; n < frames; n++) {
+        const uint8_t phase = n % DIVISOR;
+        if (phase == 0) {
+            if (n > 0) keyframe = latest;
+            effect(latest.data(), n * 1000 / FPS);
+            renders++;
+            if (n == 0) keyframe = latest;
+        }
+        if (phase == 0) {
+            out.push_back(keyframe);
+        } else {
+            FrameBlend::blend(keyframe.data(), latest.data(), blended.data(), BYTES, FrameBlend::amount(phase, DIVISOR));
+            out.push_back(blended);
+        }
+    }
+    return out;
+}
+
+struct Error {
+    double mean;   ///< Mean absolute error per channel, 0-255
+    double psnr;   ///< Peak signal-to-noise ratio in dB
+    int max;       ///< Largest error of any channel
+};
+
+/**
+ * Interpolated frames against the effect rendered at full rate, shifted by the one keyframe of
+ * latency the interpolation adds. The first keyframe period has nothing to blend from.
+ */
+static Error compare(Effect effect, const std::vector<Frame> &frames) {
+    Frame reference(BYTES);
+    uint64_t sum = 0;
+    uint64_t squares = 0;
+    uint64_t samples = 0;
+    int max = 0;
+    for (uint32_t n = DIVISOR; n < frames.size(); n++) {
+        effect(reference.data(), (n - DIVISOR) * 1000 / FPS);
+        for (size_t i = 0; i < BYTES; i++) {
+            const int error = abs(frames[n][i] - reference[i]);
+            sum += error;
+            squares += error * error;
+            if (error > max) max = error;
+        }
+        samples += BYTES;
+    }
+    const double mse = static_cast<double>(squares) / samples;
+    return {static_cast<double>(sum) / samples, mse > 0 ? 10 * log10(255.0 * 255.0 / mse) : 99.0, max};
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+static void test_blend_matches_linear_interpolation() {
+    uint8_t from[256];
+    uint8_t to[256];
+    uint8_t out[256];
+    for (int b = 0; b < 256; b++) {
+        for (int a = 0; a < 256; a++) {
+            from[a] = a;
+            to[a] = b;
+        }
+        for (int amount = 0; amount < 256; amount++) {
+            FrameBlend::blend(from, to, out, sizeof(out), amount);
+            for (int a = 0; a < 256; a++) {
+                const double exact = a + (b - a) * amount / 255.0;
+                TEST_ASSERT_TRUE(fabs(out[a] - exact) <= 1.0);
+            }
+        }
+        // The ends are exact
+        FrameBlend::blend(from, to, out, sizeof(out), 0);
+        TEST_ASSERT_EQUAL_MEMORY(from, out, sizeof(out));
+        FrameBlend::blend(from, to, out, sizeof(out), 255);
+        TEST_ASSERT_EQUAL_MEMORY(to, out, sizeof(out));
+    }
+}
+
+static void test_blend_in_place() {
+    uint8_t from[] = {0, 100, 255};
+    const uint8_t to[] = {255, 100, 0};
+    FrameBlend::blend(from, to, from, sizeof(from), FrameBlend::amount(1, 2));
+    TEST_ASSERT_EQUAL_UINT8(128, from[0]);
+    TEST_ASSERT_EQUAL_UINT8(100, from[1]);
+    TEST_ASSERT_EQUAL_UINT8(127, from[2]);
+    TEST_ASSERT_EQUAL_UINT8(0, FrameBlend::amount(0, 4));
+    TEST_ASSERT_EQUAL_UINT8(192, FrameBlend::amount(3, 4));
+}
+
+static void checkEffect(const char *name, Effect effect) {
+    constexpr uint32_t FRAMES = FPS * SECONDS;
+    uint32_t renders = 0;
+    const std::vector<Frame> frames = interpolated(effect, FRAMES, renders);
+    const Error error = compare(effect, frames);
+
+    // CPU per output frame: every frame drawn, against a keyframe every DIVISOR frames plus blends
+    Frame rgb(BYTES);
+    Frame other(BYTES);
+    constexpr int LOOPS = 20;
+    auto start = std::chrono::steady_clock::now();
+    for (int loop = 0; loop < LOOPS; loop++) {
+        for (uint32_t n = 0; n < FRAMES; n++) effect(rgb.data(), n * 1000 / FPS);
+    }
+    const double renderUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count()
+                            / (LOOPS * FRAMES);
+    start = std::chrono::steady_clock::now();
+    for (int loop = 0; loop < LOOPS; loop++) {
+        for (uint32_t n = 0; n < FRAMES; n++) {
+            FrameBlend::blend(rgb.data(), other.data(), other.data(), BYTES, FrameBlend::amount(n % DIVISOR, DIVISOR));
+        }
+    }
+    const double blendUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count()
+                           / (LOOPS * FRAMES);
+    const double interpolatedUs = renderUs / DIVISOR + blendUs * (DIVISOR - 1) / DIVISOR;
+
+    char message[200];
+    snprintf(message, sizeof(message),
+             "%s, %d LEDs, divisor %u: mean error %.2f, max %d, PSNR %.1f dB; render %.2f us, blend %.2f us, "
+             "%.0f%% of the full-rate CPU time per frame",
+             name, NUM_LEDS, DIVISOR, error.mean, error.max, error.psnr, renderUs, blendUs,
+             100 * interpolatedUs / renderUs);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_EQUAL_UINT32(FRAMES / DIVISOR, renders);
+    // Blends of slow motion stay close to the frames they stand in for
+    TEST_ASSERT_TRUE(error.mean < 2.0);
+    TEST_ASSERT_TRUE(error.psnr > 35.0);
+    TEST_ASSERT_TRUE(interpolatedUs < renderUs);
+}
+
+static void test_plasma_against_full_rate() {
+    checkEffect("plasma", plasma);
+}
+
+static void test_bpm_against_full_rate() {
+    checkEffect("bpm", bpm);
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_blend_matches_linear_interpolation);
+    RUN_TEST(test_blend_in_place);
+    RUN_TEST(test_plasma_against_full_rate);
+    RUN_TEST(test_bpm_against_full_rate);
+    return UNITY_END();
+}
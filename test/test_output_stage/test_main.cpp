@@ -0,0 +1,167 @@
+#include <unity.h>
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "board/BoardTraits.h"
+#include "switcher/OutputStage.h"
+
+/*
+ * The gamma, brightness and dithering pass, and what it costs next to show(). Clocking out a
+ * pixel takes LED_WIRE_TIME_US whatever the CPU does, so the pass is measured per pixel and
+ * set against that. RGBW strips run the same pass with the white extraction, and send a fourth
+ * byte per LED.
+ */
+
+using namespace OutputStage;
+
+static constexpr int NUM_LEDS = 256;
+static constexpr int DEFAULT_LEVEL = 51;
+static constexpr double C6_CLOCK_HZ = 160e6;
+static constexpr uint8_t RGB_ORDER[3] = {0, 1, 2};
+static constexpr uint8_t GRB_ORDER[3] = {1, 0, 2};
+
+static uint16_t gammaTable[256];
+static uint16_t lut[256];
+static uint8_t source[NUM_LEDS * 3];
+static uint8_t wire[NUM_LEDS * 4];
+static uint8_t residual[NUM_LEDS * 4];
+
+void setUp() {
+    buildGammaTable(gammaTable);
+    buildLut(gammaTable, DEFAULT_LEVEL, lut);
+    resetResidual(residual, sizeof(residual));
+}
+
+void tearDown() {
+}
+
+static void test_lut_follows_gamma_and_level() {
+    TEST_ASSERT_EQUAL_UINT32(0, gammaTable[0]);
+    TEST_ASSERT_EQUAL_UINT32(LUT_MAX, gammaTable[255]);
+    for (int i = 1; i < 256; i++) TEST_ASSERT_TRUE(gammaTable[i] >= gammaTable[i - 1]);
+    TEST_ASSERT_EQUAL_UINT32(LUT_MAX / 5, lut[255]);
+    buildLut(gammaTable, 255, lut);
+    TEST_ASSERT_EQUAL_MEMORY(gammaTable, lut, sizeof(lut));
+}
+
+static void test_channels_in_wire_order() {
+    buildLut(gammaTable, 255, lut);
+    const uint8_t pixel[3] = {255, 0, 128};
+    convert(pixel, 1, lut, GRB_ORDER, wire, residual, false, false);
+    TEST_ASSERT_EQUAL_UINT8(0, wire[0]);
+    TEST_ASSERT_EQUAL_UINT8(255, wire[1]);
+    TEST_ASSERT_EQUAL_UINT8((gammaTable[128] + 0x80) >> 8, wire[2]);
+}
+
+static void test_dither_averages_to_the_level() {
+    // Dim levels at the default brightness, where a step of the output is large against the level
+    for (int value = 1; value < 256; value += 7) {
+        memset(source, value, sizeof(source));
+        uint32_t sum = 0;
+        constexpr int FRAMES = 256;
+        for (int frame = 0; frame < FRAMES; frame++) {
+            convert(source, NUM_LEDS, lut, RGB_ORDER, wire, residual, true, false);
+            for (int i = 0; i < NUM_LEDS * 3; i++) sum += wire[i];
+        }
+        const double mean = static_cast<double>(sum) / (FRAMES * NUM_LEDS * 3);
+        TEST_ASSERT_TRUE(fabs(mean - lut[value] / 256.0) < 1.0 / 256);
+
+        // Rounded instead, every frame shows the same step
+        convert(source, NUM_LEDS, lut, RGB_ORDER, wire, residual, false, false);
+        TEST_ASSERT_EQUAL_UINT8((lut[value] + 0x80) >> 8, wire[0]);
+    }
+}
+
+static void test_white_takes_the_common_level() {
+    buildLut(gammaTable, 255, lut);
+    const uint8_t pixels[6] = {200, 100, 50, 7, 7, 7};
+    memset(wire, 0xAA, sizeof(wire));
+    convert(pixels, 2, lut, GRB_ORDER, wire, residual, false, true);
+    // G R B W, the white byte holding the minimum after gamma
+    TEST_ASSERT_EQUAL_UINT8((lut[100] - lut[50] + 0x80) >> 8, wire[0]);
+    TEST_ASSERT_EQUAL_UINT8((lut[200] - lut[50] + 0x80) >> 8, wire[1]);
+    TEST_ASSERT_EQUAL_UINT8(0, wire[2]);
+    TEST_ASSERT_EQUAL_UINT8((lut[50] + 0x80) >> 8, wire[3]);
+    // A grey pixel is all white
+    TEST_ASSERT_EQUAL_UINT8(0, wire[4]);
+    TEST_ASSERT_EQUAL_UINT8(0, wire[6]);
+    TEST_ASSERT_EQUAL_UINT8((lut[7] + 0x80) >> 8, wire[7]);
+    // Eight bytes make three RGB pixels; the ninth pads the stream
+    TEST_ASSERT_EQUAL_INT(3, wirePixels(2, true));
+    TEST_ASSERT_EQUAL_UINT8(0, wire[8]);
+    TEST_ASSERT_EQUAL_UINT8(0xAA, wire[9]);
+}
+
+struct Variant {
+    bool dither;
+    bool white;
+};
+
+/**
+ * Best of interleaved runs, in ns per LED.
+ */
+static void timeConvert(const Variant *variant, double *bestNs, size_t variants) {
+    constexpr int FRAMES = 2000;
+    for (int i = 0; i < NUM_LEDS * 3; i++) source[i] = i * 37;
+    for (size_t v = 0; v < variants; v++) bestNs[v] = 1e9;
+    for (int run = 0; run < 9; run++) {
+        for (size_t v = 0; v < variants; v++) {
+            const auto start = std::chrono::steady_clock::now();
+            for (int frame = 0; frame < FRAMES; frame++) {
+                source[frame % sizeof(source)]++;
+                convert(source, NUM_LEDS, lut, GRB_ORDER, wire, residual, variant[v].dither, variant[v].white);
+            }
+            const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            bestNs[v] = std::min(bestNs[v], ns / (static_cast<double>(FRAMES) * NUM_LEDS));
+        }
+    }
+}
+
+static void test_cost_against_show() {
+    const Variant variants[] = {{false, false}, {true, false}};
+    double ns[2];
+    timeConvert(variants, ns, 2);
+
+    // show() holds the CPU for the wire time of the strip; the pass runs once per show()
+    const double wireNs = Board::LED_WIRE_TIME_US * 1000.0;
+    char message[220];
+    snprintf(message, sizeof(message),
+             "%d LEDs: output pass %.2f ns/LED rounded, %.2f ns/LED dithered; %.0f ns/LED on the wire, "
+             "pass %.3f%% of show() here; 1%% of show() is %.0f cycles/LED on a 160 MHz C6",
+             NUM_LEDS, ns[0], ns[1], wireNs, 100 * ns[1] / wireNs, wireNs * 1e-9 * C6_CLOCK_HZ / 100);
+    TEST_MESSAGE(message);
+    // Even a core twenty times slower than the host stays within a few percent of show()
+    TEST_ASSERT_TRUE(ns[1] * 20 < wireNs * 0.05);
+}
+
+static void test_rgbw_against_rgb() {
+    const Variant variants[] = {{false, false}, {true, false}, {false, true}, {true, true}};
+    double ns[4];
+    timeConvert(variants, ns, 4);
+
+    // A frame is the pass plus the wire time of its pixels; an RGBW LED clocks out 4/3 of a pixel
+    const double rgbFrameUs = (ns[1] * NUM_LEDS) / 1000 + wirePixels(NUM_LEDS, false) * Board::LED_WIRE_TIME_US;
+    const double rgbwFrameUs = (ns[3] * NUM_LEDS) / 1000 + wirePixels(NUM_LEDS, true) * Board::LED_WIRE_TIME_US;
+    char message[240];
+    snprintf(message, sizeof(message),
+             "%d LEDs, ns/LED rounded/dithered: RGB %.2f/%.2f, RGBW %.2f/%.2f (%+.0f%% dithered); frame %.0f us RGB, "
+             "%.0f us RGBW, at most %.0f and %.0f fps",
+             NUM_LEDS, ns[0], ns[1], ns[2], ns[3], 100 * (ns[3] / ns[1] - 1), rgbFrameUs, rgbwFrameUs,
+             1e6 / rgbFrameUs, 1e6 / rgbwFrameUs);
+    TEST_MESSAGE(message);
+    // The extra wire byte, not the white extraction, is what slows an RGBW strip down
+    TEST_ASSERT_TRUE((ns[3] - ns[1]) * NUM_LEDS / 1000 < (rgbwFrameUs - rgbFrameUs) * 0.05);
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_lut_follows_gamma_and_level);
+    RUN_TEST(test_channels_in_wire_order);
+    RUN_TEST(test_dither_averages_to_the_level);
+    RUN_TEST(test_white_takes_the_common_level);
+    RUN_TEST(test_cost_against_show);
+    RUN_TEST(test_rgbw_against_rgb);
+    return UNITY_END();
+}
@@ -0,0 +1,168 @@
+#include <unity.h>
+#include <FastLED.h>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "palettes/Gradient.h"
+
+/*
+ * Gradient expansion into the 256-entry table, and what the table saves per pixel over
+ * interpolating a 16-entry palette on every lookup the way ColorFromPalette() does.
+ */
+
+using namespace Palettes;
+
+static constexpr int NUM_LEDS = 256;
+// Keeps the timed loops from being optimised away
+static volatile uint32_t sink;
+
+// FastLED's party colors, as 16 palette entries and as 16 gradient stops
+static const uint32_t PARTY[16] = {0x5500AB, 0x84007C, 0xB5004B, 0xE5001B, 0xE81700, 0xB84700, 0xAB7700, 0xABAB00,
+                                   0xAB5500, 0xDD2200, 0xF2000E, 0xC2003E, 0x8F0071, 0x5F00A1, 0x2F00D0, 0x0007F9};
+
+static void partyStops(Stop *stops) {
+    for (int i = 0; i < 16; i++) {
+        stops[i] = {static_cast<uint8_t>(i * 17), static_cast<uint8_t>(PARTY[i] >> 16),
+                    static_cast<uint8_t>(PARTY[i] >> 8), static_cast<uint8_t>(PARTY[i])};
+    }
+}
+
+/**
+ * ColorFromPalette() on a 16-entry palette with LINEARBLEND: a blend of two neighbouring
+ * entries per pixel, then the brightness scaling.
+ */
+static void colorFromPalette16(const uint32_t *palette, uint8_t index, uint8_t brightness, uint8_t *rgb) {
+    const uint8_t hi4 = index >> 4;
+    const uint8_t lo4 = index & 0x0F;
+    const uint32_t first = palette[hi4];
+    uint8_t r = first >> 16;
+    uint8_t g = first >> 8;
+    uint8_t b = first;
+    if (lo4) {
+        const uint32_t second = palette[(hi4 + 1) & 0x0F];
+        const uint8_t f2 = lo4 << 4;
+        const uint8_t f1 = 255 - f2;
+        r = scale8(r, f1) + scale8(second >> 16, f2);
+        g = scale8(g, f1) + scale8(second >> 8, f2);
+        b = scale8(b, f1) + scale8(second, f2);
+    }
+    if (brightness != 255) {
+        r = scale8(r, brightness + 1);
+        g = scale8(g, brightness + 1);
+        b = scale8(b, brightness + 1);
+    }
+    rgb[0] = r;
+    rgb[1] = g;
+    rgb[2] = b;
+}
+
+/**
+ * ColorFromPalette() on the expanded table: one load, then the same brightness scaling.
+ */
+static void colorFromTable(const uint8_t *table, uint8_t index, uint8_t brightness, uint8_t *rgb) {
+    const uint8_t *entry = table + index * 3;
+    if (brightness == 255) {
+        rgb[0] = entry[0];
+        rgb[1] = entry[1];
+        rgb[2] = entry[2];
+        return;
+    }
+    rgb[0] = scale8(entry[0], brightness + 1);
+    rgb[1] = scale8(entry[1], brightness + 1);
+    rgb[2] = scale8(entry[2], brightness + 1);
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+static void test_rejects_incomplete_gradients() {
+    const Stop good[] = {{0, 0, 0, 0}, {128, 1, 2, 3}, {128, 4, 5, 6}, {255, 7, 8, 9}};
+    TEST_ASSERT_TRUE(isValid(good, 4));
+    TEST_ASSERT_FALSE(isValid(good, 1));
+    TEST_ASSERT_FALSE(isValid(good, 3));
+    const Stop late[] = {{1, 0, 0, 0}, {255, 0, 0, 0}};
+    TEST_ASSERT_FALSE(isValid(late, 2));
+    const Stop backwards[] = {{0, 0, 0, 0}, {200, 0, 0, 0}, {100, 0, 0, 0}, {255, 0, 0, 0}};
+    TEST_ASSERT_FALSE(isValid(backwards, 4));
+    Stop many[MAX_STOPS + 1];
+    for (size_t i = 0; i < MAX_STOPS; i++) many[i] = {static_cast<uint8_t>(i * 255 / (MAX_STOPS - 1)), 0, 0, 0};
+    many[MAX_STOPS] = many[MAX_STOPS - 1];
+    TEST_ASSERT_TRUE(isValid(many, MAX_STOPS));
+    TEST_ASSERT_FALSE(isValid(many, MAX_STOPS + 1));
+}
+
+static void test_expand_follows_the_stops() {
+    const Stop stops[] = {{0, 255, 0, 0}, {64, 0, 255, 0}, {64, 0, 0, 255}, {200, 10, 20, 30}, {255, 255, 255, 255}};
+    TEST_ASSERT_TRUE(isValid(stops, 5));
+    uint8_t table[TABLE_SIZE * 3];
+    memset(table, 0xAA, sizeof(table));
+    expand(stops, 5, table);
+
+    // Every stop that starts a segment is hit exactly; a repeated position takes the later stop
+    TEST_ASSERT_EQUAL_UINT8(255, table[0]);
+    TEST_ASSERT_EQUAL_UINT8(255, table[64 * 3 + 2]);
+    TEST_ASSERT_EQUAL_UINT8(0, table[64 * 3 + 1]);
+    TEST_ASSERT_EQUAL_UINT8(10, table[200 * 3]);
+
+    // In between and at the end, within two steps of the exact line (steps are truncated to 1/128)
+    const Stop *segment = stops;
+    for (int index = 0; index < 256; index++) {
+        while (segment + 2 < stops + 5 && segment[1].position <= index) segment++;
+        const double t = static_cast<double>(index - segment[0].position) / (segment[1].position - segment[0].position);
+        const double g = segment[0].g + (segment[1].g - segment[0].g) * t;
+        TEST_ASSERT_TRUE(fabs(table[index * 3 + 1] - g) <= 2.0);
+    }
+}
+
+static void test_lookup_against_interpolation() {
+    Stop stops[16];
+    partyStops(stops);
+    uint8_t table[TABLE_SIZE * 3];
+
+    constexpr int EXPANSIONS = 10000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < EXPANSIONS; i++) expand(stops, 16, table);
+    const double expandUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count()
+                            / EXPANSIONS;
+
+    // bpm's lookups: index and brightness change along the strip and over time
+    constexpr int FRAMES = 20000;
+    uint8_t leds[NUM_LEDS * 3];
+    uint32_t checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++) {
+        for (int i = 0; i < NUM_LEDS; i++) colorFromPalette16(PARTY, frame + i * 2, frame * 3 + i * 10, leds + i * 3);
+        checksum += leds[frame % (NUM_LEDS * 3)];
+    }
+    const double interpolateNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+                                 / (static_cast<double>(FRAMES) * NUM_LEDS);
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++) {
+        for (int i = 0; i < NUM_LEDS; i++) colorFromTable(table, frame + i * 2, frame * 3 + i * 10, leds + i * 3);
+        checksum += leds[frame % (NUM_LEDS * 3)];
+    }
+    const double lookupNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+                            / (static_cast<double>(FRAMES) * NUM_LEDS);
+
+    char message[200];
+    snprintf(message, sizeof(message),
+             "16-entry interpolation %.2f ns/pixel, table lookup %.2f ns/pixel (%.0f%%); expansion %.2f us, "
+             "repaid after %.0f pixels",
+             interpolateNs, lookupNs, 100 * lookupNs / interpolateNs, expandUs,
+             expandUs * 1000 / (interpolateNs - lookupNs));
+    TEST_MESSAGE(message);
+    sink = checksum;
+    TEST_ASSERT_TRUE(lookupNs < interpolateNs);
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_rejects_incomplete_gradients);
+    RUN_TEST(test_expand_follows_the_stops);
+    RUN_TEST(test_lookup_against_interpolation);
+    return UNITY_END();
+}
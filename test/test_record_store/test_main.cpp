@@ -0,0 +1,206 @@
+#include <unity.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "settings/RecordStore.h"
+#include "settings/WriteBehind.h"
+
+/*
+ * RecordStore and WriteBehind against an in-memory stand-in for the NVS namespace.
+ */
+
+class MemoryStorage : public BlobStorage {
+public:
+    size_t length(const char *key) override {
+        const auto it = blobs.find(key);
+        return it == blobs.end() ? 0 : it->second.size();
+    }
+
+    size_t read(const char *key, void *data, size_t size) override {
+        const auto it = blobs.find(key);
+        if (it == blobs.end()) return 0;
+        const size_t count = it->second.size() < size ? it->second.size() : size;
+        memcpy(data, it->second.data(), count);
+        return count;
+    }
+
+    size_t write(const char *key, const void *data, size_t size) override {
+        if (full) return 0;
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        blobs[key].assign(bytes, bytes + size);
+        writes++;
+        return size;
+    }
+
+    std::map<std::string, std::vector<uint8_t>> blobs;
+    uint32_t writes = 0;
+    bool full = false;
+};
+
+/// Layout of an older firmware's record and the current one, which appended a field
+struct __attribute__((packed)) StateV1 {
+    uint8_t mode;
+    uint8_t brightness;
+};
+
+struct __attribute__((packed)) StateV2 {
+    uint8_t mode;
+    uint8_t brightness;
+    uint16_t numLeds;
+};
+
+static MemoryStorage *storage;
+static RecordStore *records;
+
+void setUp() {
+    storage = new MemoryStorage();
+    records = new RecordStore(*storage);
+}
+
+void tearDown() {
+    delete records;
+    delete storage;
+}
+
+static void test_crc_matches_rom_crc32() {
+    // Standard CRC-32 check value, which esp_rom_crc32_le(0, ...) also yields
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, RecordStore::crc32("123456789", 9));
+}
+
+static void test_round_trip() {
+    const StateV2 saved = {3, 128, 300};
+    TEST_ASSERT_TRUE(records->save("state", &saved, sizeof(saved)));
+    TEST_ASSERT_EQUAL_UINT32(sizeof(RecordStore::Header) + sizeof(saved), storage->length("state"));
+
+    StateV2 loaded = {};
+    TEST_ASSERT_EQUAL_INT(RecordStore::OK, records->load("state", &loaded, sizeof(loaded)));
+    TEST_ASSERT_EQUAL_MEMORY(&saved, &loaded, sizeof(saved));
+}
+
+static void test_missing_record() {
+    StateV2 loaded = {1, 2, 3};
+    TEST_ASSERT_EQUAL_INT(RecordStore::MISSING, records->load("state", &loaded, sizeof(loaded)));
+    TEST_ASSERT_EQUAL_UINT8(1, loaded.mode);
+}
+
+static void test_corrupt_payload_is_rejected() {
+    const StateV2 saved = {3, 128, 300};
+    records->save("state", &saved, sizeof(saved));
+    storage->blobs["state"].back() ^= 0x01;
+
+    StateV2 loaded = {7, 7, 7};
+    TEST_ASSERT_EQUAL_INT(RecordStore::BAD_CRC, records->load("state", &loaded, sizeof(loaded)));
+    TEST_ASSERT_EQUAL_UINT8(7, loaded.mode);
+}
+
+static void test_foreign_or_truncated_blob_is_rejected() {
+    StateV2 loaded = {};
+    const uint8_t foreign[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    storage->write("state", foreign, sizeof(foreign));
+    TEST_ASSERT_EQUAL_INT(RecordStore::BAD_HEADER, records->load("state", &loaded, sizeof(loaded)));
+
+    const StateV2 saved = {3, 128, 300};
+    records->save("state", &saved, sizeof(saved));
+    storage->blobs["state"].pop_back();
+    TEST_ASSERT_EQUAL_INT(RecordStore::BAD_HEADER, records->load("state", &loaded, sizeof(loaded)));
+
+    storage->blobs["state"].resize(3);
+    TEST_ASSERT_EQUAL_INT(RecordStore::MISSING, records->load("state", &loaded, sizeof(loaded)));
+}
+
+static void test_older_record_keeps_new_fields_at_defaults() {
+    const StateV1 old = {5, 200};
+    records->save("state", &old, sizeof(old));
+
+    StateV2 loaded = {0, 51, 60};
+    TEST_ASSERT_EQUAL_INT(RecordStore::OK, records->load("state", &loaded, sizeof(loaded)));
+    TEST_ASSERT_EQUAL_UINT8(5, loaded.mode);
+    TEST_ASSERT_EQUAL_UINT8(200, loaded.brightness);
+    TEST_ASSERT_EQUAL_UINT32(60, loaded.numLeds);
+}
+
+static void test_newer_record_loads_into_older_layout() {
+    const StateV2 saved = {4, 90, 144};
+    records->save("state", &saved, sizeof(saved));
+
+    StateV1 loaded = {};
+    TEST_ASSERT_EQUAL_INT(RecordStore::OK, records->load("state", &loaded, sizeof(loaded)));
+    TEST_ASSERT_EQUAL_UINT8(4, loaded.mode);
+    TEST_ASSERT_EQUAL_UINT8(90, loaded.brightness);
+}
+
+static void test_write_counters() {
+    const StateV2 saved = {3, 128, 300};
+    records->save("state", &saved, sizeof(saved));
+    records->save("state", &saved, sizeof(saved));
+    TEST_ASSERT_EQUAL_UINT32(2, records->commits());
+    TEST_ASSERT_EQUAL_UINT32(2 * (sizeof(RecordStore::Header) + sizeof(saved)), records->bytesWritten());
+
+    // Failed and oversized writes are not counted
+    uint8_t big[RecordStore::MAX_PAYLOAD + 1] = {};
+    TEST_ASSERT_FALSE(records->save("big", big, sizeof(big)));
+    storage->full = true;
+    TEST_ASSERT_FALSE(records->save("state", &saved, sizeof(saved)));
+    TEST_ASSERT_EQUAL_UINT32(2, records->commits());
+    TEST_ASSERT_EQUAL_UINT32(2, storage->writes);
+}
+
+static void test_write_behind_waits_for_quiet_period() {
+    WriteBehind pending(5000);
+    TEST_ASSERT_FALSE(pending.isDirty());
+    TEST_ASSERT_EQUAL_UINT32(WriteBehind::NO_DEADLINE, pending.msUntilDue(0));
+
+    pending.markDirty(1000);
+    TEST_ASSERT_EQUAL_UINT32(5000, pending.msUntilDue(1000));
+    TEST_ASSERT_FALSE(pending.isDue(5999));
+    TEST_ASSERT_TRUE(pending.isDue(6000));
+    TEST_ASSERT_EQUAL_UINT32(0, pending.msUntilDue(7000));
+
+    pending.clear();
+    TEST_ASSERT_FALSE(pending.isDue(7000));
+}
+
+static void test_burst_of_changes_costs_one_write() {
+    // A brightness slider dragged for two seconds: one change every 20 ms
+    WriteBehind pending(5000);
+    StateV2 state = {0, 0, 60};
+    for (uint32_t now = 0; now <= 20000; now++) {
+        if (now <= 2000 && now % 20 == 0) {
+            state.brightness = now / 20;
+            pending.markDirty(now);
+        }
+        if (pending.isDue(now)) {
+            records->save("state", &state, sizeof(state));
+            pending.clear();
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, storage->writes);
+
+    StateV2 loaded = {};
+    records->load("state", &loaded, sizeof(loaded));
+    TEST_ASSERT_EQUAL_UINT8(100, loaded.brightness);
+}
+
+static void test_write_behind_survives_timer_wrap() {
+    WriteBehind pending(5000);
+    pending.markDirty(UINT32_MAX - 1000);
+    TEST_ASSERT_EQUAL_UINT32(1000, pending.msUntilDue(UINT32_MAX - 1000 + 4000));
+    TEST_ASSERT_TRUE(pending.isDue(3999));
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_crc_matches_rom_crc32);
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_missing_record);
+    RUN_TEST(test_corrupt_payload_is_rejected);
+    RUN_TEST(test_foreign_or_truncated_blob_is_rejected);
+    RUN_TEST(test_older_record_keeps_new_fields_at_defaults);
+    RUN_TEST(test_newer_record_loads_into_older_layout);
+    RUN_TEST(test_write_counters);
+    RUN_TEST(test_write_behind_waits_for_quiet_period);
+    RUN_TEST(test_burst_of_changes_costs_one_write);
+    RUN_TEST(test_write_behind_survives_timer_wrap);
+    return UNITY_END();
+}
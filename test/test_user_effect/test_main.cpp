@@ -0,0 +1,198 @@
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+#include "user_effect/Bytecode.h"
+
+/*
+ * User effect programs: what validate() lets through, what the interpreter computes, and what
+ * a frame of 256 LEDs costs. sin8, scale8 and noise come from the FastLED stand-in in
+ * test/host; its noise is not FastLED's Perlin noise, so NOISE timings are indicative only.
+ */
+
+using namespace UserEffect;
+
+using Code = std::vector<uint8_t>;
+
+static constexpr int NUM_LEDS = 256;
+static constexpr uint32_t FPS = 60;
+static constexpr double C6_CLOCK_HZ = 160e6;
+
+static const Inputs INPUTS = {123456, NUM_LEDS, 128, 200, 10};
+
+// Hue sweeping along the strip and over time
+static const Code RAINBOW = {OP_INDEX, OP_PUSH, 4, OP_MUL, OP_TIME, OP_PUSH, 4, OP_SHR, OP_ADD,
+                             OP_PUSH, 255, OP_DUP, OP_HSV};
+// Two sine waves, the second a third of a turn behind
+static const Code WAVES = {OP_INDEX, OP_PUSH, 8, OP_MUL, OP_TIME, OP_SPEED, OP_MUL, OP_PUSH, 8, OP_SHR, OP_ADD,
+                           OP_DUP, OP_SIN8, OP_SWAP, OP_PUSH, 85, OP_ADD, OP_SIN8, OP_INTENSITY, OP_SCALE8,
+                           OP_PUSH, 32, OP_RGB};
+// Noise field through the palette, dimmed by intensity
+static const Code NOISE_PALETTE = {OP_INDEX, OP_PUSH, 24, OP_MUL, OP_TIME, OP_PUSH, 2, OP_SHR, OP_NOISE,
+                                   OP_INTENSITY, OP_PAL};
+
+/**
+ * The longest and costliest program there can be: 128 single-byte instructions, most of them
+ * noise lookups and multiplications.
+ */
+static Code worstCase() {
+    Code code = {OP_INDEX, OP_TIME};
+    while (code.size() + 4 + 3 <= MAX_CODE) {
+        code.push_back(OP_NOISE);
+        code.push_back(OP_TIME);
+        code.push_back(OP_MUL);
+        code.push_back(OP_INDEX);
+    }
+    while (code.size() + 3 < MAX_CODE) code.push_back(OP_SIN8);
+    code.push_back(OP_DUP);
+    code.push_back(OP_DUP);
+    code.push_back(OP_RGB);
+    return code;
+}
+
+/**
+ * Instructions one pixel runs: the program is straight-line, so each one once.
+ */
+static uint32_t instructionCount(const Code &code) {
+    uint32_t count = 0;
+    for (size_t pc = 0; pc < code.size(); count++) {
+        pc += code[pc] == OP_PUSH ? 2 : code[pc] == OP_PUSH16 ? 3 : 1;
+    }
+    return count;
+}
+
+static bool accepts(const Code &code) {
+    return validate(code.data(), code.size());
+}
+
+static Output run(const Code &code, uint32_t index = 0) {
+    TEST_ASSERT_TRUE(accepts(code));
+    return evaluate(code.data(), code.size(), INPUTS, index);
+}
+
+static uint32_t top(const Code &code) {
+    // Leaves the result in r of "x 0 0 RGB"
+    Code program = code;
+    program.insert(program.end(), {OP_PUSH, 0, OP_DUP, OP_RGB});
+    return run(program).a;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+static void test_validate_accepts() {
+    TEST_ASSERT_TRUE(accepts(RAINBOW));
+    TEST_ASSERT_TRUE(accepts(WAVES));
+    TEST_ASSERT_TRUE(accepts(NOISE_PALETTE));
+    TEST_ASSERT_EQUAL_UINT32(MAX_CODE, worstCase().size());
+    TEST_ASSERT_TRUE(accepts(worstCase()));
+
+    // Exactly MAX_STACK deep
+    Code deep(MAX_STACK, OP_INDEX);
+    for (size_t i = 0; i + 3 < MAX_STACK; i++) deep.push_back(OP_DROP);
+    deep.push_back(OP_RGB);
+    TEST_ASSERT_TRUE(accepts(deep));
+}
+
+static void test_validate_rejects() {
+    TEST_ASSERT_FALSE(validate(nullptr, 0));
+    TEST_ASSERT_FALSE(accepts({}));
+    // Unknown opcode
+    TEST_ASSERT_FALSE(accepts({OP_INDEX, 0x7F, OP_DUP, OP_DUP, OP_RGB}));
+    // Truncated immediates
+    TEST_ASSERT_FALSE(accepts({OP_PUSH}));
+    TEST_ASSERT_FALSE(accepts({OP_INDEX, OP_DUP, OP_DUP, OP_RGB, OP_PUSH16, 1}));
+    // Underflow, at the start and by the output instruction
+    TEST_ASSERT_FALSE(accepts({OP_ADD, OP_INDEX, OP_DUP, OP_DUP, OP_RGB}));
+    TEST_ASSERT_FALSE(accepts({OP_INDEX, OP_DUP, OP_HSV}));
+    // One entry more than MAX_STACK
+    Code deep(MAX_STACK + 1, OP_INDEX);
+    for (size_t i = 0; i + 2 < MAX_STACK; i++) deep.push_back(OP_DROP);
+    deep.push_back(OP_RGB);
+    TEST_ASSERT_FALSE(accepts(deep));
+    // No output, output not last, two outputs
+    TEST_ASSERT_FALSE(accepts({OP_INDEX, OP_DUP, OP_DUP}));
+    TEST_ASSERT_FALSE(accepts({OP_INDEX, OP_DUP, OP_DUP, OP_RGB, OP_INDEX}));
+    TEST_ASSERT_FALSE(accepts({OP_INDEX, OP_DUP, OP_DUP, OP_DUP, OP_DUP, OP_DUP, OP_RGB, OP_RGB}));
+    // One byte over the limit
+    Code longest = worstCase();
+    longest.insert(longest.begin(), OP_DROP);
+    longest.insert(longest.begin(), OP_INDEX);
+    TEST_ASSERT_FALSE(accepts(longest));
+}
+
+static void test_evaluate() {
+    // Operands pop right to left, arithmetic wraps, division by zero yields 0
+    TEST_ASSERT_EQUAL_UINT32(7, top({OP_PUSH, 10, OP_PUSH, 3, OP_SUB}));
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFDu, top({OP_PUSH, 3, OP_PUSH, 6, OP_SUB}));
+    TEST_ASSERT_EQUAL_UINT32(3, top({OP_PUSH, 10, OP_PUSH, 3, OP_DIV}));
+    TEST_ASSERT_EQUAL_UINT32(0, top({OP_PUSH, 10, OP_PUSH, 0, OP_DIV}));
+    TEST_ASSERT_EQUAL_UINT32(0, top({OP_PUSH, 10, OP_PUSH, 0, OP_MOD}));
+    TEST_ASSERT_EQUAL_UINT32(0x1234, top({OP_PUSH16, 0x34, 0x12}));
+    TEST_ASSERT_EQUAL_UINT32(4, top({OP_PUSH, 1, OP_PUSH, 34, OP_SHL}));
+    TEST_ASSERT_EQUAL_UINT32(1, top({OP_PUSH, 2, OP_PUSH, 5, OP_LT}));
+    TEST_ASSERT_EQUAL_UINT32(20, top({OP_PUSH, 0, OP_PUSH, 10, OP_PUSH, 20, OP_SEL}));
+    TEST_ASSERT_EQUAL_UINT32(10, top({OP_PUSH, 1, OP_PUSH, 10, OP_PUSH, 20, OP_SEL}));
+    TEST_ASSERT_EQUAL_UINT32(2, top({OP_PUSH, 1, OP_PUSH, 2, OP_SWAP, OP_DROP}));
+    TEST_ASSERT_EQUAL_UINT32(255, top({OP_PUSH, 64, OP_SIN8}));
+    TEST_ASSERT_EQUAL_UINT32(127, top({OP_PUSH, 255, OP_PUSH, 127, OP_SCALE8}));
+
+    // Inputs, and the operands of each output instruction
+    const Output rgb = run({OP_INDEX, OP_COUNT, OP_HUE, OP_RGB}, 17);
+    TEST_ASSERT_EQUAL_UINT8(OP_RGB, rgb.opcode);
+    TEST_ASSERT_EQUAL_UINT32(17, rgb.a);
+    TEST_ASSERT_EQUAL_UINT32(NUM_LEDS, rgb.b);
+    TEST_ASSERT_EQUAL_UINT32(INPUTS.hue, rgb.c);
+    const Output hsv = run(RAINBOW, 3);
+    TEST_ASSERT_EQUAL_UINT8(OP_HSV, hsv.opcode);
+    TEST_ASSERT_EQUAL_UINT32(3 * 4 + (INPUTS.time >> 4), hsv.a);
+    TEST_ASSERT_EQUAL_UINT32(255, hsv.c);
+    const Output pal = run({OP_TIME, OP_INTENSITY, OP_PAL});
+    TEST_ASSERT_EQUAL_UINT8(OP_PAL, pal.opcode);
+    TEST_ASSERT_EQUAL_UINT32(INPUTS.time, pal.a);
+    TEST_ASSERT_EQUAL_UINT32(INPUTS.intensity, pal.b);
+}
+
+static void benchmark(const char *name, const Code &code) {
+    TEST_ASSERT_TRUE(accepts(code));
+    constexpr uint32_t FRAMES = 600;
+    const uint32_t ops = instructionCount(code);
+    Inputs inputs = INPUTS;
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < FRAMES; frame++) {
+        inputs.time = frame * 1000 / FPS;
+        for (int i = 0; i < NUM_LEDS; i++) evaluate(code.data(), code.size(), inputs, i);
+    }
+    const double elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    const double nsPerPixel = elapsedNs / (FRAMES * NUM_LEDS);
+    const double opsPerSecond = static_cast<double>(ops) * NUM_LEDS * FPS;
+
+    // The C6 budget: cycles each instruction may take for the effect to fit a quarter of the core
+    char message[200];
+    snprintf(message, sizeof(message),
+             "%s: %u ops/pixel, %.1f ns/pixel (%.2f ns/op) here; %d LEDs at %u fps need %.2f M ops/s, "
+             "%.0f cycles/op for 25%% of a 160 MHz C6",
+             name, (unsigned) ops, nsPerPixel, nsPerPixel / ops, NUM_LEDS, (unsigned) FPS, opsPerSecond / 1e6,
+             C6_CLOCK_HZ / 4 / opsPerSecond);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(ops <= MAX_CODE);
+}
+
+static void test_ops_per_pixel() {
+    benchmark("rainbow", RAINBOW);
+    benchmark("waves", WAVES);
+    benchmark("noise palette", NOISE_PALETTE);
+    benchmark("worst case", worstCase());
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_validate_accepts);
+    RUN_TEST(test_validate_rejects);
+    RUN_TEST(test_evaluate);
+    RUN_TEST(test_ops_per_pixel);
+    return UNITY_END();
+}
@@ -0,0 +1,208 @@
+#include <unity.h>
+#include "wifi/WifiConnection.h"
+
+/*
+ * WifiConnection against a simulated driver: the test plays the Wi-Fi event task, reporting
+ * IPs and disconnects at chosen times, and checks what the state machine asks the radio to do.
+ */
+
+class SimulatedDriver : public WifiDriver {
+public:
+    void begin(bool fast) override {
+        begins++;
+        lastFast = fast;
+    }
+
+    void disconnect() override {
+        disconnects++;
+    }
+
+    uint32_t begins = 0;
+    uint32_t disconnects = 0;
+    bool lastFast = false;
+};
+
+static SimulatedDriver *driver;
+static WifiConnection *connection;
+
+void setUp() {
+    driver = new SimulatedDriver();
+    connection = new WifiConnection(*driver);
+}
+
+void tearDown() {
+    delete connection;
+    delete driver;
+}
+
+/**
+ * Polls every millisecond from `from` up to and including `to`.
+ */
+static void runUntil(uint32_t from, uint32_t to) {
+    for (uint32_t now = from; now <= to; now++) connection->poll(now);
+}
+
+static void test_idle_without_credentials() {
+    connection->start(0, false);
+    runUntil(0, 60000);
+    TEST_ASSERT_EQUAL_INT(WifiConnection::IDLE, connection->state());
+    TEST_ASSERT_EQUAL_UINT32(0, driver->begins);
+    TEST_ASSERT_EQUAL_UINT32(WifiConnection::NO_DEADLINE, connection->msUntilNextAction(60000));
+}
+
+static void test_begin_is_not_reissued_while_connecting() {
+    connection->start(0, true);
+    TEST_ASSERT_EQUAL_INT(WifiConnection::CONNECTING, connection->state());
+    runUntil(0, WifiConnection::CONNECT_TIMEOUT_MS - 1);
+    TEST_ASSERT_EQUAL_UINT32(1, driver->begins);
+    TEST_ASSERT_EQUAL_UINT32(0, driver->disconnects);
+    TEST_ASSERT_EQUAL_UINT32(1, connection->msUntilNextAction(WifiConnection::CONNECT_TIMEOUT_MS - 1));
+}
+
+static void test_timeouts_back_off_up_to_the_limit() {
+    connection->start(0, true);
+    TEST_ASSERT_FALSE(driver->lastFast);
+
+    // Expected gap between a timeout and the next begin(), doubling up to the maximum
+    const uint32_t gaps[] = {1000, 2000, 4000, 8000, 16000, 30000, 30000};
+    uint32_t now = 0;
+    for (uint32_t gap : gaps) {
+        now += WifiConnection::CONNECT_TIMEOUT_MS;
+        const uint32_t begins = driver->begins;
+        connection->poll(now);
+        TEST_ASSERT_EQUAL_INT(WifiConnection::WAIT_RETRY, connection->state());
+        TEST_ASSERT_EQUAL_UINT32(gap, connection->msUntilNextAction(now));
+        runUntil(now + 1, now + gap - 1);
+        TEST_ASSERT_EQUAL_UINT32(begins, driver->begins);
+        now += gap;
+        connection->poll(now);
+        TEST_ASSERT_EQUAL_UINT32(begins + 1, driver->begins);
+    }
+    TEST_ASSERT_EQUAL_UINT32(1 + 7, connection->stats().attempts);
+    // Every timeout aborts the association in flight
+    TEST_ASSERT_EQUAL_UINT32(7, driver->disconnects);
+}
+
+static void test_failed_fast_attempt_falls_back_to_scan() {
+    connection->setApKnown(true);
+    connection->start(0, true);
+    TEST_ASSERT_TRUE(driver->lastFast);
+
+    // A cached channel that no longer answers: give up early and scan without backoff
+    connection->poll(WifiConnection::FAST_CONNECT_TIMEOUT_MS);
+    TEST_ASSERT_EQUAL_UINT32(WifiConnection::RESTART_SETTLE_MS,
+                             connection->msUntilNextAction(WifiConnection::FAST_CONNECT_TIMEOUT_MS));
+    connection->poll(WifiConnection::FAST_CONNECT_TIMEOUT_MS + WifiConnection::RESTART_SETTLE_MS);
+    TEST_ASSERT_EQUAL_UINT32(2, driver->begins);
+    TEST_ASSERT_FALSE(driver->lastFast);
+
+    connection->onGotIp(5000);
+    TEST_ASSERT_EQUAL_INT(WifiConnection::CONNECTED, connection->state());
+    TEST_ASSERT_EQUAL_UINT32(1, connection->stats().connects);
+    TEST_ASSERT_EQUAL_UINT32(0, connection->stats().fastConnects);
+    TEST_ASSERT_EQUAL_UINT32(5000, connection->stats().lastReconnectMs);
+}
+
+static void test_lost_link_reconnects_at_once_with_cached_ap() {
+    connection->setApKnown(true);
+    connection->start(0, true);
+    connection->onGotIp(800);
+
+    TEST_ASSERT_TRUE(connection->onDisconnected(10000));
+    TEST_ASSERT_EQUAL_INT(WifiConnection::WAIT_RETRY, connection->state());
+    TEST_ASSERT_EQUAL_UINT32(0, connection->msUntilNextAction(10000));
+    connection->poll(10000);
+    TEST_ASSERT_EQUAL_UINT32(2, driver->begins);
+    TEST_ASSERT_TRUE(driver->lastFast);
+    TEST_ASSERT_EQUAL_UINT32(1, connection->stats().outageAttempts);
+
+    connection->onGotIp(10450);
+    TEST_ASSERT_EQUAL_UINT32(2, connection->stats().connects);
+    TEST_ASSERT_EQUAL_UINT32(2, connection->stats().fastConnects);
+    TEST_ASSERT_EQUAL_UINT32(450, connection->stats().lastReconnectMs);
+    TEST_ASSERT_EQUAL_UINT32(0, connection->stats().outageAttempts);
+}
+
+static void test_router_reboot_outage() {
+    // The router goes away for 20 s; the device must be back within one retry interval
+    connection->setApKnown(true);
+    connection->start(0, true);
+    connection->onGotIp(500);
+
+    const uint32_t lost = 1000;
+    const uint32_t routerBack = lost + 20000;
+    TEST_ASSERT_TRUE(connection->onDisconnected(lost));
+    uint32_t now = lost;
+    uint32_t connectedAt = 0;
+    while (now < 120000 && connectedAt == 0) {
+        connection->poll(now);
+        // The simulated router answers the first attempt that starts after it is back
+        if (connection->state() == WifiConnection::CONNECTING && now >= routerBack) {
+            connection->onGotIp(now + 300);
+            connectedAt = now + 300;
+        } else if (connection->state() == WifiConnection::CONNECTING && now % 700 == 0) {
+            // Association rejected while the router is down
+            connection->onDisconnected(now);
+        }
+        now++;
+    }
+    TEST_ASSERT_TRUE(connectedAt != 0);
+    TEST_ASSERT_TRUE(connectedAt - routerBack <= WifiConnection::RETRY_INTERVAL_MAX_MS);
+    TEST_ASSERT_EQUAL_UINT32(connectedAt - lost, connection->stats().lastReconnectMs);
+    TEST_ASSERT_EQUAL_UINT32(0, connection->stats().outageAttempts);
+    TEST_ASSERT_EQUAL_UINT32(WifiConnection::RETRY_INTERVAL_MIN_MS, connection->retryInterval());
+}
+
+static void test_new_credentials_while_connected() {
+    connection->start(0, true);
+    connection->onGotIp(500);
+
+    connection->onCredentials(2000);
+    // The link is dropped; the disconnect event starts the new attempt
+    TEST_ASSERT_EQUAL_UINT32(1, driver->disconnects);
+    TEST_ASSERT_EQUAL_INT(WifiConnection::CONNECTED, connection->state());
+    TEST_ASSERT_TRUE(connection->onDisconnected(2010));
+    connection->poll(2010);
+    TEST_ASSERT_EQUAL_UINT32(2, driver->begins);
+}
+
+static void test_new_credentials_while_connecting() {
+    connection->start(0, true);
+    runUntil(0, 5000);
+
+    connection->onCredentials(5000);
+    TEST_ASSERT_EQUAL_UINT32(1, driver->disconnects);
+    TEST_ASSERT_EQUAL_INT(WifiConnection::WAIT_RETRY, connection->state());
+    // The disconnect raised by the abort arrives while waiting and must not count as a failure
+    TEST_ASSERT_FALSE(connection->onDisconnected(5020));
+    TEST_ASSERT_EQUAL_UINT32(WifiConnection::RESTART_SETTLE_MS - 20, connection->msUntilNextAction(5020));
+    connection->poll(5000 + WifiConnection::RESTART_SETTLE_MS);
+    TEST_ASSERT_EQUAL_UINT32(2, driver->begins);
+    TEST_ASSERT_EQUAL_UINT32(1, connection->stats().outageAttempts);
+}
+
+static void test_credentials_reset_backoff() {
+    connection->start(0, true);
+    connection->poll(WifiConnection::CONNECT_TIMEOUT_MS);
+    connection->poll(WifiConnection::CONNECT_TIMEOUT_MS + 1000);
+    connection->poll(2 * WifiConnection::CONNECT_TIMEOUT_MS + 1000);
+    TEST_ASSERT_EQUAL_UINT32(4000, connection->retryInterval());
+
+    connection->onCredentials(25000);
+    TEST_ASSERT_EQUAL_UINT32(WifiConnection::RETRY_INTERVAL_MIN_MS, connection->retryInterval());
+    TEST_ASSERT_EQUAL_UINT32(0, connection->stats().outageAttempts);
+}
+
+int main(int, char **) {
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_without_credentials);
+    RUN_TEST(test_begin_is_not_reissued_while_connecting);
+    RUN_TEST(test_timeouts_back_off_up_to_the_limit);
+    RUN_TEST(test_failed_fast_attempt_falls_back_to_scan);
+    RUN_TEST(test_lost_link_reconnects_at_once_with_cached_ap);
+    RUN_TEST(test_router_reboot_outage);
+    RUN_TEST(test_new_credentials_while_connected);
+    RUN_TEST(test_new_credentials_while_connecting);
+    RUN_TEST(test_credentials_reset_backoff);
+    return UNITY_END();
+}